@@ -0,0 +1,64 @@
+/*****************************************************************
+* Description: BC1 (DXT1) and BC3 (DXT5) block compression for
+*              textures, so they can be uploaded with
+*              glCompressedTexImage2D( ) at 1/6 (BC1, from RGB) or
+*              1/4 (BC3, from RGBA) of their size.
+*
+*              Every 4x4 block of texels is encoded independently,
+*              and the block rows are spread across the cpu cores.
+*              Edge blocks of images that are not a multiple of 4 in
+*              size repeat their last row and column.
+*
+*              The modes:
+*                  BCFAST    - endpoints from the block's bounding box,
+*                              with the box and the index search done
+*                              four texels at a time with SSE2
+*                  BCQUALITY - endpoints along the block's principal
+*                              axis, then refined by least squares
+*
+*              CompressMipChain( ) compresses a texture and its
+*              mipmap chain to BC1, and records how close level 0 came
+*              back (its PSNR, in dB, after a decompress) so a texture
+*              that compresses badly can be left uncompressed instead.
+*/
+
+#pragma once
+#ifndef BLOCKCOMPRESS_H
+#define BLOCKCOMPRESS_H
+
+#include "glew.h"
+#include <GL/gl.h>
+
+#include <stddef.h>
+#include <vector>
+
+#include "mipmaps.h"
+
+#define BCFAST			0
+#define BCQUALITY		1
+
+#define BCMINPSNR		30.		// dB: a texture that comes back worse than this stays uncompressed
+
+struct BcLevel
+{
+	int				Width, Height;
+	std::vector<unsigned char>	Blocks;		// 8 (BC1) or 16 (BC3) bytes per 4x4 block, bottom block row first
+};
+
+struct BcTexture
+{
+	GLenum			Format;		// GL_COMPRESSED_RGB_S3TC_DXT1_EXT or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	std::vector<BcLevel>	Levels;		// level 0, then its mipmap chain
+	double			Psnr;		// of level 0's round trip
+};
+
+void	BenchmarkBcTexture( const char *, const unsigned char *, int, int );
+void	CompressBc1( const unsigned char *, int, int, int, std::vector<unsigned char> & );
+void	CompressBc3( const unsigned char *, int, int, int, std::vector<unsigned char> & );
+void	CompressMipChain( const unsigned char *, int, int, const std::vector<MipLevel> &, int, BcTexture & );
+void	DecompressBc1( const unsigned char *, int, int, unsigned char * );
+void	DecompressBc3( const unsigned char *, int, int, unsigned char * );
+double	GetPsnr( const unsigned char *, const unsigned char *, size_t );
+bool	UploadBcTexture( const BcTexture & );
+
+#endif
@@ -0,0 +1,321 @@
+#include "mipmaps.h"
+#include "parallel.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define MIPSSE2
+#include <emmintrin.h>
+#endif
+
+
+#define MIPPI			3.14159265358979
+#define MIPSINCRADIUS		3.		// how far the windowed sincs reach, in texels of the smaller level
+#define MIPKAISERALPHA		4.		// the Kaiser window's shape: larger is smoother, smaller is sharper
+#define MIPLINEARSTEPS		4096		// entries in the linear-to-sRGB table
+
+
+// sRGB <-> linear tables, made once:
+
+struct MipGammaTables
+{
+	float		ToLinear[256];
+	unsigned char	ToSrgb[ MIPLINEARSTEPS + 1 ];
+
+	MipGammaTables( )
+	{
+		for( int i = 0; i < 256; i++ )
+		{
+			double c = i / 255.;
+			ToLinear[i] = (float)( c <= 0.04045 ? c / 12.92 : pow( ( c + 0.055 ) / 1.055, 2.4 ) );
+		}
+		for( int i = 0; i <= MIPLINEARSTEPS; i++ )
+		{
+			double l = (double)i / MIPLINEARSTEPS;
+			double c = ( l <= 0.0031308 ) ? l * 12.92 : 1.055 * pow( l, 1. / 2.4 ) - 0.055;
+			ToSrgb[i] = (unsigned char)floor( c * 255. + 0.5 );
+		}
+	}
+};
+
+static const MipGammaTables &
+GetMipGammaTables( )
+{
+	static const MipGammaTables tables;
+	return tables;
+}
+
+
+static inline unsigned char
+MipToSrgb( const MipGammaTables &g, float l )
+{
+	if( l <= 0.f )
+		return g.ToSrgb[0];
+	if( l >= 1.f )
+		return g.ToSrgb[ MIPLINEARSTEPS ];
+	return g.ToSrgb[ (int)( l * MIPLINEARSTEPS + 0.5f ) ];
+}
+
+
+static double
+Sinc( double x )
+{
+	if( fabs( x ) < 1.e-6 )
+		return 1.;
+	return sin( MIPPI * x ) / ( MIPPI * x );
+}
+
+
+// the zeroth-order modified bessel function, which the Kaiser window is made of:
+
+static double
+BesselI0( double x )
+{
+	double sum = 1.;
+	double term = 1.;
+	for( int k = 1; k < 30; k++ )
+	{
+		term *= ( x / ( 2. * k ) ) * ( x / ( 2. * k ) );
+		sum += term;
+		if( term < 1.e-12 * sum )
+			break;
+	}
+	return sum;
+}
+
+
+// the filter's weight at x, in texels of the smaller level:
+
+static double
+MipKernel( int filter, double x )
+{
+	x = fabs( x );
+	switch( filter )
+	{
+		case MIPKAISER:
+		{
+			if( x >= MIPSINCRADIUS )
+				return 0.;
+			double r = x / MIPSINCRADIUS;
+			return Sinc( x ) * BesselI0( MIPKAISERALPHA * sqrt( 1. - r*r ) ) / BesselI0( MIPKAISERALPHA );
+		}
+
+		case MIPLANCZOS:
+			if( x >= MIPSINCRADIUS )
+				return 0.;
+			return Sinc( x ) * Sinc( x / MIPSINCRADIUS );
+
+		default:
+			return ( x < 0.5 ) ? 1. : 0.;
+	}
+}
+
+
+// which texels of a src-wide row go into each of dst texels, and how much of each:
+// every output texel has the same number of taps, padded out with zero weights,
+// and taps off either end of the row are clamped onto the end texel
+
+struct MipTaps
+{
+	int			NumTaps;
+	std::vector<int>	Index;		// NumTaps per output texel
+	std::vector<float>	Weight;
+};
+
+static void
+GetMipTaps( int filter, int src, int dst, MipTaps &taps )
+{
+	double scale = (double)src / (double)dst;
+	double radius = ( filter == MIPBOX ? 0.5 : MIPSINCRADIUS ) * scale;
+
+	taps.NumTaps = (int)ceil( 2. * radius ) + 1;
+	taps.Index.assign( dst * taps.NumTaps, 0 );
+	taps.Weight.assign( dst * taps.NumTaps, 0.f );
+
+	for( int i = 0; i < dst; i++ )
+	{
+		double center = ( i + 0.5 ) * scale;
+		int first = (int)floor( center - radius );
+		double sum = 0.;
+		for( int k = 0; k < taps.NumTaps; k++ )
+		{
+			int j = first + k;
+			double w = MipKernel( filter, ( j + 0.5 - center ) / scale );
+			int clamped = ( j < 0 ) ? 0 : ( j >= src ? src - 1 : j );
+			taps.Index[ i*taps.NumTaps + k ] = clamped;
+			taps.Weight[ i*taps.NumTaps + k ] = (float)w;
+			sum += w;
+		}
+		for( int k = 0; k < taps.NumTaps; k++ )
+			taps.Weight[ i*taps.NumTaps + k ] = (float)( taps.Weight[ i*taps.NumTaps + k ] / sum );
+	}
+}
+
+
+// sum += w * row, over n floats:
+
+static void
+AddScaledRow( float *sum, const float *row, float w, int n )
+{
+	int i = 0;
+#ifdef MIPSSE2
+	__m128 w4 = _mm_set1_ps( w );
+	for( ; i + 4 <= n; i += 4 )
+		_mm_storeu_ps( &sum[i], _mm_add_ps( _mm_loadu_ps( &sum[i] ), _mm_mul_ps( w4, _mm_loadu_ps( &row[i] ) ) ) );
+#endif
+	for( ; i < n; i++ )
+		sum[i] += w * row[i];
+}
+
+
+// filter a linear-light sw x sh level down to dw x dh, into both linear floats (for the next level)
+// and sRGB bytes (for uploading):
+
+static void
+FilterMipLevel( int filter, const float *src, int sw, int sh, float *dst, unsigned char *texels, int dw, int dh )
+{
+	MipTaps xt, yt;
+	GetMipTaps( filter, sw, dw, xt );
+	GetMipTaps( filter, sh, dh, yt );
+	const MipGammaTables &g = GetMipGammaTables( );
+
+	int numBands = ( dh + MIPBANDROWS - 1 ) / MIPBANDROWS;
+	ParallelFor( numBands, [&]( int band )
+	{
+		std::vector<float> column( 3*sw );
+		int yEnd = ( band + 1 ) * MIPBANDROWS;
+		if( yEnd > dh )
+			yEnd = dh;
+
+		for( int y = band * MIPBANDROWS; y < yEnd; y++ )
+		{
+			// vertically, a whole row at a time:
+
+			std::fill( column.begin(), column.end(), 0.f );
+			for( int k = 0; k < yt.NumTaps; k++ )
+			{
+				float w = yt.Weight[ y*yt.NumTaps + k ];
+				if( w != 0.f )
+					AddScaledRow( &column[0], &src[ 3 * (size_t)sw * yt.Index[ y*yt.NumTaps + k ] ], w, 3*sw );
+			}
+
+			// then across:
+
+			float *out = &dst[ 3 * (size_t)dw * y ];
+			unsigned char *bytes = &texels[ 3 * (size_t)dw * y ];
+			for( int x = 0; x < dw; x++ )
+			{
+				float r = 0.f, gr = 0.f, b = 0.f;
+				const int *index = &xt.Index[ x*xt.NumTaps ];
+				const float *weight = &xt.Weight[ x*xt.NumTaps ];
+				for( int k = 0; k < xt.NumTaps; k++ )
+				{
+					const float *c = &column[ 3*index[k] ];
+					r  += weight[k] * c[0];
+					gr += weight[k] * c[1];
+					b  += weight[k] * c[2];
+				}
+				out[3*x+0] = r;
+				out[3*x+1] = gr;
+				out[3*x+2] = b;
+				bytes[3*x+0] = MipToSrgb( g, r );
+				bytes[3*x+1] = MipToSrgb( g, gr );
+				bytes[3*x+2] = MipToSrgb( g, b );
+			}
+		}
+	} );
+}
+
+
+// make levels 1, 2, ... of a width x height RGB texture, down to 1x1:
+
+void
+BuildMipChain( const unsigned char *texels, int width, int height, int filter, std::vector<MipLevel> &levels )
+{
+	levels.clear( );
+	if( texels == NULL  ||  width <= 0  ||  height <= 0 )
+		return;
+
+	const MipGammaTables &g = GetMipGammaTables( );
+	size_t n = 3 * (size_t)width * height;
+	std::vector<float> src( n );
+	for( size_t i = 0; i < n; i++ )
+		src[i] = g.ToLinear[ texels[i] ];
+
+	std::vector<float> dst;
+	int sw = width, sh = height;
+	while( sw > 1  ||  sh > 1 )
+	{
+		int dw = ( sw > 1 ) ? sw / 2 : 1;
+		int dh = ( sh > 1 ) ? sh / 2 : 1;
+
+		levels.push_back( MipLevel( ) );
+		MipLevel &level = levels.back( );
+		level.Width = dw;
+		level.Height = dh;
+		level.Texels.resize( 3 * (size_t)dw * dh );
+
+		dst.resize( 3 * (size_t)dw * dh );
+		FilterMipLevel( filter, &src[0], sw, sh, &dst[0], &level.Texels[0], dw, dh );
+
+		src.swap( dst );
+		sw = dw;
+		sh = dh;
+	}
+}
+
+
+// upload a texture and its chain to the bound GL_TEXTURE_2D:
+// with no chain, only the full-size image goes up, and minification stays bilinear
+
+void
+UploadMipChain( const unsigned char *texels, int width, int height, const std::vector<MipLevel> &levels )
+{
+	// the small levels' rows are not multiples of 4 bytes long:
+
+	GLint alignment;
+	glGetIntegerv( GL_UNPACK_ALIGNMENT, &alignment );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+	glTexImage2D( GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, texels );
+	for( size_t i = 0; i < levels.size(); i++ )
+	{
+		glTexImage2D( GL_TEXTURE_2D, (GLint)i + 1, 3, levels[i].Width, levels[i].Height, 0,
+			GL_RGB, GL_UNSIGNED_BYTE, &levels[i].Texels[0] );
+	}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, alignment );
+
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels.empty() ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR );
+}
+
+
+// benchmark: time building a texture's chain with each filter
+// (best of a few runs, on however many threads ParallelFor uses)
+
+void
+BenchmarkMipChain( const char *name, const unsigned char *texels, int width, int height )
+{
+	static const char *filterNames[3] = { "box", "kaiser", "lanczos" };
+
+	fprintf( stderr, "%-32s %4d x %4d", name, width, height );
+	for( int filter = MIPBOX; filter <= MIPLANCZOS; filter++ )
+	{
+		double best = 1.e+37;
+		for( int run = 0; run < 3; run++ )
+		{
+			std::vector<MipLevel> levels;
+			std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+			BuildMipChain( texels, width, height, filter, levels );
+			double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+			if( ms < best )
+				best = ms;
+		}
+		fprintf( stderr, "  %s: %6.2f ms", filterNames[filter], best );
+	}
+	fprintf( stderr, "  (%d threads)\n", NumWorkerThreads( ) );
+}
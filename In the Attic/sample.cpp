@@ -30,6 +30,10 @@
 
 #include "utility.h"
 #include "Sphere.h"
+#include "blockcompress.h"
+#include "bmptexture.h"
+#include "mipmaps.h"
+#include "texcache.h"
 
 
 //	This is a sample OpenGL / GLUT program
@@ -248,10 +252,8 @@ void	Resize( int, int );
 void	Visibility( int );
 
 void			Axes( float );
-unsigned char *	BmpToTexture( char *, int *, int * );
 void			HsvRgb( float[3], float [3] );
-int				ReadInt( FILE * );
-short			ReadShort( FILE * );
+void			UploadBmpTexture( const char * );
 
 void			Cross(float[3], float[3], float[3]);
 float			Dot(float [3], float [3]);
@@ -1089,9 +1091,6 @@ InitGraphics( )
 
 	//char* filename = "images/porcelain.bmp"; //(char*)"squarefishColor.bmp";  // texture file
 
-	int width = 1024, height = 1024;  // file dimensions
-	int level = 0, ncomps = 3, border = 0;  // variables used to convert the image to a texture
-	unsigned char* TextureVase, * TextureDesk, * TextureBear; // *Texture; // the resulting texture
 	// request the display modes:
 	// ask for red-green-blue-alpha color, double-buffering, and z-buffering:
 
@@ -1168,12 +1167,6 @@ InitGraphics( )
 
 	// Get and Setup the Textures
 
-	// get the texture
-	
-	TextureVase = BmpToTexture(filenameVase, &width, &height);
-	TextureDesk = BmpToTexture(filenameDesk, &width, &height);
-	TextureBear = BmpToTexture(filenameBear, &width, &height);
-
 	//Set up the textures such as wraping, binding handles etc..
 
 	//page 19 in slide
@@ -1192,12 +1185,11 @@ InitGraphics( )
 
 	// define texture filtering
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
 	// tell openGL what to do with texel colors
 	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-	glTexImage2D(GL_TEXTURE_2D, level, ncomps, width, height, border, GL_RGB, GL_UNSIGNED_BYTE, TextureVase);
+	UploadBmpTexture(filenameVase);
 	
 
 	
@@ -1210,12 +1202,11 @@ InitGraphics( )
 
 	// define texture filtering
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
 	// tell openGL what to do with texel colors
 	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-	glTexImage2D(GL_TEXTURE_2D, level, ncomps, width, height, border, GL_RGB, GL_UNSIGNED_BYTE, TextureDesk);
+	UploadBmpTexture(filenameDesk);
 
 	// Set up the bear texture
 	glBindTexture(GL_TEXTURE_2D, TexBear); // make the Tex0 texture current
@@ -1226,12 +1217,11 @@ InitGraphics( )
 
 	// define texture filtering
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
 	// tell openGL what to do with texel colors
 	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-	glTexImage2D(GL_TEXTURE_2D, level, ncomps, width, height, border, GL_RGB, GL_UNSIGNED_BYTE, TextureBear);
+	UploadBmpTexture(filenameBear);
 	
 }
 
@@ -1831,146 +1821,41 @@ Axes( float length )
 
 }
 
-struct bmfh
-{
-	short bfType;
-	int bfSize;
-	short bfReserved1;
-	short bfReserved2;
-	int bfOffBits;
-} FileHeader;
-
-struct bmih
-{
-	int biSize;
-	int biWidth;
-	int biHeight;
-	short biPlanes;
-	short biBitCount;
-	int biCompression;
-	int biSizeImage;
-	int biXPelsPerMeter;
-	int biYPelsPerMeter;
-	int biClrUsed;
-	int biClrImportant;
-} InfoHeader;
-
-const int birgb = { 0 };
-
-// read a BMP file into a Texture:
-
-unsigned char *
-BmpToTexture( char *filename, int *width, int *height )
-{
-	FILE *fp = fopen( filename, "rb" );
-	if( fp == NULL )
-	{
-		fprintf( stderr, "Cannot open Bmp file '%s'\n", filename );
-		return NULL;
-	}
-
-	FileHeader.bfType = ReadShort( fp );
-
-
-	// if bfType is not 0x4d42, the file is not a bmp:
-
-	if( FileHeader.bfType != 0x4d42 )
-	{
-		fprintf( stderr, "File '%s' is the wrong type of file: 0x%0x\n", filename, FileHeader.bfType );
-		fclose( fp );
-		return NULL;
-	}
-
-	FileHeader.bfSize = ReadInt( fp );
-	FileHeader.bfReserved1 = ReadShort( fp );
-	FileHeader.bfReserved2 = ReadShort( fp );
-	FileHeader.bfOffBits = ReadInt( fp );
-
-	InfoHeader.biSize = ReadInt( fp );
-	InfoHeader.biWidth = ReadInt( fp );
-	InfoHeader.biHeight = ReadInt( fp );
-
-	int nums = InfoHeader.biWidth;
-	int numt = InfoHeader.biHeight;
-
-	InfoHeader.biPlanes = ReadShort( fp );
-	InfoHeader.biBitCount = ReadShort( fp );
-	InfoHeader.biCompression = ReadInt( fp );
-	InfoHeader.biSizeImage = ReadInt( fp );
-	InfoHeader.biXPelsPerMeter = ReadInt( fp );
-	InfoHeader.biYPelsPerMeter = ReadInt( fp );
-	InfoHeader.biClrUsed = ReadInt( fp );
-	InfoHeader.biClrImportant = ReadInt( fp );
-
-	fprintf( stderr, "Image size in file '%s' is: %d x %d\n", filename, nums, numt );
-
-	unsigned char * texture = new unsigned char[ 3 * nums * numt ];
-	if( texture == NULL )
-	{
-		fprintf( stderr, "Cannot allocate the texture array!\b" );
-		return NULL;
-	}
-
-	// extra padding bytes:
-
-	int numextra =  4*(( (3*InfoHeader.biWidth)+3)/4) - 3*InfoHeader.biWidth;
+// upload a BMP texture and its mipmap chain to the bound GL_TEXTURE_2D:
+// straight from its texture cache if it has one, else read, filtered, compressed and then cached
+// (a driver without S3TC gets an RGB cache, so it never has to rebuild a BC1 one it can't upload)
 
-	// we do not support compression:
+void
+UploadBmpTexture( const char *filename )
+{
+	int encoding = GLEW_EXT_texture_compression_s3tc ? BCFAST : TEXCACHE_UNCOMPRESSED;
 
-	if( InfoHeader.biCompression != birgb )
+	TexCache cache;
+	if( OpenTexCache( filename, MIPKAISER, encoding, cache ) )
 	{
-		fprintf( stderr, "Image file '%s' has the wrong type of image compression: %d\n", filename, InfoHeader.biCompression );
-		fclose( fp );
-		return NULL;
+		bool uploaded = UploadTexCache( cache );
+		CloseTexCache( cache );
+		if( uploaded )
+			return;
 	}
 
-	rewind( fp );
-	fseek( fp, 14+40, SEEK_SET );
+	int width = 0, height = 0;
+	unsigned char *texels = BmpToTexture( filename, &width, &height );
+	std::vector<MipLevel> mips;
+	BuildMipChain( texels, width, height, MIPKAISER, mips );
 
-	if( InfoHeader.biBitCount == 24 )
+	BcTexture compressed;
+	if( encoding != TEXCACHE_UNCOMPRESSED )
 	{
-		unsigned char *tp = texture;
-		for( int t = 0; t < numt; t++ )
-		{
-			for( int s = 0; s < nums; s++, tp += 3 )
-			{
-				*(tp+2) = fgetc( fp );		// b
-				*(tp+1) = fgetc( fp );		// g
-				*(tp+0) = fgetc( fp );		// r
-			}
-
-			for( int e = 0; e < numextra; e++ )
-			{
-				fgetc( fp );
-			}
-		}
+		CompressMipChain( texels, width, height, mips, encoding, compressed );
+		if( compressed.Psnr < BCMINPSNR )
+			compressed.Levels.clear( );
 	}
 
-	fclose( fp );
-
-	*width = nums;
-	*height = numt;
-	return texture;
-}
-
-int
-ReadInt( FILE *fp )
-{
-	unsigned char b3, b2, b1, b0;
-	b0 = fgetc( fp );
-	b1 = fgetc( fp );
-	b2 = fgetc( fp );
-	b3 = fgetc( fp );
-	return ( b3 << 24 )  |  ( b2 << 16 )  |  ( b1 << 8 )  |  b0;
-}
-
-short
-ReadShort( FILE *fp )
-{
-	unsigned char b1, b0;
-	b0 = fgetc( fp );
-	b1 = fgetc( fp );
-	return ( b1 << 8 )  |  b0;
+	if( ! UploadBcTexture( compressed ) )
+		UploadMipChain( texels, width, height, mips );
+	WriteTexCache( filename, texels, width, height, mips, compressed, MIPKAISER, encoding );
+	delete [ ] texels;
 }
 
 
@@ -0,0 +1,707 @@
+#include "blockcompress.h"
+#include "parallel.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define BCSSE2
+#include <emmintrin.h>
+#endif
+
+
+#define BCREFINEPASSES		2		// least-squares endpoint refinements in BCQUALITY mode
+#define BCPOWERSTEPS		8		// power iterations for a block's principal axis
+
+
+// one 4x4 block, gathered out of the image as RGBA (alpha 0 for the color search):
+
+struct BcBlock
+{
+	alignas(16) unsigned char	Color[64];
+	unsigned char			Alpha[16];
+};
+
+static void
+GatherBcBlock( const unsigned char *texels, int width, int height, int comps, int bx, int by, BcBlock &b )
+{
+	for( int y = 0; y < 4; y++ )
+	{
+		int sy = 4*by + y;
+		if( sy >= height )
+			sy = height - 1;
+		for( int x = 0; x < 4; x++ )
+		{
+			int sx = 4*bx + x;
+			if( sx >= width )
+				sx = width - 1;
+			const unsigned char *t = &texels[ comps * ( (size_t)width * sy + sx ) ];
+			unsigned char *c = &b.Color[ 4 * ( 4*y + x ) ];
+			c[0] = t[0];
+			c[1] = t[1];
+			c[2] = t[2];
+			c[3] = 0;
+			b.Alpha[ 4*y + x ] = ( comps == 4 ) ? t[3] : 255;
+		}
+	}
+}
+
+
+static inline unsigned short
+PackRgb565( int r, int g, int b )
+{
+	return (unsigned short)( ( ( r * 31 + 127 ) / 255 ) << 11 | ( ( g * 63 + 127 ) / 255 ) << 5 | ( ( b * 31 + 127 ) / 255 ) );
+}
+
+static inline void
+UnpackRgb565( unsigned short c, int rgb[3] )
+{
+	int r = ( c >> 11 ) & 31;
+	int g = ( c >> 5 ) & 63;
+	int b = c & 31;
+	rgb[0] = ( r << 3 ) | ( r >> 2 );
+	rgb[1] = ( g << 2 ) | ( g >> 4 );
+	rgb[2] = ( b << 3 ) | ( b >> 2 );
+}
+
+static inline int
+ClampByte( double v )
+{
+	return v <= 0. ? 0 : ( v >= 255. ? 255 : (int)( v + 0.5 ) );
+}
+
+
+// the four colors a BC1 block with c0 > c1 can hold, as RGBA with alpha 0:
+
+static void
+GetBc1Palette( unsigned short c0, unsigned short c1, unsigned char palette[16] )
+{
+	int a[3], b[3];
+	UnpackRgb565( c0, a );
+	UnpackRgb565( c1, b );
+	for( int k = 0; k < 3; k++ )
+	{
+		palette[ 0 + k] = (unsigned char)a[k];
+		palette[ 4 + k] = (unsigned char)b[k];
+		palette[ 8 + k] = (unsigned char)( ( 2*a[k] + b[k] ) / 3 );
+		palette[12 + k] = (unsigned char)( ( a[k] + 2*b[k] ) / 3 );
+	}
+	palette[3] = palette[7] = palette[11] = palette[15] = 0;
+}
+
+
+// pick each texel's nearest palette color, returning the total squared error:
+
+static int
+FitBc1Indices( const BcBlock &b, const unsigned char palette[16], int indices[16] )
+{
+	int error = 0;
+
+#ifdef BCSSE2
+	// two texels per register as 16-bit RGBA, so that _mm_madd_epi16 squares and sums pairs of channels:
+
+	const __m128i zero = _mm_setzero_si128( );
+	__m128i colors[4];
+	for( int k = 0; k < 4; k++ )
+	{
+		int packed;
+		memcpy( &packed, &palette[4*k], 4 );
+		colors[k] = _mm_unpacklo_epi8( _mm_set1_epi32( packed ), zero );
+	}
+
+	for( int j = 0; j < 4; j++ )
+	{
+		__m128i p = _mm_load_si128( (const __m128i *)&b.Color[16*j] );
+		__m128i lo = _mm_unpacklo_epi8( p, zero );
+		__m128i hi = _mm_unpackhi_epi8( p, zero );
+		__m128i best = _mm_setzero_si128( ), bestIndex = _mm_setzero_si128( );
+		for( int k = 0; k < 4; k++ )
+		{
+			__m128i dl = _mm_sub_epi16( lo, colors[k] );
+			__m128i dh = _mm_sub_epi16( hi, colors[k] );
+			__m128 ml = _mm_castsi128_ps( _mm_madd_epi16( dl, dl ) );
+			__m128 mh = _mm_castsi128_ps( _mm_madd_epi16( dh, dh ) );
+			__m128i d = _mm_add_epi32( _mm_castps_si128( _mm_shuffle_ps( ml, mh, _MM_SHUFFLE(2,0,2,0) ) ),
+						   _mm_castps_si128( _mm_shuffle_ps( ml, mh, _MM_SHUFFLE(3,1,3,1) ) ) );
+			if( k == 0 )
+			{
+				best = d;
+				continue;
+			}
+			__m128i closer = _mm_cmplt_epi32( d, best );
+			best = _mm_or_si128( _mm_and_si128( closer, d ), _mm_andnot_si128( closer, best ) );
+			bestIndex = _mm_or_si128( _mm_and_si128( closer, _mm_set1_epi32( k ) ), _mm_andnot_si128( closer, bestIndex ) );
+		}
+
+		alignas(16) int d4[4];
+		_mm_store_si128( (__m128i *)d4, best );
+		_mm_storeu_si128( (__m128i *)&indices[4*j], bestIndex );
+		error += d4[0] + d4[1] + d4[2] + d4[3];
+	}
+#else
+	for( int i = 0; i < 16; i++ )
+	{
+		const unsigned char *c = &b.Color[4*i];
+		int best = 0, bestIndex = 0;
+		for( int k = 0; k < 4; k++ )
+		{
+			int dr = c[0] - palette[4*k+0];
+			int dg = c[1] - palette[4*k+1];
+			int db = c[2] - palette[4*k+2];
+			int d = dr*dr + dg*dg + db*db;
+			if( k == 0  ||  d < best )
+			{
+				best = d;
+				bestIndex = k;
+			}
+		}
+		indices[i] = bestIndex;
+		error += best;
+	}
+#endif
+
+	return error;
+}
+
+
+// encode the block's colors between two endpoints into 8 bytes, returning the squared error:
+
+static int
+MakeBc1Block( const BcBlock &b, const int e0[3], const int e1[3], unsigned char out[8], int indices[16] )
+{
+	unsigned short c0 = PackRgb565( e0[0], e0[1], e0[2] );
+	unsigned short c1 = PackRgb565( e1[0], e1[1], e1[2] );
+
+	// c0 > c1 picks the 4-color mode (c0 <= c1 would make index 3 black):
+
+	if( c0 < c1 )
+	{
+		unsigned short t = c0;
+		c0 = c1;
+		c1 = t;
+	}
+
+	unsigned char palette[16];
+	GetBc1Palette( c0, c1, palette );
+
+	int error;
+	if( c0 == c1 )
+	{
+		// every index 0, which is c0 in either mode:
+
+		error = 0;
+		for( int i = 0; i < 16; i++ )
+		{
+			indices[i] = 0;
+			for( int k = 0; k < 3; k++ )
+			{
+				int d = b.Color[4*i+k] - palette[k];
+				error += d*d;
+			}
+		}
+	}
+	else
+	{
+		error = FitBc1Indices( b, palette, indices );
+	}
+
+	unsigned int bits = 0;
+	for( int i = 0; i < 16; i++ )
+		bits |= (unsigned int)indices[i] << ( 2*i );
+
+	out[0] = (unsigned char)( c0 & 0xff );
+	out[1] = (unsigned char)( c0 >> 8 );
+	out[2] = (unsigned char)( c1 & 0xff );
+	out[3] = (unsigned char)( c1 >> 8 );
+	out[4] = (unsigned char)( bits & 0xff );
+	out[5] = (unsigned char)( ( bits >> 8 ) & 0xff );
+	out[6] = (unsigned char)( ( bits >> 16 ) & 0xff );
+	out[7] = (unsigned char)( bits >> 24 );
+	return error;
+}
+
+
+// BCFAST: the corners of the block's color bounding box, inset a little, and on the
+// diagonal that follows whichever way the other channels lean against the widest one:
+
+static void
+EncodeBc1Fast( const BcBlock &b, unsigned char out[8] )
+{
+	int lo[3], hi[3];
+
+#ifdef BCSSE2
+	__m128i mn = _mm_load_si128( (const __m128i *)&b.Color[0] );
+	__m128i mx = mn;
+	for( int j = 1; j < 4; j++ )
+	{
+		__m128i p = _mm_load_si128( (const __m128i *)&b.Color[16*j] );
+		mn = _mm_min_epu8( mn, p );
+		mx = _mm_max_epu8( mx, p );
+	}
+	mn = _mm_min_epu8( mn, _mm_srli_si128( mn, 8 ) );
+	mn = _mm_min_epu8( mn, _mm_srli_si128( mn, 4 ) );
+	mx = _mm_max_epu8( mx, _mm_srli_si128( mx, 8 ) );
+	mx = _mm_max_epu8( mx, _mm_srli_si128( mx, 4 ) );
+	int mn4 = _mm_cvtsi128_si32( mn );
+	int mx4 = _mm_cvtsi128_si32( mx );
+	for( int k = 0; k < 3; k++ )
+	{
+		lo[k] = ( mn4 >> ( 8*k ) ) & 0xff;
+		hi[k] = ( mx4 >> ( 8*k ) ) & 0xff;
+	}
+#else
+	for( int k = 0; k < 3; k++ )
+	{
+		lo[k] = 255;
+		hi[k] = 0;
+	}
+	for( int i = 0; i < 16; i++ )
+	{
+		for( int k = 0; k < 3; k++ )
+		{
+			int c = b.Color[4*i+k];
+			if( c < lo[k] )	lo[k] = c;
+			if( c > hi[k] )	hi[k] = c;
+		}
+	}
+#endif
+
+	// pull the corners in by 1/16 of the box, since the texels at the very corners are rare:
+
+	for( int k = 0; k < 3; k++ )
+	{
+		int inset = ( hi[k] - lo[k] ) >> 4;
+		lo[k] += inset;
+		hi[k] -= inset;
+	}
+
+	// flip the channels that fall as the widest one rises:
+
+	int widest = 0;
+	for( int k = 1; k < 3; k++ )
+		if( hi[k] - lo[k] > hi[widest] - lo[widest] )
+			widest = k;
+
+	int mid[3];
+	for( int k = 0; k < 3; k++ )
+		mid[k] = lo[k] + hi[k];
+	for( int k = 0; k < 3; k++ )
+	{
+		if( k == widest )
+			continue;
+		int cov = 0;
+		for( int i = 0; i < 16; i++ )
+			cov += ( 2*b.Color[4*i+widest] - mid[widest] ) * ( 2*b.Color[4*i+k] - mid[k] );
+		if( cov < 0 )
+		{
+			int t = lo[k];
+			lo[k] = hi[k];
+			hi[k] = t;
+		}
+	}
+
+	int indices[16];
+	MakeBc1Block( b, hi, lo, out, indices );
+}
+
+
+// BCQUALITY: endpoints at the texels furthest along the block's principal axis, then moved
+// to wherever least squares says the chosen indices want them, for as long as that helps:
+
+static void
+EncodeBc1Quality( const BcBlock &b, unsigned char out[8] )
+{
+	double mean[3] = { 0., 0., 0. };
+	for( int i = 0; i < 16; i++ )
+		for( int k = 0; k < 3; k++ )
+			mean[k] += b.Color[4*i+k];
+	for( int k = 0; k < 3; k++ )
+		mean[k] /= 16.;
+
+	double cov[6] = { 0., 0., 0., 0., 0., 0. };	// rr, rg, rb, gg, gb, bb
+	for( int i = 0; i < 16; i++ )
+	{
+		double r = b.Color[4*i+0] - mean[0];
+		double g = b.Color[4*i+1] - mean[1];
+		double bl = b.Color[4*i+2] - mean[2];
+		cov[0] += r*r;	cov[1] += r*g;	cov[2] += r*bl;
+		cov[3] += g*g;	cov[4] += g*bl;	cov[5] += bl*bl;
+	}
+
+	double axis[3] = { 1., 1., 1. };
+	for( int step = 0; step < BCPOWERSTEPS; step++ )
+	{
+		double x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		double y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		double z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		double len = fmax( fabs( x ), fmax( fabs( y ), fabs( z ) ) );
+		if( len < 1.e-9 )
+			break;
+		axis[0] = x / len;
+		axis[1] = y / len;
+		axis[2] = z / len;
+	}
+
+	int lowest = 0, highest = 0;
+	double lo = 1.e+37, hi = -1.e+37;
+	for( int i = 0; i < 16; i++ )
+	{
+		double t = b.Color[4*i+0]*axis[0] + b.Color[4*i+1]*axis[1] + b.Color[4*i+2]*axis[2];
+		if( t < lo )	{ lo = t;	lowest = i; }
+		if( t > hi )	{ hi = t;	highest = i; }
+	}
+
+	int e0[3], e1[3];
+	for( int k = 0; k < 3; k++ )
+	{
+		e0[k] = b.Color[4*highest+k];
+		e1[k] = b.Color[4*lowest+k];
+	}
+
+	int indices[16];
+	int error = MakeBc1Block( b, e0, e1, out, indices );
+
+	// index 0 is all c0, 1 is all c1, 2 is 2/3 c0, 3 is 1/3 c0:
+
+	static const double weights[4] = { 1., 0., 2./3., 1./3. };
+	for( int pass = 0; pass < BCREFINEPASSES  &&  error > 0; pass++ )
+	{
+		double aa = 0., bb = 0., ab = 0.;
+		double ax[3] = { 0., 0., 0. }, bx[3] = { 0., 0., 0. };
+		for( int i = 0; i < 16; i++ )
+		{
+			double w = weights[ indices[i] ];
+			aa += w * w;
+			bb += ( 1. - w ) * ( 1. - w );
+			ab += w * ( 1. - w );
+			for( int k = 0; k < 3; k++ )
+			{
+				ax[k] += w * b.Color[4*i+k];
+				bx[k] += ( 1. - w ) * b.Color[4*i+k];
+			}
+		}
+		double det = aa * bb - ab * ab;
+		if( fabs( det ) < 1.e-9 )
+			break;
+
+		for( int k = 0; k < 3; k++ )
+		{
+			e0[k] = ClampByte( ( ax[k] * bb - bx[k] * ab ) / det );
+			e1[k] = ClampByte( ( bx[k] * aa - ax[k] * ab ) / det );
+		}
+
+		unsigned char refined[8];
+		int refinedIndices[16];
+		int refinedError = MakeBc1Block( b, e0, e1, refined, refinedIndices );
+		if( refinedError >= error )
+			break;
+
+		memcpy( out, refined, 8 );
+		memcpy( indices, refinedIndices, sizeof(indices) );
+		error = refinedError;
+	}
+}
+
+
+// the BC3 alpha block: the block's alpha range in 8 steps, 3 index bits per texel:
+
+static void
+EncodeBc3Alpha( const BcBlock &b, unsigned char out[8] )
+{
+	int a0 = 0, a1 = 255;
+	for( int i = 0; i < 16; i++ )
+	{
+		if( b.Alpha[i] > a0 )	a0 = b.Alpha[i];
+		if( b.Alpha[i] < a1 )	a1 = b.Alpha[i];
+	}
+
+	// a0 > a1 picks the 8-value mode:
+
+	int palette[8];
+	palette[0] = a0;
+	palette[1] = a1;
+	for( int k = 2; k < 8; k++ )
+		palette[k] = ( ( 8 - k ) * a0 + ( k - 1 ) * a1 ) / 7;
+
+	unsigned long long bits = 0;
+	if( a0 > a1 )
+	{
+		for( int i = 0; i < 16; i++ )
+		{
+			int best = 256, bestIndex = 0;
+			for( int k = 0; k < 8; k++ )
+			{
+				int d = b.Alpha[i] - palette[k];
+				if( d < 0 )
+					d = -d;
+				if( d < best )
+				{
+					best = d;
+					bestIndex = k;
+				}
+			}
+			bits |= (unsigned long long)bestIndex << ( 3*i );
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for( int k = 0; k < 6; k++ )
+		out[2+k] = (unsigned char)( ( bits >> ( 8*k ) ) & 0xff );
+}
+
+
+// compress a width x height image of comps (3 or 4) bytes per texel, a block row per job:
+
+static void
+CompressBcImage( const unsigned char *texels, int width, int height, int comps, int mode, std::vector<unsigned char> &blocks )
+{
+	int bw = ( width + 3 ) / 4;
+	int bh = ( height + 3 ) / 4;
+	int blockBytes = ( comps == 4 ) ? 16 : 8;
+	blocks.resize( (size_t)bw * bh * blockBytes );
+	if( width <= 0  ||  height <= 0 )
+		return;
+
+	unsigned char *dst = &blocks[0];
+	ParallelFor( bh, [&]( int by )
+	{
+		BcBlock b;
+		for( int bx = 0; bx < bw; bx++ )
+		{
+			GatherBcBlock( texels, width, height, comps, bx, by, b );
+			unsigned char *out = &dst[ ( (size_t)bw * by + bx ) * blockBytes ];
+			if( comps == 4 )
+			{
+				EncodeBc3Alpha( b, out );
+				out += 8;
+			}
+			if( mode == BCQUALITY )
+				EncodeBc1Quality( b, out );
+			else
+				EncodeBc1Fast( b, out );
+		}
+	} );
+}
+
+
+// compress RGB texels to BC1:
+
+void
+CompressBc1( const unsigned char *texels, int width, int height, int mode, std::vector<unsigned char> &blocks )
+{
+	CompressBcImage( texels, width, height, 3, mode, blocks );
+}
+
+
+// compress RGBA texels to BC3:
+
+void
+CompressBc3( const unsigned char *texels, int width, int height, int mode, std::vector<unsigned char> &blocks )
+{
+	CompressBcImage( texels, width, height, 4, mode, blocks );
+}
+
+
+// decode blocks back into texels of comps bytes each:
+
+static void
+DecompressBcImage( const unsigned char *blocks, int width, int height, int comps, unsigned char *texels )
+{
+	int bw = ( width + 3 ) / 4;
+	int bh = ( height + 3 ) / 4;
+	int blockBytes = ( comps == 4 ) ? 16 : 8;
+
+	for( int by = 0; by < bh; by++ )
+	{
+		for( int bx = 0; bx < bw; bx++ )
+		{
+			const unsigned char *in = &blocks[ ( (size_t)bw * by + bx ) * blockBytes ];
+
+			int alpha[8];
+			unsigned long long alphaBits = 0;
+			if( comps == 4 )
+			{
+				alpha[0] = in[0];
+				alpha[1] = in[1];
+				if( alpha[0] > alpha[1] )
+				{
+					for( int k = 2; k < 8; k++ )
+						alpha[k] = ( ( 8 - k ) * alpha[0] + ( k - 1 ) * alpha[1] ) / 7;
+				}
+				else
+				{
+					for( int k = 2; k < 6; k++ )
+						alpha[k] = ( ( 6 - k ) * alpha[0] + ( k - 1 ) * alpha[1] ) / 5;
+					alpha[6] = 0;
+					alpha[7] = 255;
+				}
+				for( int k = 0; k < 6; k++ )
+					alphaBits |= (unsigned long long)in[2+k] << ( 8*k );
+				in += 8;
+			}
+
+			unsigned short c0 = (unsigned short)( in[0] | in[1] << 8 );
+			unsigned short c1 = (unsigned short)( in[2] | in[3] << 8 );
+			unsigned int bits = (unsigned int)in[4] | (unsigned int)in[5] << 8 | (unsigned int)in[6] << 16 | (unsigned int)in[7] << 24;
+
+			int a[3], b[3], palette[4][3];
+			UnpackRgb565( c0, a );
+			UnpackRgb565( c1, b );
+			for( int k = 0; k < 3; k++ )
+			{
+				palette[0][k] = a[k];
+				palette[1][k] = b[k];
+				if( c0 > c1  ||  comps == 4 )
+				{
+					palette[2][k] = ( 2*a[k] + b[k] ) / 3;
+					palette[3][k] = ( a[k] + 2*b[k] ) / 3;
+				}
+				else
+				{
+					palette[2][k] = ( a[k] + b[k] ) / 2;
+					palette[3][k] = 0;
+				}
+			}
+
+			for( int y = 0; y < 4  &&  4*by + y < height; y++ )
+			{
+				for( int x = 0; x < 4  &&  4*bx + x < width; x++ )
+				{
+					int i = 4*y + x;
+					unsigned char *t = &texels[ comps * ( (size_t)width * ( 4*by + y ) + 4*bx + x ) ];
+					const int *c = palette[ ( bits >> ( 2*i ) ) & 3 ];
+					t[0] = (unsigned char)c[0];
+					t[1] = (unsigned char)c[1];
+					t[2] = (unsigned char)c[2];
+					if( comps == 4 )
+						t[3] = (unsigned char)alpha[ ( alphaBits >> ( 3*i ) ) & 7 ];
+				}
+			}
+		}
+	}
+}
+
+
+// decode BC1 blocks into RGB texels:
+
+void
+DecompressBc1( const unsigned char *blocks, int width, int height, unsigned char *texels )
+{
+	DecompressBcImage( blocks, width, height, 3, texels );
+}
+
+
+// decode BC3 blocks into RGBA texels:
+
+void
+DecompressBc3( const unsigned char *blocks, int width, int height, unsigned char *texels )
+{
+	DecompressBcImage( blocks, width, height, 4, texels );
+}
+
+
+// the peak signal-to-noise ratio between two arrays of n bytes, in dB:
+
+double
+GetPsnr( const unsigned char *a, const unsigned char *b, size_t n )
+{
+	double sum = 0.;
+	for( size_t i = 0; i < n; i++ )
+	{
+		double d = (double)a[i] - (double)b[i];
+		sum += d * d;
+	}
+	if( n == 0  ||  sum == 0. )
+		return 99.;
+	return 10. * log10( 255. * 255. * (double)n / sum );
+}
+
+
+// compress a RGB texture and its mipmap chain to BC1:
+
+void
+CompressMipChain( const unsigned char *texels, int width, int height, const std::vector<MipLevel> &mips, int mode, BcTexture &tex )
+{
+	tex.Format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	tex.Levels.clear( );
+	tex.Psnr = 0.;
+	if( texels == NULL  ||  width <= 0  ||  height <= 0 )
+		return;
+
+	tex.Levels.resize( 1 + mips.size() );
+	tex.Levels[0].Width = width;
+	tex.Levels[0].Height = height;
+	CompressBc1( texels, width, height, mode, tex.Levels[0].Blocks );
+	for( size_t i = 0; i < mips.size(); i++ )
+	{
+		tex.Levels[i+1].Width = mips[i].Width;
+		tex.Levels[i+1].Height = mips[i].Height;
+		CompressBc1( &mips[i].Texels[0], mips[i].Width, mips[i].Height, mode, tex.Levels[i+1].Blocks );
+	}
+
+	std::vector<unsigned char> back( 3 * (size_t)width * height );
+	DecompressBc1( &tex.Levels[0].Blocks[0], width, height, &back[0] );
+	tex.Psnr = GetPsnr( texels, &back[0], back.size() );
+}
+
+
+// upload a compressed texture and its chain to the bound GL_TEXTURE_2D
+// (false if there is nothing to upload or the driver can't take S3TC):
+
+bool
+UploadBcTexture( const BcTexture &tex )
+{
+	if( tex.Levels.empty( )  ||  ! GLEW_EXT_texture_compression_s3tc )
+		return false;
+
+	for( size_t i = 0; i < tex.Levels.size(); i++ )
+	{
+		const BcLevel &level = tex.Levels[i];
+		glCompressedTexImage2D( GL_TEXTURE_2D, (GLint)i, tex.Format, level.Width, level.Height, 0,
+			(GLsizei)level.Blocks.size(), &level.Blocks[0] );
+	}
+
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)tex.Levels.size() - 1 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, tex.Levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	return true;
+}
+
+
+// benchmark: time compressing a texture in each mode and report how close it comes back
+// (best of a few runs, on however many threads ParallelFor uses)
+
+void
+BenchmarkBcTexture( const char *name, const unsigned char *texels, int width, int height )
+{
+	static const char *modeNames[2] = { "fast", "quality" };
+
+	if( texels == NULL )
+		return;
+
+	size_t rawBytes = 3 * (size_t)width * height;
+	std::vector<unsigned char> back( rawBytes );
+
+	fprintf( stderr, "%-32s %4d x %4d", name, width, height );
+	for( int mode = BCFAST; mode <= BCQUALITY; mode++ )
+	{
+		std::vector<unsigned char> blocks;
+		double best = 1.e+37;
+		for( int run = 0; run < 3; run++ )
+		{
+			std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+			CompressBc1( texels, width, height, mode, blocks );
+			double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+			if( ms < best )
+				best = ms;
+		}
+
+		DecompressBc1( &blocks[0], width, height, &back[0] );
+		fprintf( stderr, "  %s: %6.2f ms, %5.2f dB", modeNames[mode], best, GetPsnr( texels, &back[0], rawBytes ) );
+		if( mode == BCFAST )
+			fprintf( stderr, ", %d -> %d KB", (int)( rawBytes / 1024 ), (int)( blocks.size() / 1024 ) );
+	}
+	fprintf( stderr, "  (%d threads)\n", NumWorkerThreads( ) );
+}
@@ -0,0 +1,141 @@
+#include "bmptexture.h"
+#include "mappedfile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define BMPSSE2
+#include <emmintrin.h>
+#endif
+
+
+#define BMPFILEHEADER		14		// bytes in the BITMAPFILEHEADER
+#define BMPINFOHEADER		40		// bytes in the smallest BITMAPINFOHEADER we can read
+#define BI_RGB			0		// the only compression we support: none
+
+
+static inline int
+GetBmpInt( const unsigned char *p )
+{
+	return (int)( (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24 );
+}
+
+
+static inline int
+GetBmpShort( const unsigned char *p )
+{
+	return (short)( p[0] | p[1] << 8 );
+}
+
+
+// turn one row of n BGR texels into RGB:
+
+static void
+SwizzleBmpRow( const unsigned char *src, unsigned char *dst, int n )
+{
+	int s = 0;
+
+#ifdef BMPSSE2
+	// 5 texels are 15 bytes: swap bytes 0 and 2 of each by shifting the whole register a
+	// byte pair each way and picking. the 16th byte written is junk that the next group
+	// overwrites, so there must always be a 6th texel after the group, in both rows:
+
+	const __m128i keep = _mm_setr_epi8( 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0 );
+	const __m128i down = _mm_setr_epi8( -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0 );
+	const __m128i up   = _mm_setr_epi8( 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0 );
+	for( ; s + 6 <= n; s += 5 )
+	{
+		__m128i bgr = _mm_loadu_si128( (const __m128i *)( src + 3*s ) );
+		__m128i rgb = _mm_or_si128( _mm_and_si128( bgr, keep ),
+				_mm_or_si128( _mm_and_si128( _mm_srli_si128( bgr, 2 ), down ),
+					      _mm_and_si128( _mm_slli_si128( bgr, 2 ), up ) ) );
+		_mm_storeu_si128( (__m128i *)( dst + 3*s ), rgb );
+	}
+#endif
+
+	for( ; s < n; s++ )
+	{
+		dst[3*s+0] = src[3*s+2];
+		dst[3*s+1] = src[3*s+1];
+		dst[3*s+2] = src[3*s+0];
+	}
+}
+
+
+// read a BMP file into a Texture:
+
+unsigned char *
+BmpToTexture( const char *filename, int *width, int *height )
+{
+	MappedFile file;
+	if( ! MapFile( filename, &file ) )
+	{
+		fprintf( stderr, "Cannot open Bmp file '%s'\n", filename );
+		return NULL;
+	}
+
+	const unsigned char *data = (const unsigned char *)file.Data;
+	if( file.Size < BMPFILEHEADER + BMPINFOHEADER  ||  GetBmpShort( &data[0] ) != 0x4d42 )
+	{
+		// if bfType is not 0x4d42, the file is not a bmp:
+
+		fprintf( stderr, "File '%s' is the wrong type of file: 0x%0x\n", filename,
+			file.Size >= 2 ? GetBmpShort( &data[0] ) & 0xffff : 0 );
+		UnmapFile( &file );
+		return NULL;
+	}
+
+	const unsigned char *info = &data[ BMPFILEHEADER ];
+	size_t offBits = (size_t)(unsigned int)GetBmpInt( &data[10] );
+	int nums = GetBmpInt( &info[4] );
+	int numt = GetBmpInt( &info[8] );
+	int bitCount = GetBmpShort( &info[14] );
+	int compression = GetBmpInt( &info[16] );
+
+	bool topDown = ( numt < 0 );
+	if( topDown )
+		numt = -numt;
+
+	fprintf( stderr, "Image size in file '%s' is: %d x %d\n", filename, nums, numt );
+
+
+	// we do not support compression, or anything but 24 bits per texel:
+
+	if( compression != BI_RGB )
+	{
+		fprintf( stderr, "Image file '%s' has the wrong type of image compression: %d\n", filename, compression );
+		UnmapFile( &file );
+		return NULL;
+	}
+	if( bitCount != 24 )
+	{
+		fprintf( stderr, "Image file '%s' has %d bits per texel, not 24\n", filename, bitCount );
+		UnmapFile( &file );
+		return NULL;
+	}
+
+
+	// each row is padded out to a multiple of 4 bytes:
+
+	size_t rowBytes = 4 * ( ( 3 * (size_t)nums + 3 ) / 4 );
+	if( nums <= 0  ||  numt <= 0  ||  offBits > file.Size  ||  ( file.Size - offBits ) / rowBytes < (size_t)numt )
+	{
+		fprintf( stderr, "Image file '%s' is too short for its %d x %d texels\n", filename, nums, numt );
+		UnmapFile( &file );
+		return NULL;
+	}
+
+	unsigned char * texture = new unsigned char[ 3 * (size_t)nums * numt ];
+	for( int t = 0; t < numt; t++ )
+	{
+		int row = topDown ? numt - 1 - t : t;
+		SwizzleBmpRow( &data[ offBits + (size_t)t * rowBytes ], &texture[ 3 * (size_t)nums * row ], nums );
+	}
+
+	UnmapFile( &file );
+
+	*width = nums;
+	*height = numt;
+	return texture;
+}
@@ -0,0 +1,22 @@
+/*****************************************************************
+* Description: Reads uncompressed 24-bit BMP files into texel
+*              arrays for glTexImage2D( ..., GL_RGB, GL_UNSIGNED_BYTE ).
+*
+*              BmpToTexture() maps the whole file, starts at the
+*              pixels wherever bfOffBits says they are, and turns each
+*              row of BGR triples into RGB while skipping the row's
+*              padding, 5 texels at a time with SSE2 where it is
+*              available. The texels come back bottom row first, as
+*              OpenGL wants them, whether the file was stored
+*              bottom-up (positive biHeight) or top-down (negative).
+*
+*              The array is allocated with new[ ]; the caller owns it.
+*/
+
+#pragma once
+#ifndef BMPTEXTURE_H
+#define BMPTEXTURE_H
+
+unsigned char *	BmpToTexture( const char *, int *, int * );
+
+#endif
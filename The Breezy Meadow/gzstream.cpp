@@ -0,0 +1,670 @@
+#include "gzstream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+// where ReadGzStream( ) is in the file:
+
+#define GZHEADER		0		// between members
+#define GZBLOCK			1		// at the start of a block
+#define GZSTORED		2		// copying a stored block
+#define GZCODES			3		// decoding a huffman-coded block
+#define GZTRAILER		4		// after the last block of a member
+#define GZDONE			5
+
+
+// the base value and number of extra bits of each length and distance symbol:
+
+static const short LengthBase[29] =
+{
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const short LengthExtra[29] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short DistanceBase[30] =
+{
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const short DistanceExtra[30] =
+{
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// the order a dynamic block sends its code length code lengths in:
+
+static const unsigned char CodeLengthOrder[19] =
+{
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+
+// CRC-32 tables for the gzip polynomial: Entry[0] is the usual byte-at-a-time table,
+// Entry[k] advances a byte k bytes further, so four bytes can be done at once
+
+struct GzCrcTable
+{
+	unsigned int	Entry[4][256];
+
+	GzCrcTable( )
+	{
+		for( unsigned int i = 0; i < 256; i++ )
+		{
+			unsigned int c = i;
+			for( int k = 0; k < 8; k++ )
+				c = ( c & 1 ) ? 0xedb88320u ^ ( c >> 1 ) : c >> 1;
+			Entry[0][i] = c;
+		}
+		for( unsigned int i = 0; i < 256; i++ )
+			for( int k = 1; k < 4; k++ )
+				Entry[k][i] = Entry[0][ Entry[k-1][i] & 0xff ] ^ ( Entry[k-1][i] >> 8 );
+	}
+};
+
+static unsigned int
+UpdateGzCrc( unsigned int crc, const char *p, size_t n )
+{
+	static const GzCrcTable table;
+	const unsigned char *q = (const unsigned char *)p;
+
+	crc = ~crc;
+	for( ; n >= 4; n -= 4, q += 4 )
+	{
+		crc ^= (unsigned int)q[0] | (unsigned int)q[1] << 8 | (unsigned int)q[2] << 16 | (unsigned int)q[3] << 24;
+		crc = table.Entry[3][ crc & 0xff ] ^ table.Entry[2][ ( crc >> 8 ) & 0xff ] ^
+		      table.Entry[1][ ( crc >> 16 ) & 0xff ] ^ table.Entry[0][ crc >> 24 ];
+	}
+	for( ; n > 0; n--, q++ )
+		crc = table.Entry[0][ ( crc ^ *q ) & 0xff ] ^ ( crc >> 8 );
+	return ~crc;
+}
+
+
+// the next compressed byte, or -1 at the end of the file:
+
+static inline int
+NextGzByte( GzStream *s )
+{
+	if( s->InPos == s->InLen )
+	{
+		s->InLen = fread( s->In, 1, GZINBYTES, s->Fp );
+		s->InPos = 0;
+		s->CompressedBytes += s->InLen;
+		if( s->InLen == 0 )
+			return -1;
+	}
+	return s->In[ s->InPos++ ];
+}
+
+
+// make sure at least n (<= 57) bits are waiting:
+// running off the end of the file is an error, and reads as 0 bits
+
+static inline void
+FillGzBits( GzStream *s, int n )
+{
+	while( s->NumBits < n )
+	{
+		int c = NextGzByte( s );
+		if( c < 0 )
+		{
+			s->Error = true;
+			c = 0;
+		}
+		s->Bits |= (unsigned long long)c << s->NumBits;
+		s->NumBits += 8;
+	}
+}
+
+
+// use up n bits that are already waiting:
+
+static inline unsigned int
+TakeGzBits( GzStream *s, int n )
+{
+	unsigned int v = (unsigned int)( s->Bits & ( ( 1ull << n ) - 1 ) );
+	s->Bits >>= n;
+	s->NumBits -= n;
+	return v;
+}
+
+
+static inline unsigned int
+GetGzBits( GzStream *s, int n )
+{
+	FillGzBits( s, n );
+	return TakeGzBits( s, n );
+}
+
+
+// skip to the next byte boundary, the way stored blocks and trailers start:
+
+static inline void
+AlignGzBits( GzStream *s )
+{
+	TakeGzBits( s, s->NumBits & 7 );
+}
+
+
+// true if the file has no more bytes (only asked between members, when the bits are byte-aligned):
+
+static bool
+AtGzEnd( GzStream *s )
+{
+	if( s->NumBits > 0 )
+		return false;
+
+	int c = NextGzByte( s );
+	if( c < 0 )
+		return true;
+
+	s->Bits = (unsigned long long)c;
+	s->NumBits = 8;
+	return false;
+}
+
+
+// read a member header, skipping the optional fields:
+// returns false if it is not a gzip header
+
+static bool
+ReadGzHeader( GzStream *s )
+{
+	if( GetGzBits( s, 8 ) != 0x1f  ||  GetGzBits( s, 8 ) != 0x8b  ||  GetGzBits( s, 8 ) != 8 )
+		return false;
+
+	unsigned int flags = GetGzBits( s, 8 );
+	for( int i = 0; i < 6; i++ )			// mtime, xfl, os
+		GetGzBits( s, 8 );
+
+	if( flags & 0x04 )				// FEXTRA
+	{
+		unsigned int n = GetGzBits( s, 16 );
+		for( unsigned int i = 0; i < n; i++ )
+			GetGzBits( s, 8 );
+	}
+	if( flags & 0x08 )				// FNAME
+	{
+		while( GetGzBits( s, 8 ) != 0  &&  ! s->Error )
+			;
+	}
+	if( flags & 0x10 )				// FCOMMENT
+	{
+		while( GetGzBits( s, 8 ) != 0  &&  ! s->Error )
+			;
+	}
+	if( flags & 0x02 )				// FHCRC
+		GetGzBits( s, 16 );
+
+	return ! s->Error;
+}
+
+
+// make the canonical code with these code lengths:
+// returns false if the lengths ask for more codes than there are
+
+static bool
+BuildGzHuffman( GzHuffman *h, const unsigned char *lengths, int n )
+{
+	memset( h->Count, 0, sizeof(h->Count) );
+	for( int i = 0; i < n; i++ )
+		h->Count[ lengths[i] ]++;
+	h->Count[0] = 0;
+
+	int left = 1;
+	for( int len = 1; len < 16; len++ )
+	{
+		left <<= 1;
+		left -= h->Count[len];
+		if( left < 0 )
+			return false;
+	}
+
+	short offsets[16];
+	offsets[1] = 0;
+	for( int len = 1; len < 15; len++ )
+		offsets[len+1] = offsets[len] + h->Count[len];
+	for( int i = 0; i < n; i++ )
+	{
+		if( lengths[i] != 0 )
+			h->Symbol[ offsets[ lengths[i] ]++ ] = (short)i;
+	}
+
+
+	// the short codes also go in the lookup table, bit-reversed since deflate sends codes high bit first:
+
+	memset( h->Fast, 0, sizeof(h->Fast) );
+	int code = 0;
+	int index = 0;
+	for( int len = 1; len <= GZFASTBITS; len++ )
+	{
+		for( int k = 0; k < h->Count[len]; k++ )
+		{
+			int reversed = 0;
+			for( int b = 0; b < len; b++ )
+				reversed |= ( ( code >> b ) & 1 ) << ( len - 1 - b );
+
+			unsigned short entry = (unsigned short)( ( h->Symbol[index] << 4 ) | len );
+			for( int f = reversed; f < ( 1 << GZFASTBITS ); f += ( 1 << len ) )
+				h->Fast[f] = entry;
+
+			code++;
+			index++;
+		}
+		code <<= 1;
+	}
+
+	return true;
+}
+
+
+// decode one symbol from bits that are already waiting (at least 15 of them):
+// returns -1 for a code that isn't in the table
+
+static inline int
+DecodeGz( GzStream *s, const GzHuffman *h )
+{
+	unsigned int entry = h->Fast[ s->Bits & ( ( 1 << GZFASTBITS ) - 1 ) ];
+	if( entry != 0 )
+	{
+		TakeGzBits( s, entry & 15 );
+		return (int)( entry >> 4 );
+	}
+
+	// a longer code -- walk the lengths one bit at a time:
+
+	unsigned long long bits = s->Bits;
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	for( int len = 1; len < 16; len++ )
+	{
+		code |= (int)( bits & 1 );
+		bits >>= 1;
+		int count = h->Count[len];
+		if( code - count < first )
+		{
+			TakeGzBits( s, len );
+			return h->Symbol[ index + ( code - first ) ];
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+
+	return -1;
+}
+
+
+static bool
+BuildGzFixedCodes( GzStream *s )
+{
+	unsigned char lengths[288];
+	memset( &lengths[0],   8, 144 );
+	memset( &lengths[144], 9, 112 );
+	memset( &lengths[256], 7, 24 );
+	memset( &lengths[280], 8, 8 );
+	if( ! BuildGzHuffman( &s->Lengths, lengths, 288 ) )
+		return false;
+
+	memset( lengths, 5, 30 );
+	return BuildGzHuffman( &s->Distances, lengths, 30 );
+}
+
+
+// read the code lengths at the start of a dynamic block, and make its two codes from them:
+
+static bool
+BuildGzDynamicCodes( GzStream *s )
+{
+	int nlen  = GetGzBits( s, 5 ) + 257;
+	int ndist = GetGzBits( s, 5 ) + 1;
+	int ncode = GetGzBits( s, 4 ) + 4;
+	if( nlen > 286  ||  ndist > 30 )
+		return false;
+
+	unsigned char lengths[286 + 30];
+	memset( lengths, 0, sizeof(lengths) );
+	for( int i = 0; i < ncode; i++ )
+		lengths[ CodeLengthOrder[i] ] = (unsigned char)GetGzBits( s, 3 );
+
+	GzHuffman *codeLengths = &s->Lengths;		// free until the block's own codes are made
+	if( ! BuildGzHuffman( codeLengths, lengths, 19 ) )
+		return false;
+
+	memset( lengths, 0, sizeof(lengths) );
+	int i = 0;
+	while( i < nlen + ndist )
+	{
+		FillGzBits( s, 32 );
+		int sym = DecodeGz( s, codeLengths );
+		if( sym < 0 )
+			return false;
+
+		if( sym < 16 )
+		{
+			lengths[i++] = (unsigned char)sym;
+			continue;
+		}
+
+		unsigned char len = 0;
+		int repeat;
+		if( sym == 16 )
+		{
+			if( i == 0 )
+				return false;
+			len = lengths[i-1];
+			repeat = 3 + TakeGzBits( s, 2 );
+		}
+		else if( sym == 17 )
+			repeat = 3 + TakeGzBits( s, 3 );
+		else
+			repeat = 11 + TakeGzBits( s, 7 );
+
+		if( i + repeat > nlen + ndist )
+			return false;
+		while( repeat-- > 0 )
+			lengths[i++] = len;
+	}
+
+	if( lengths[256] == 0 )				// no end-of-block code
+		return false;
+
+	return BuildGzHuffman( &s->Lengths, lengths, nlen )  &&  BuildGzHuffman( &s->Distances, &lengths[nlen], ndist );
+}
+
+
+// copy as much of the pending match as fits:
+// buf[start..out) are this member's bytes so far in this call, the window holds the ones before
+
+static size_t
+CopyGzMatch( GzStream *s, char *buf, size_t out, size_t n, size_t start )
+{
+	size_t dist = (size_t)s->CopyDistance;
+	while( s->CopyLength > 0  &&  out < n )
+	{
+		if( dist <= out - start )
+			buf[out] = buf[ out - dist ];
+		else
+			buf[out] = (char)s->Window[ ( s->Total + ( out - start ) - dist ) & ( GZWINDOW - 1 ) ];
+		out++;
+		s->CopyLength--;
+	}
+	return out;
+}
+
+
+// decode literals and matches into buf until it is full or the block ends:
+
+static size_t
+InflateGzCodes( GzStream *s, char *buf, size_t out, size_t n, size_t start )
+{
+	while( out < n )
+	{
+		// enough for the longest length and distance codes with their extra bits:
+
+		if( s->NumBits < 48 )
+			FillGzBits( s, 56 );
+
+		int sym = DecodeGz( s, &s->Lengths );
+		if( sym < 256 )
+		{
+			if( sym < 0 )
+			{
+				s->Error = true;
+				break;
+			}
+			buf[out++] = (char)sym;
+			continue;
+		}
+
+		if( sym == 256 )
+		{
+			s->State = GZBLOCK;
+			break;
+		}
+
+		sym -= 257;
+		if( sym >= 29 )
+		{
+			s->Error = true;
+			break;
+		}
+		int len = LengthBase[sym] + TakeGzBits( s, LengthExtra[sym] );
+
+		int dsym = DecodeGz( s, &s->Distances );
+		if( dsym < 0  ||  dsym >= 30 )
+		{
+			s->Error = true;
+			break;
+		}
+		int dist = DistanceBase[dsym] + TakeGzBits( s, DistanceExtra[dsym] );
+		if( (unsigned long long)dist > s->Total + ( out - start ) )
+		{
+			s->Error = true;			// reaches back before the start of the file
+			break;
+		}
+
+		s->CopyLength = len;
+		s->CopyDistance = dist;
+		out = CopyGzMatch( s, buf, out, n, start );
+	}
+
+	return out;
+}
+
+
+// copy the rest of a stored block, straight out of the input buffer once the bits are used up:
+
+static size_t
+CopyGzStored( GzStream *s, char *buf, size_t out, size_t n )
+{
+	while( s->Stored > 0  &&  out < n  &&  s->NumBits > 0 )
+	{
+		buf[out++] = (char)GetGzBits( s, 8 );
+		s->Stored--;
+	}
+
+	while( s->Stored > 0  &&  out < n )
+	{
+		if( s->InPos == s->InLen )
+		{
+			int c = NextGzByte( s );
+			if( c < 0 )
+			{
+				s->Error = true;
+				break;
+			}
+			buf[out++] = (char)c;
+			s->Stored--;
+			continue;
+		}
+
+		size_t k = s->InLen - s->InPos;
+		if( k > s->Stored )
+			k = s->Stored;
+		if( k > n - out )
+			k = n - out;
+		memcpy( &buf[out], &s->In[ s->InPos ], k );
+		s->InPos += k;
+		out += k;
+		s->Stored -= (unsigned int)k;
+	}
+
+	return out;
+}
+
+
+// account for bytes just written for the current member: checksum them and remember the last 32 KB
+
+static void
+FinishGzOutput( GzStream *s, const char *p, size_t n )
+{
+	if( n == 0 )
+		return;
+
+	s->Crc = UpdateGzCrc( s->Crc, p, n );
+
+	if( n > GZWINDOW )
+	{
+		s->Total += n - GZWINDOW;
+		p += n - GZWINDOW;
+		n = GZWINDOW;
+	}
+
+	size_t at = (size_t)( s->Total & ( GZWINDOW - 1 ) );
+	size_t first = GZWINDOW - at;
+	if( first > n )
+		first = n;
+	memcpy( &s->Window[at], p, first );
+	memcpy( &s->Window[0], p + first, n - first );
+	s->Total += n;
+}
+
+
+// open a .gz file and read its first header:
+// returns false if the file cannot be opened or is not gzip
+
+bool
+OpenGzStream( const char *name, GzStream *s )
+{
+	memset( s, 0, sizeof(GzStream) );
+
+	s->Fp = fopen( name, "rb" );
+	if( s->Fp == NULL )
+		return false;
+
+	s->In = (unsigned char *) malloc( GZINBYTES );
+	s->Window = (unsigned char *) malloc( GZWINDOW );
+	if( s->In == NULL  ||  s->Window == NULL  ||  ! ReadGzHeader( s ) )
+	{
+		CloseGzStream( s );
+		return false;
+	}
+
+	s->State = GZBLOCK;
+	return true;
+}
+
+
+void
+CloseGzStream( GzStream *s )
+{
+	if( s->Fp != NULL )
+		fclose( s->Fp );
+	free( s->In );
+	free( s->Window );
+	s->Fp = NULL;
+	s->In = NULL;
+	s->Window = NULL;
+	s->State = GZDONE;
+}
+
+
+// inflate up to n more bytes of the original file into buf:
+// returns the number of bytes inflated -- fewer than n only at the end of the file or on an error
+
+size_t
+ReadGzStream( GzStream *s, char *buf, size_t n )
+{
+	size_t out = 0;
+	size_t start = 0;			// where the current member's bytes begin in buf
+
+	while( out < n  &&  s->State != GZDONE  &&  ! s->Error )
+	{
+		if( s->CopyLength > 0 )
+		{
+			out = CopyGzMatch( s, buf, out, n, start );
+			continue;
+		}
+
+		switch( s->State )
+		{
+			case GZHEADER:
+				// another member, or trailing zeros that gzip would also ignore:
+
+				if( AtGzEnd( s )  ||  ! ReadGzHeader( s ) )
+				{
+					s->Error = false;
+					s->State = GZDONE;
+					break;
+				}
+				s->State = GZBLOCK;
+				s->Total = 0;
+				s->Crc = 0;
+				break;
+
+			case GZBLOCK:
+			{
+				if( s->LastBlock )
+				{
+					s->State = GZTRAILER;
+					break;
+				}
+
+				s->LastBlock = ( GetGzBits( s, 1 ) != 0 );
+				unsigned int type = GetGzBits( s, 2 );
+				if( type == 0 )
+				{
+					AlignGzBits( s );
+					s->Stored = GetGzBits( s, 16 );
+					if( GetGzBits( s, 16 ) != ( ~s->Stored & 0xffff ) )
+						s->Error = true;
+					s->State = GZSTORED;
+				}
+				else if( type == 1 )
+				{
+					s->Error = ! BuildGzFixedCodes( s );
+					s->State = GZCODES;
+				}
+				else if( type == 2 )
+				{
+					s->Error = ! BuildGzDynamicCodes( s );
+					s->State = GZCODES;
+				}
+				else
+					s->Error = true;
+				break;
+			}
+
+			case GZSTORED:
+				out = CopyGzStored( s, buf, out, n );
+				if( s->Stored == 0 )
+					s->State = GZBLOCK;
+				break;
+
+			case GZCODES:
+				out = InflateGzCodes( s, buf, out, n, start );
+				break;
+
+			case GZTRAILER:
+			{
+				FinishGzOutput( s, buf + start, out - start );
+				start = out;
+
+				AlignGzBits( s );
+				unsigned int crc = GetGzBits( s, 32 );
+				unsigned int size = GetGzBits( s, 32 );
+				if( crc != s->Crc  ||  size != (unsigned int)s->Total )
+					s->Error = true;
+				s->LastBlock = false;
+				s->State = GZHEADER;
+				break;
+			}
+		}
+	}
+
+	FinishGzOutput( s, buf + start, out - start );
+	s->Bytes += out;
+	return out;
+}
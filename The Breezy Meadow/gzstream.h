@@ -0,0 +1,63 @@
+/*****************************************************************
+* Description: Streaming reader for gzip-compressed files.
+*
+*              OpenGzStream() opens a .gz file and checks its header.
+*              ReadGzStream() inflates the next bytes of the original
+*              file into the caller's buffer, so a file of any size
+*              can be read through a buffer of any size - only the
+*              32 KB of history that DEFLATE refers back into is kept
+*              between calls. CloseGzStream() releases everything.
+*
+*              The CRC-32 and length in each member's trailer are
+*              checked; a bad or truncated file sets Error and ends the
+*              stream. Files made of several gzip members (cat a.gz
+*              b.gz, pigz) read as one.
+*/
+
+#pragma once
+#ifndef GZSTREAM_H
+#define GZSTREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define GZINBYTES		( 1 << 16 )	// compressed bytes read from the file at once
+#define GZWINDOW		( 1 << 15 )	// the farthest back a DEFLATE match can reach
+#define GZFASTBITS		10		// codes this short decode with one table lookup
+
+// one canonical huffman code:
+
+struct GzHuffman
+{
+	unsigned short	Fast[ 1 << GZFASTBITS ];	// ( symbol << 4 ) | length, by the next GZFASTBITS bits; 0 if longer
+	short		Count[16];			// number of codes of each length
+	short		Symbol[288];			// symbols in code order
+};
+
+struct GzStream
+{
+	FILE *			Fp;
+	unsigned char *		In;		// GZINBYTES of compressed input
+	size_t			InPos, InLen;
+	unsigned long long	Bits;		// bits not yet used, the next one in bit 0
+	int			NumBits;
+	unsigned char *		Window;		// the last GZWINDOW bytes written, at Total & (GZWINDOW-1)
+	unsigned long long	Total;		// bytes written by this member
+	int			State;
+	bool			LastBlock;
+	unsigned int		Stored;		// bytes left in a stored block
+	int			CopyLength;	// bytes left in a match cut off by the end of the caller's buffer
+	int			CopyDistance;
+	GzHuffman		Lengths;	// literal/length code of the current block
+	GzHuffman		Distances;
+	unsigned int		Crc;
+	long long		CompressedBytes;	// read from the file so far
+	long long		Bytes;			// handed to the caller so far, over all members
+	bool			Error;
+};
+
+void	CloseGzStream( GzStream * );
+bool	OpenGzStream( const char *, GzStream * );
+size_t	ReadGzStream( GzStream *, char *, size_t );
+
+#endif
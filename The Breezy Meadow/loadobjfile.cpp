@@ -1,290 +1,2025 @@
 #include "loadobjfile.h"
+#include "gzstream.h"
+#include "mappedfile.h"
+#include "meshcache.h"
+#include "parallel.h"
 
+#include <algorithm>
+#include <numeric>
+#include <thread>
 
-int LoadObjFile( char *name )
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define OBJSSE2
+#include <emmintrin.h>
+#endif
+
+extern int DebugOn;		// set in sample.cpp
+
+
+// longest single token (number or v/t/n triple) we expect on a line:
+
+#define MAXTOKEN		64
+
+
+// copy the next OBJDELIMS-separated token in [p,eol) into buf:
+// returns a pointer just past the token, or NULL if the line has no more tokens
+
+static const char *
+NextToken( const char *p, const char *eol, char *buf )
+{
+	while( p < eol  &&  ( *p == ' '  ||  *p == '\t'  ||  *p == '\r' ) )
+		p++;
+
+	if( p >= eol )
+		return NULL;
+
+	int n = 0;
+	while( p < eol  &&  *p != ' '  &&  *p != '\t'  &&  *p != '\r' )
+	{
+		if( n < MAXTOKEN-1 )
+			buf[n++] = *p;
+		p++;
+	}
+	buf[n] = '\0';
+
+	return p;
+}
+
+
+// exact powers of ten -- every one of these is representable in a double:
+
+static const double Pow10[ ] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+static inline bool
+IsObjDelim( char c )
+{
+	return c == ' '  ||  c == '\t'  ||  c == '\r';
+}
+
+
+// the rest of the line from p, without the whitespace around it:
+// (material names are not limited to MAXTOKEN)
+
+static std::string
+RestOfObjLine( const char *p, const char *eol )
+{
+	while( p < eol  &&  IsObjDelim( *p ) )
+		p++;
+	while( eol > p  &&  IsObjDelim( eol[-1] ) )
+		eol--;
+	return std::string( p, eol );
+}
+
+
+// read the next token as a float, leaving def if there is none:
+// this is a single pass over the characters with no locale lookups
+// numbers with at most 15 significant digits and a small exponent are converted exactly,
+// (a correctly-rounded double, just like atof), anything else falls back to atof
+
+static const char *
+NextFloat( const char *p, const char *eol, float *f, float def )
+{
+	*f = def;
+	if( p == NULL )
+		return NULL;
+
+	while( p < eol  &&  IsObjDelim( *p ) )
+		p++;
+
+	if( p >= eol )
+		return NULL;
+
+	const char *start = p;
+
+	bool neg = false;
+	if( *p == '-'  ||  *p == '+' )
+	{
+		neg = ( *p == '-' );
+		p++;
+	}
+
+	unsigned long long mant = 0;
+	int digits = 0;			// significant digits in mant
+	int exp10 = 0;
+	bool any = false;
+
+	for( ; p < eol  &&  *p >= '0'  &&  *p <= '9'; p++ )
+	{
+		any = true;
+		if( digits < 19 )
+		{
+			mant = 10*mant + ( *p - '0' );
+			if( mant != 0 )
+				digits++;
+		}
+		else
+		{
+			exp10++;
+		}
+	}
+
+	if( p < eol  &&  *p == '.' )
+	{
+		for( p++; p < eol  &&  *p >= '0'  &&  *p <= '9'; p++ )
+		{
+			any = true;
+			if( digits < 19 )
+			{
+				mant = 10*mant + ( *p - '0' );
+				if( mant != 0 )
+					digits++;
+				exp10--;
+			}
+		}
+	}
+
+	bool fast = any;
+	if( fast  &&  p < eol  &&  ( *p == 'e'  ||  *p == 'E' ) )
+	{
+		p++;
+		bool eneg = false;
+		if( p < eol  &&  ( *p == '-'  ||  *p == '+' ) )
+		{
+			eneg = ( *p == '-' );
+			p++;
+		}
+
+		int e = 0;
+		bool edigits = false;
+		for( ; p < eol  &&  *p >= '0'  &&  *p <= '9'; p++ )
+		{
+			edigits = true;
+			if( e < 10000 )
+				e = 10*e + ( *p - '0' );
+		}
+
+		if( ! edigits )
+			fast = false;
+		exp10 += eneg ? -e : e;
+	}
+
+	// the number must end at a delimiter, and must fit the exact double fast path:
+
+	if( fast  &&  ( p == eol  ||  IsObjDelim( *p ) )  &&
+	    mant <= ( 1ULL << 53 )  &&  exp10 >= -22  &&  exp10 <= 22 )
+	{
+		double d = (double)mant;
+		if( exp10 < 0 )
+			d /= Pow10[ -exp10 ];
+		else
+			d *= Pow10[ exp10 ];
+		*f = (float)( neg ? -d : d );
+		return p;
+	}
+
+	// something unusual (nan, inf, hex, lots of digits, ...) -- let the library sort it out:
+
+	char buf[MAXTOKEN];
+	p = NextToken( start, eol, buf );
+	*f = (float)atof( buf );
+	return p;
+}
+
+
+// read an optionally-signed integer, stopping at the first non-digit:
+
+static inline const char *
+ScanObjInt( const char *p, const char *eol, int *value )
+{
+	bool neg = false;
+	if( p < eol  &&  ( *p == '-'  ||  *p == '+' ) )
+	{
+		neg = ( *p == '-' );
+		p++;
+	}
+
+	int v = 0;
+	for( ; p < eol  &&  *p >= '0'  &&  *p <= '9'; p++ )
+		v = 10*v + ( *p - '0' );
+
+	*value = neg ? -v : v;
+	return p;
+}
+
+
+// read the next face corner, which can be one of v, v//n, v/t, v/t/n:
+// missing t or n come back as 0
+// returns a pointer just past the corner, or NULL if the line has no more corners
+
+static const char *
+NextObjVTN( const char *p, const char *eol, struct face *c )
+{
+	while( p < eol  &&  IsObjDelim( *p ) )
+		p++;
+
+	if( p >= eol )
+		return NULL;
+
+	c->t = c->n = 0;
+	p = ScanObjInt( p, eol, &c->v );
+
+	if( p < eol  &&  *p == '/' )
+	{
+		p++;
+		if( p < eol  &&  *p == '/' )			// v//n
+		{
+			p = ScanObjInt( p+1, eol, &c->n );
+		}
+		else
+		{
+			p = ScanObjInt( p, eol, &c->t );	// v/t
+			if( p < eol  &&  *p == '/' )		// v/t/n
+				p = ScanObjInt( p+1, eol, &c->n );
+		}
+	}
+
+	// skip anything we did not understand up to the end of the token:
+
+	while( p < eol  &&  ! IsObjDelim( *p ) )
+		p++;
+
+	return p;
+}
+
+
+// append one vertex to the mesh:
+// a corner with no normal of its own gets (0,0,0), to be filled in by SmoothObjNormals( )
+// returns the new vertex's index
+
+static unsigned int
+AddObjVertex( ObjMesh &mesh, const ObjPools &pools, const struct face *fp )
+{
+	const struct Vertex *vp = &pools.Vertices[ fp->v - 1 ];
+	mesh.Positions.push_back( vp->x );
+	mesh.Positions.push_back( vp->y );
+	mesh.Positions.push_back( vp->z );
+
+	if( fp->n != 0 )
+	{
+		const struct Normal *np = &pools.Normals[ fp->n - 1 ];
+		mesh.Normals.push_back( np->nx );
+		mesh.Normals.push_back( np->ny );
+		mesh.Normals.push_back( np->nz );
+	}
+	else
+	{
+		mesh.Normals.push_back( 0. );
+		mesh.Normals.push_back( 0. );
+		mesh.Normals.push_back( 0. );
+	}
+
+	if( fp->t != 0 )
+	{
+		const struct TextureCoord *tp = &pools.TextureCoords[ fp->t - 1 ];
+		mesh.TexCoords.push_back( tp->s );
+		mesh.TexCoords.push_back( tp->t );
+		mesh.HasTexCoords = true;
+	}
+	else
+	{
+		mesh.TexCoords.push_back( 0. );
+		mesh.TexCoords.push_back( 0. );
+	}
+
+	return (unsigned int)( mesh.Positions.size()/3 - 1 );
+}
+
+
+// everything one newline-aligned chunk of the file contributes, before face indices are resolved:
+// the counts in each ObjFaceRec are local to the chunk, so chunks can be parsed independently
+
+struct ObjFaceRec
+{
+	int	NumCorners;
+	int	SizeV, SizeN, SizeT;	// v, vn and vt records in this chunk before this face
+	int	Material;		// into the chunk's MaterialNames, or -1 if set before the chunk began
+};
+
+struct ObjChunk
+{
+	std::vector <struct Vertex>		Vertices;
+	std::vector <struct Normal>		Normals;
+	std::vector <struct TextureCoord>	TextureCoords;
+	std::vector <struct face>		Corners;	// v/t/n exactly as read, NumCorners per face
+	std::vector <ObjFaceRec>		Faces;
+	std::vector <std::string>		MaterialNames;	// every usemtl, in order
+	std::vector <std::string>		MaterialLibs;	// every file named by an mtllib
+	float					Min[3], Max[3];
+};
+
+
+// tokenize and convert the records in [p,end):
+// this is where nearly all of the parse time goes, and it touches nothing outside the chunk
+
+static void
+ParseObjChunk( const char *p, const char *end, ObjChunk &chunk )
+{
+	// a "v" line is rarely shorter than ~30 bytes, so this avoids most regrowth:
+
+	chunk.Vertices.reserve( ( end - p ) / 96 );
+	chunk.Normals.reserve( ( end - p ) / 96 );
+	chunk.TextureCoords.reserve( ( end - p ) / 96 );
+
+	struct Vertex sv;
+	struct Normal sn;
+	struct TextureCoord st;
+
+	float xmin = 1.e+37f;
+	float ymin = 1.e+37f;
+	float zmin = 1.e+37f;
+	float xmax = -xmin;
+	float ymax = -ymin;
+	float zmax = -zmin;
+
+	char cmd[MAXTOKEN];
+	int material = -1;
+
+	while( p < end )
+	{
+		// find the end of this line without copying it:
+
+		const char *eol = (const char *) memchr( p, '\n', end - p );
+		if( eol == NULL )
+			eol = end;
+
+		const char *line = p;
+		p = ( eol < end ) ? eol + 1 : end;
+
+		while( line < eol  &&  ( *line == ' '  ||  *line == '\t' ) )
+			line++;
+
+
+		// skip this line if it is empty or a comment:
+
+		if( line >= eol  ||  line[0] == '#' )
+			continue;
+
+
+		// groups, objects and smoothing groups don't change the mesh
+		// (normals come from the vn records, or else from SmoothObjNormals( )):
+
+		if( line[0] == 'g'  ||  line[0] == 'o'  ||  line[0] == 's' )
+			continue;
+
+
+		// get the command string:
+
+		const char *q = NextToken( line, eol, cmd );
+		if( q == NULL )
+			continue;
+
+
+		if( strcmp( cmd, "v" )  ==  0 )
+		{
+			q = NextFloat( q, eol, &sv.x, 0.f );
+			q = NextFloat( q, eol, &sv.y, 0.f );
+			q = NextFloat( q, eol, &sv.z, 0.f );
+
+			chunk.Vertices.push_back( sv );
+
+			if( sv.x < xmin )	xmin = sv.x;
+			if( sv.x > xmax )	xmax = sv.x;
+			if( sv.y < ymin )	ymin = sv.y;
+			if( sv.y > ymax )	ymax = sv.y;
+			if( sv.z < zmin )	zmin = sv.z;
+			if( sv.z > zmax )	zmax = sv.z;
+
+			continue;
+		}
+
+
+		if( strcmp( cmd, "vn" )  ==  0 )
+		{
+			q = NextFloat( q, eol, &sn.nx, 0.f );
+			q = NextFloat( q, eol, &sn.ny, 0.f );
+			q = NextFloat( q, eol, &sn.nz, 0.f );
+
+			chunk.Normals.push_back( sn );
+
+			continue;
+		}
+
+
+		if( strcmp( cmd, "vt" )  ==  0 )
+		{
+			q = NextFloat( q, eol, &st.s, 0.f );
+			q = NextFloat( q, eol, &st.t, 0.f );
+			q = NextFloat( q, eol, &st.p, 0.f );
+
+			chunk.TextureCoords.push_back( st );
+
+			continue;
+		}
+
+
+		if( strcmp( cmd, "f" )  ==  0 )
+		{
+			ObjFaceRec rec;
+			rec.NumCorners = 0;
+			rec.SizeV = (int)chunk.Vertices.size();
+			rec.SizeN = (int)chunk.Normals.size();
+			rec.SizeT = (int)chunk.TextureCoords.size();
+			rec.Material = material;
+
+			struct face c;
+			while( rec.NumCorners < 10  &&  ( q = NextObjVTN( q, eol, &c ) )  !=  NULL )
+			{
+				chunk.Corners.push_back( c );
+				rec.NumCorners++;
+			}
+
+			chunk.Faces.push_back( rec );
+			continue;
+		}
+
+
+		if( strcmp( cmd, "usemtl" )  ==  0 )
+		{
+			chunk.MaterialNames.push_back( RestOfObjLine( q, eol ) );
+			material = (int)chunk.MaterialNames.size() - 1;
+			continue;
+		}
+
+
+		if( strcmp( cmd, "mtllib" )  ==  0 )
+		{
+			// one or more file names:
+
+			while( q < eol )
+			{
+				while( q < eol  &&  IsObjDelim( *q ) )
+					q++;
+				const char *w = q;
+				while( q < eol  &&  ! IsObjDelim( *q ) )
+					q++;
+				if( q > w )
+					chunk.MaterialLibs.push_back( std::string( w, q ) );
+			}
+			continue;
+		}
+	}
+
+	chunk.Min[0] = xmin;	chunk.Max[0] = xmax;
+	chunk.Min[1] = ymin;	chunk.Max[1] = ymax;
+	chunk.Min[2] = zmin;	chunk.Max[2] = zmax;
+}
+
+
+// resolve one face's corners against the v/vn/vt records read so far and add its triangles to the mesh:
+// sizev, sizen and sizet are how many of each record came before the face in the file
+
+static void
+AddObjFace( const struct face *in, int numVertices, int sizev, int sizen, int sizet,
+		const ObjPools &pools, FaceMap &welded, ObjMesh &mesh )
+{
+	struct face vertices[10];
+
+	bool valid = true;
+	for( int k = 0; k < numVertices; k++ )
+	{
+		int v = in[k].v;
+		int n = in[k].n;
+		int t = in[k].t;
+
+		// if v, n, or t are negative, they are wrt the end of their respective list:
+
+		if( v < 0 )
+			v += ( sizev + 1 );
+
+		if( n < 0 )
+			n += ( sizen + 1 );
+
+		if( t < 0 )
+			t += ( sizet + 1 );
+
+
+		// be sure we are not out-of-bounds (<vector> will abort):
+
+		if( t > sizet  ||  t < 0 )
+		{
+			if( t != 0 )
+				fprintf( stderr, "Read texture coord %d, but only have %d so far\n", t, sizet );
+			t = 0;
+		}
+
+		if( n > sizen  ||  n < 0 )
+		{
+			if( n != 0 )
+				fprintf( stderr, "Read normal %d, but only have %d so far\n", n, sizen );
+			n = 0;
+		}
+
+		if( v > sizev  ||  v <= 0 )
+		{
+			fprintf( stderr, "Read vertex coord %d, but only have %d so far\n", v, sizev );
+			v = 0;
+			valid = false;
+		}
+
+		vertices[k].v = v;
+		vertices[k].n = n;
+		vertices[k].t = t;
+	}
+
+
+	// if vertices are invalid, don't draw anything this time:
+
+	if( ! valid )
+		return;
+
+	if( numVertices < 3 )
+		return;
+
+
+	// fan-triangulate the polygon:
+
+	int numTriangles = numVertices - 2;
+
+	for( int it = 0; it < numTriangles; it++ )
+	{
+		int vv[3];
+		vv[0] = 0;
+		vv[1] = it + 1;
+		vv[2] = it + 2;
+
+		// every face that uses the same v/t/n shares one vertex
+		// (corners without a vn get their normal afterwards, from SmoothObjNormals( )):
+
+		for( int vtx = 0; vtx < 3 ; vtx++ )
+		{
+			struct face *fp = &vertices[ vv[vtx] ];
+
+			std::pair<FaceMap::iterator,bool> ins = welded.insert( FaceMap::value_type( *fp, 0 ) );
+			if( ins.second )
+				ins.first->second = AddObjVertex( mesh, pools, fp );
+			mesh.Indices.push_back( ins.first->second );
+		}
+	}
+}
+
+
+// move a chunk's v/vn/vt records onto the end of the file-wide lists:
+
+static void
+AppendObjPools( ObjChunk &chunk, ObjPools &pools )
+{
+	pools.Vertices.insert( pools.Vertices.end(), chunk.Vertices.begin(), chunk.Vertices.end() );
+	pools.Normals.insert( pools.Normals.end(), chunk.Normals.begin(), chunk.Normals.end() );
+	pools.TextureCoords.insert( pools.TextureCoords.end(), chunk.TextureCoords.begin(), chunk.TextureCoords.end() );
+	std::vector<struct Vertex>().swap( chunk.Vertices );
+	std::vector<struct Normal>().swap( chunk.Normals );
+	std::vector<struct TextureCoord>().swap( chunk.TextureCoords );
+}
+
+
+static void
+ClearObjMesh( ObjMesh &mesh )
+{
+	mesh.Positions.clear();
+	mesh.Normals.clear();
+	mesh.TexCoords.clear();
+	mesh.Indices.clear();
+	mesh.HasTexCoords = false;
+	mesh.MaterialLibs.clear();
+	mesh.Materials.clear();
+	mesh.Ranges.clear();
+}
+
+
+// the OpenGL default material:
+
+void
+InitObjMaterial( ObjMaterial &m, const std::string &name )
+{
+	m.Name = name;
+	for( int k = 0; k < 3; k++ )
+	{
+		m.Ambient[k] = 0.2f;
+		m.Diffuse[k] = 0.8f;
+		m.Specular[k] = 0.f;
+	}
+	m.Shininess = 0.f;
+	m.Opacity = 1.f;
+	m.DiffuseMap.clear();
+}
+
+
+// stitch the parsed chunks into one indexed mesh:
+// this runs in file order, so the result is the same however the file was split
+// triMaterial gets each triangle's material, -1 for triangles before the first usemtl
+
+static void
+BuildObjMesh( std::vector<ObjChunk> &chunks, ObjMesh &mesh, std::vector<int> &triMaterial )
+{
+	ObjPools pools;
+
+	ClearObjMesh( mesh );
+
+	for( int i = 0; i < 3; i++ )
+	{
+		mesh.Min[i] =  1.e+37f;
+		mesh.Max[i] = -1.e+37f;
+	}
+
+
+	// prefix sums of the per-chunk element counts give each chunk's offset into the whole file:
+
+	std::vector<int> baseV( chunks.size() ), baseN( chunks.size() ), baseT( chunks.size() );
+	size_t numV = 0, numN = 0, numT = 0, numCorners = 0;
+	for( size_t c = 0; c < chunks.size(); c++ )
+	{
+		baseV[c] = (int)numV;
+		baseN[c] = (int)numN;
+		baseT[c] = (int)numT;
+		numV += chunks[c].Vertices.size();
+		numN += chunks[c].Normals.size();
+		numT += chunks[c].TextureCoords.size();
+		numCorners += chunks[c].Corners.size();
+
+		for( int i = 0; i < 3; i++ )
+		{
+			if( chunks[c].Min[i] < mesh.Min[i] )	mesh.Min[i] = chunks[c].Min[i];
+			if( chunks[c].Max[i] > mesh.Max[i] )	mesh.Max[i] = chunks[c].Max[i];
+		}
+	}
+
+	pools.Vertices.reserve( numV );
+	pools.Normals.reserve( numN );
+	pools.TextureCoords.reserve( numT );
+	for( size_t c = 0; c < chunks.size(); c++ )
+		AppendObjPools( chunks[c], pools );
+
+
+	// every unique v/t/n triple seen so far -> its index in the mesh:
+
+	FaceMap welded;
+	welded.reserve( numCorners / 2 );
+
+	mesh.Indices.reserve( 3*numCorners / 2 );
+
+
+	// usemtl names -> materials, numbered in the order they first appear:
+
+	std::unordered_map<std::string, int> materialIds;
+	int material = -1;
+	triMaterial.clear( );
+
+	for( size_t c = 0; c < chunks.size(); c++ )
+	{
+		for( size_t i = 0; i < chunks[c].MaterialLibs.size(); i++ )
+		{
+			const std::string &lib = chunks[c].MaterialLibs[i];
+			if( std::find( mesh.MaterialLibs.begin(), mesh.MaterialLibs.end(), lib ) == mesh.MaterialLibs.end() )
+				mesh.MaterialLibs.push_back( lib );
+		}
+
+		std::vector<int> ids( chunks[c].MaterialNames.size() );
+		for( size_t i = 0; i < ids.size(); i++ )
+		{
+			const std::string &name = chunks[c].MaterialNames[i];
+			std::unordered_map<std::string, int>::iterator it = materialIds.find( name );
+			if( it == materialIds.end() )
+			{
+				ObjMaterial m;
+				InitObjMaterial( m, name );
+				mesh.Materials.push_back( m );
+				it = materialIds.insert( std::make_pair( name, (int)mesh.Materials.size() - 1 ) ).first;
+			}
+			ids[i] = it->second;
+		}
+
+		const struct face *corner = chunks[c].Corners.empty() ? NULL : &chunks[c].Corners[0];
+
+		for( size_t f = 0; f < chunks[c].Faces.size(); f++ )
+		{
+			const ObjFaceRec &rec = chunks[c].Faces[f];
+			AddObjFace( corner, rec.NumCorners, baseV[c] + rec.SizeV, baseN[c] + rec.SizeN, baseT[c] + rec.SizeT,
+					pools, welded, mesh );
+			corner += rec.NumCorners;
+
+			int m = ( rec.Material < 0 ) ? material : ids[ rec.Material ];
+			triMaterial.resize( mesh.Indices.size() / 3, m );
+		}
+
+		// the last usemtl carries on into the next chunk:
+
+		if( ! ids.empty() )
+			material = ids.back();
+
+		std::vector<struct face>().swap( chunks[c].Corners );
+		std::vector<ObjFaceRec>().swap( chunks[c].Faces );
+	}
+}
+
+
+// sort the triangles into one range per material, keeping their order within each material:
+// materials with the same texture map go next to each other, so their ranges can be drawn as one
+
+static void
+GroupObjMaterials( ObjMesh &mesh, std::vector<int> &triMaterial )
+{
+	mesh.Ranges.clear( );
+	if( mesh.Materials.empty() )
+		return;
+
+	int nt = (int)( mesh.Indices.size() / 3 );
+
+	// triangles before the first usemtl get a nameless default material:
+
+	if( std::find( triMaterial.begin(), triMaterial.end(), -1 ) != triMaterial.end() )
+	{
+		ObjMaterial m;
+		InitObjMaterial( m, "" );
+		mesh.Materials.push_back( m );
+		std::replace( triMaterial.begin(), triMaterial.end(), -1, (int)mesh.Materials.size() - 1 );
+	}
+
+	int nm = (int)mesh.Materials.size();
+	std::vector<int> order( nm );
+	std::iota( order.begin(), order.end(), 0 );
+	std::stable_sort( order.begin(), order.end(), [&]( int a, int b )
+	{
+		return mesh.Materials[a].DiffuseMap < mesh.Materials[b].DiffuseMap;
+	} );
+
+	std::vector<int> slot( nm );
+	for( int i = 0; i < nm; i++ )
+		slot[ order[i] ] = i;
+
+
+	// counting sort on each triangle's material slot:
+
+	std::vector<unsigned int> first( nm + 1, 0 );
+	for( int t = 0; t < nt; t++ )
+		first[ slot[ triMaterial[t] ] + 1 ]++;
+	for( int i = 0; i < nm; i++ )
+		first[i+1] += first[i];
+
+	std::vector<unsigned int> sorted( 3*nt );
+	std::vector<unsigned int> next( first.begin(), first.end() - 1 );
+	for( int t = 0; t < nt; t++ )
+	{
+		unsigned int to = next[ slot[ triMaterial[t] ] ]++;
+		memcpy( &sorted[ 3*to ], &mesh.Indices[ 3*t ], 3*sizeof(unsigned int) );
+	}
+	mesh.Indices.swap( sorted );
+
+	for( int i = 0; i < nm; i++ )
+	{
+		if( first[i+1] == first[i] )
+			continue;
+
+		ObjRange r;
+		r.Material = order[i];
+		r.FirstIndex = 3 * first[i];
+		r.NumIndices = 3 * ( first[i+1] - first[i] );
+		mesh.Ranges.push_back( r );
+	}
+}
+
+
+// a sphere around the mesh's vertices, centered in their bounding box:
+// (not the smallest one, but never more than about 15% bigger)
+
+void
+ComputeObjSphere( ObjMesh &mesh )
+{
+	int nv = (int)( mesh.Positions.size() / 3 );
+	float lo[3] = { 0., 0., 0. }, hi[3] = { 0., 0., 0. };
+	for( int v = 0; v < nv; v++ )
+	{
+		const float *p = &mesh.Positions[ 3*v ];
+		for( int k = 0; k < 3; k++ )
+		{
+			if( v == 0  ||  p[k] < lo[k] )	lo[k] = p[k];
+			if( v == 0  ||  p[k] > hi[k] )	hi[k] = p[k];
+		}
+	}
+
+	float r2 = 0.;
+	for( int k = 0; k < 3; k++ )
+		mesh.Center[k] = ( lo[k] + hi[k] ) / 2.f;
+	for( int v = 0; v < nv; v++ )
+	{
+		const float *p = &mesh.Positions[ 3*v ];
+		float dx = p[0] - mesh.Center[0], dy = p[1] - mesh.Center[1], dz = p[2] - mesh.Center[2];
+		float d2 = dx*dx + dy*dy + dz*dz;
+		if( d2 > r2 )
+			r2 = d2;
+	}
+	mesh.Radius = sqrtf( r2 );
+}
+
+
+// posId[v] = the lowest-numbered vertex at exactly v's position:
+// vertices split by a texture or normal seam still share one position
+
+void
+GetObjPositionIds( const ObjMesh &mesh, std::vector<unsigned int> &posId )
+{
+	int nv = (int)( mesh.Positions.size() / 3 );
+	posId.resize( nv );
+	if( nv == 0 )
+		return;
+
+	const float *pos = &mesh.Positions[0];
+	std::vector<int> order( nv );
+	for( int v = 0; v < nv; v++ )
+		order[v] = v;
+
+	std::sort( order.begin(), order.end(), [pos]( int a, int b )
+	{
+		const float *pa = &pos[ 3*a ], *pb = &pos[ 3*b ];
+		if( pa[0] != pb[0] )	return pa[0] < pb[0];
+		if( pa[1] != pb[1] )	return pa[1] < pb[1];
+		if( pa[2] != pb[2] )	return pa[2] < pb[2];
+		return a < b;
+	} );
+
+	for( int i = 0; i < nv; )
+	{
+		int j = i + 1;
+		while( j < nv  &&  memcmp( &pos[ 3*order[j] ], &pos[ 3*order[i] ], 3*sizeof(float) ) == 0 )
+			j++;
+
+		for( int k = i; k < j; k++ )
+			posId[ order[k] ] = order[i];
+		i = j;
+	}
+}
+
+
+// acos( x ) to within 1e-4 radians (Abramowitz and Stegun 4.4.45) --
+// plenty for weighting normals, and the same in the scalar and sse kernels:
+
+#define OBJPI		3.14159265f
+
+static inline float
+AcosObj( float x )
+{
+	float a = fabsf( x );
+	float r = sqrtf( 1.f - a ) * ( 1.5707288f + a*( -0.2121144f + a*( 0.0742610f - 0.0187293f*a ) ) );
+	return ( x < 0.f ) ? OBJPI - r : r;
+}
+
+
+// unit normal and corner angles of one triangle:
+// a degenerate triangle gets a zero normal, so it adds nothing
+
+static void
+ObjTriangleWeights( const float *p0, const float *p1, const float *p2, float n[3], float angle[3] )
+{
+	float e01[3], e02[3], e12[3];
+	for( int k = 0; k < 3; k++ )
+	{
+		e01[k] = p1[k] - p0[k];
+		e02[k] = p2[k] - p0[k];
+		e12[k] = p2[k] - p1[k];
+	}
+
+	CrossObj( e01, e02, n );
+	UnitObj( n );
+
+	float l01 = sqrtf( e01[0]*e01[0] + e01[1]*e01[1] + e01[2]*e01[2] );
+	float l02 = sqrtf( e02[0]*e02[0] + e02[1]*e02[1] + e02[2]*e02[2] );
+	float l12 = sqrtf( e12[0]*e12[0] + e12[1]*e12[1] + e12[2]*e12[2] );
+	float i01 = ( l01 > 0.f ) ? 1.f / l01 : 0.f;
+	float i02 = ( l02 > 0.f ) ? 1.f / l02 : 0.f;
+	float i12 = ( l12 > 0.f ) ? 1.f / l12 : 0.f;
+
+	float c[3];
+	c[0] =  ( e01[0]*e02[0] + e01[1]*e02[1] + e01[2]*e02[2] ) * i01 * i02;
+	c[1] = -( e01[0]*e12[0] + e01[1]*e12[1] + e01[2]*e12[2] ) * i01 * i12;
+	c[2] =  ( e02[0]*e12[0] + e02[1]*e12[1] + e02[2]*e12[2] ) * i02 * i12;
+
+	for( int k = 0; k < 3; k++ )
+	{
+		float ck = c[k] < -1.f ? -1.f : ( c[k] > 1.f ? 1.f : c[k] );
+		angle[k] = AcosObj( ck );
+	}
+}
+
+
+#ifdef OBJSSE2
+
+static inline __m128
+Dot3( __m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz )
+{
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( ax, bx ), _mm_mul_ps( ay, by ) ), _mm_mul_ps( az, bz ) );
+}
+
+
+// 1/sqrt( d ), or 0 where d is 0:
+
+static inline __m128
+SafeInvSqrt( __m128 d )
+{
+	__m128 len = _mm_sqrt_ps( d );
+	__m128 nonzero = _mm_cmpgt_ps( len, _mm_setzero_ps( ) );
+	return _mm_and_ps( nonzero, _mm_div_ps( _mm_set1_ps( 1.f ), len ) );
+}
+
+
+static inline __m128
+AcosObj4( __m128 x )
+{
+	__m128 one = _mm_set1_ps( 1.f );
+	x = _mm_min_ps( _mm_max_ps( x, _mm_set1_ps( -1.f ) ), one );
+
+	__m128 sign = _mm_set1_ps( -0.f );
+	__m128 a = _mm_andnot_ps( sign, x );
+	__m128 poly = _mm_add_ps( _mm_set1_ps( 0.0742610f ), _mm_mul_ps( a, _mm_set1_ps( -0.0187293f ) ) );
+	poly = _mm_add_ps( _mm_set1_ps( -0.2121144f ), _mm_mul_ps( a, poly ) );
+	poly = _mm_add_ps( _mm_set1_ps( 1.5707288f ), _mm_mul_ps( a, poly ) );
+	__m128 r = _mm_mul_ps( _mm_sqrt_ps( _mm_sub_ps( one, a ) ), poly );
+
+	__m128 negative = _mm_cmplt_ps( x, _mm_setzero_ps( ) );
+	return _mm_or_ps( _mm_and_ps( negative, _mm_sub_ps( _mm_set1_ps( OBJPI ), r ) ), _mm_andnot_ps( negative, r ) );
+}
+
+
+// ObjTriangleWeights( ) for four triangles at once, in structure-of-arrays form:
+// p[c][k] is coordinate k of corner c of each of the four triangles
+
+static void
+ObjTriangleWeights4( const __m128 p[3][3], float n[3][4], float angle[3][4] )
+{
+	__m128 e01[3], e02[3], e12[3];
+	for( int k = 0; k < 3; k++ )
+	{
+		e01[k] = _mm_sub_ps( p[1][k], p[0][k] );
+		e02[k] = _mm_sub_ps( p[2][k], p[0][k] );
+		e12[k] = _mm_sub_ps( p[2][k], p[1][k] );
+	}
+
+	__m128 nx = _mm_sub_ps( _mm_mul_ps( e01[1], e02[2] ), _mm_mul_ps( e01[2], e02[1] ) );
+	__m128 ny = _mm_sub_ps( _mm_mul_ps( e01[2], e02[0] ), _mm_mul_ps( e01[0], e02[2] ) );
+	__m128 nz = _mm_sub_ps( _mm_mul_ps( e01[0], e02[1] ), _mm_mul_ps( e01[1], e02[0] ) );
+	__m128 inv = SafeInvSqrt( Dot3( nx, ny, nz, nx, ny, nz ) );
+	_mm_storeu_ps( n[0], _mm_mul_ps( nx, inv ) );
+	_mm_storeu_ps( n[1], _mm_mul_ps( ny, inv ) );
+	_mm_storeu_ps( n[2], _mm_mul_ps( nz, inv ) );
+
+	__m128 i01 = SafeInvSqrt( Dot3( e01[0], e01[1], e01[2], e01[0], e01[1], e01[2] ) );
+	__m128 i02 = SafeInvSqrt( Dot3( e02[0], e02[1], e02[2], e02[0], e02[1], e02[2] ) );
+	__m128 i12 = SafeInvSqrt( Dot3( e12[0], e12[1], e12[2], e12[0], e12[1], e12[2] ) );
+
+	__m128 c0 = _mm_mul_ps( Dot3( e01[0], e01[1], e01[2], e02[0], e02[1], e02[2] ), _mm_mul_ps( i01, i02 ) );
+	__m128 c1 = _mm_mul_ps( Dot3( e01[0], e01[1], e01[2], e12[0], e12[1], e12[2] ), _mm_mul_ps( i01, i12 ) );
+	__m128 c2 = _mm_mul_ps( Dot3( e02[0], e02[1], e02[2], e12[0], e12[1], e12[2] ), _mm_mul_ps( i02, i12 ) );
+	c1 = _mm_xor_ps( c1, _mm_set1_ps( -0.f ) );
+
+	_mm_storeu_ps( angle[0], AcosObj4( c0 ) );
+	_mm_storeu_ps( angle[1], AcosObj4( c1 ) );
+	_mm_storeu_ps( angle[2], AcosObj4( c2 ) );
+}
+
+#endif
+
+
+// give every vertex that has no normal (one whose corner had no vn) the angle-weighted
+// average of the normals of the triangles around its position:
+// does nothing at all when every vertex has a normal from the file
+
+void
+SmoothObjNormals( ObjMesh &mesh )
+{
+	int nv = (int)( mesh.Positions.size() / 3 );
+	int nt = (int)( mesh.Indices.size() / 3 );
+
+	bool missing = false;
+	for( int v = 0; v < nv  &&  ! missing; v++ )
+	{
+		const float *n = &mesh.Normals[ 3*v ];
+		missing = ( n[0] == 0.f  &&  n[1] == 0.f  &&  n[2] == 0.f );
+	}
+	if( ! missing )
+		return;
+
+	std::vector<unsigned int> posId;
+	GetObjPositionIds( mesh, posId );
+
+	std::vector<float> sums( 3*nv, 0.f );
+	const float *pos = &mesh.Positions[0];
+	const unsigned int *idx = mesh.Indices.empty() ? NULL : &mesh.Indices[0];
+
+	int t = 0;
+#ifdef OBJSSE2
+	for( ; t + 4 <= nt; t += 4 )
+	{
+		__m128 p[3][3];
+		for( int c = 0; c < 3; c++ )
+		{
+			const float *q0 = &pos[ 3*idx[ 3*(t+0) + c ] ];
+			const float *q1 = &pos[ 3*idx[ 3*(t+1) + c ] ];
+			const float *q2 = &pos[ 3*idx[ 3*(t+2) + c ] ];
+			const float *q3 = &pos[ 3*idx[ 3*(t+3) + c ] ];
+			for( int k = 0; k < 3; k++ )
+				p[c][k] = _mm_setr_ps( q0[k], q1[k], q2[k], q3[k] );
+		}
+
+		float n[3][4], angle[3][4];
+		ObjTriangleWeights4( p, n, angle );
+
+		for( int i = 0; i < 4; i++ )
+		{
+			for( int c = 0; c < 3; c++ )
+			{
+				float *sum = &sums[ 3*posId[ idx[ 3*(t+i) + c ] ] ];
+				sum[0] += angle[c][i] * n[0][i];
+				sum[1] += angle[c][i] * n[1][i];
+				sum[2] += angle[c][i] * n[2][i];
+			}
+		}
+	}
+#endif
+	for( ; t < nt; t++ )
+	{
+		const unsigned int *tri = &idx[ 3*t ];
+		float n[3], angle[3];
+		ObjTriangleWeights( &pos[ 3*tri[0] ], &pos[ 3*tri[1] ], &pos[ 3*tri[2] ], n, angle );
+
+		for( int c = 0; c < 3; c++ )
+		{
+			float *sum = &sums[ 3*posId[ tri[c] ] ];
+			sum[0] += angle[c] * n[0];
+			sum[1] += angle[c] * n[1];
+			sum[2] += angle[c] * n[2];
+		}
+	}
+
+	for( int v = 0; v < nv; v++ )
+	{
+		float *n = &mesh.Normals[ 3*v ];
+		if( n[0] != 0.f  ||  n[1] != 0.f  ||  n[2] != 0.f )
+			continue;
+
+		n[0] = sums[ 3*posId[v] + 0 ];
+		n[1] = sums[ 3*posId[v] + 1 ];
+		n[2] = sums[ 3*posId[v] + 2 ];
+		UnitObj( n );
+	}
+}
+
+
+// does the file name end in this extension?
+
+static bool
+HasObjExtension( const char *name, const char *ext )
+{
+	size_t n = strlen( name );
+	size_t e = strlen( ext );
+	return n >= e  &&  strcmp( name + n - e, ext ) == 0;
+}
+
+
+// inflate a .obj.gz file a piece at a time and parse each piece into its own chunk:
+// the next piece is inflated while the one before it is being parsed, and only those
+// two pieces of text are ever in memory, never the whole file
+
+static int
+ParseObjGzChunks( const char *name, std::vector<ObjChunk> &chunks )
+{
+	GzStream gz;
+	if( ! OpenGzStream( name, &gz ) )
+	{
+		fprintf( stderr, "Cannot open .obj.gz file '%s'\n", name );
+		return 1;
+	}
+
+	std::vector<char> text[2];
+	int cur = 0;
+	size_t carry = 0;
+	ObjChunk parsed;
+	std::thread parser;
+
+	for( ; ; )
+	{
+		text[cur].resize( carry + OBJGZCHUNK );
+		size_t n = ReadGzStream( &gz, &text[cur][carry], OBJGZCHUNK );
+		size_t len = carry + n;
+		bool eof = ( n < OBJGZCHUNK );
+
+		// only parse whole lines -- the last, unfinished, line goes to the front of the other buffer:
+
+		size_t parseLen = len;
+		if( ! eof )
+		{
+			while( parseLen > 0  &&  text[cur][parseLen-1] != '\n' )
+				parseLen--;
+		}
+
+		// the other buffer is still being parsed:
+
+		if( parser.joinable() )
+		{
+			parser.join( );
+			chunks.push_back( std::move( parsed ) );
+			parsed = ObjChunk( );
+		}
+
+		carry = len - parseLen;
+		text[1-cur].resize( carry + OBJGZCHUNK );
+		if( carry > 0 )
+			memcpy( &text[1-cur][0], &text[cur][parseLen], carry );
+
+		if( parseLen > 0 )
+		{
+			const char *p = &text[cur][0];
+			parser = std::thread( [p, parseLen, &parsed]( )
+			{
+				ParseObjChunk( p, p + parseLen, parsed );
+			} );
+		}
+
+		cur = 1 - cur;
+		if( eof )
+			break;
+	}
+
+	if( parser.joinable() )
+	{
+		parser.join( );
+		chunks.push_back( std::move( parsed ) );
+	}
+
+	bool bad = gz.Error;
+	CloseGzStream( &gz );
+	if( bad )
+	{
+		fprintf( stderr, "'%s' is not a valid gzip file, or is cut short\n", name );
+		return 1;
+	}
+
+	return 0;
+}
+
+
+// split a memory-mapped obj file at line boundaries and parse the pieces, in parallel if numThreads > 1:
+
+static int
+ParseObjMappedChunks( const char *name, int numThreads, std::vector<ObjChunk> &chunks )
+{
+	MappedFile file;
+	if( ! MapFile( name, &file ) )
+	{
+		fprintf( stderr, "Cannot open .obj file '%s'\n", name );
+		return 1;
+	}
+
+	if( numThreads <= 0 )
+		numThreads = ( file.Size >= OBJPARALLELBYTES ) ? NumWorkerThreads( ) : 1;
+
+
+	// a few chunks per thread keeps every thread busy even when some chunks hold only faces:
+
+	int numChunks = 1;
+	if( numThreads > 1 )
+	{
+		numChunks = 4 * numThreads;
+		size_t minChunk = OBJPARALLELBYTES / 4;
+		if( file.Size / numChunks < minChunk )
+			numChunks = (int)( file.Size / minChunk ) + 1;
+	}
+
+	std::vector<const char *> starts( numChunks + 1 );
+	const char *end = file.Data + file.Size;
+	starts[0] = file.Data;
+	for( int c = 1; c < numChunks; c++ )
+	{
+		// move each split point forward to just after the next newline:
+
+		const char *s = file.Data + ( file.Size / numChunks ) * c;
+		if( s < starts[c-1] )
+			s = starts[c-1];
+		const char *nl = (const char *) memchr( s, '\n', end - s );
+		starts[c] = ( nl != NULL ) ? nl + 1 : end;
+	}
+	starts[numChunks] = end;
+
+	chunks.resize( numChunks );
+	if( numChunks == 1 )
+	{
+		ParseObjChunk( starts[0], starts[1], chunks[0] );
+	}
+	else
+	{
+		ParallelFor( numChunks, [&]( int c )
+		{
+			ParseObjChunk( starts[c], starts[c+1], chunks[c] );
+		}, numThreads );
+	}
+
+	UnmapFile( &file );
+	return 0;
+}
+
+
+// parse an obj file into a cpu-side mesh:
+// the file is memory-mapped and scanned in place, one line at a time
+// a file ending in .gz is inflated as it is parsed instead, on two threads, whatever numThreads says
+// face corners with the same v/t/n share one vertex, so the mesh is indexed
+// the triangles are grouped by material, and the materials filled in from the mtllib files
+//
+// numThreads > 1 splits the file at line boundaries and parses the pieces in parallel,
+// numThreads == 1 parses serially, and numThreads <= 0 picks based on the size of the file
+// the mesh is the same either way
+// returns 0 on success, 1 if the file cannot be read
+
+int
+ParseObjFile( const char *name, ObjMesh &mesh, int numThreads )
+{
+	if( HasObjExtension( name, ".zst" ) )
+	{
+		fprintf( stderr, "Cannot read '%s': zstd-compressed obj files are not supported, use gzip\n", name );
+		return 1;
+	}
+
+	std::vector<ObjChunk> chunks;
+	int status;
+	if( HasObjExtension( name, ".gz" ) )
+		status = ParseObjGzChunks( name, chunks );
+	else
+		status = ParseObjMappedChunks( name, numThreads, chunks );
+	if( status != 0 )
+		return 1;
+
+	std::vector<int> triMaterial;
+	BuildObjMesh( chunks, mesh, triMaterial );
+	ResolveObjMaterials( name, mesh );
+	GroupObjMaterials( mesh, triMaterial );
+	SmoothObjNormals( mesh );
+	ComputeObjSphere( mesh );
+	return 0;
+}
+
+
+ObjStream::ObjStream( )
+{
+	Fp = NULL;
+	Name = NULL;
+	Carry = 0;
+	Done = true;
+	BytesRead = 0;
+	NumTriangles = 0;
+	ClearObjMesh( Staging );
+}
+
+
+// start streaming an obj file:
+// returns false if the file cannot be opened
+
+bool
+ObjStream::Open( const char *name )
+{
+	Close( );
+
+	Fp = fopen( name, "rb" );
+	if( Fp == NULL )
+	{
+		fprintf( stderr, "Cannot open .obj file '%s'\n", name );
+		return false;
+	}
+
+	Name = strdup( name );
+	Done = false;
+	OpenTime = std::chrono::steady_clock::now( );
+	for( int i = 0; i < 3; i++ )
+	{
+		Min[i] =  1.e+37f;
+		Max[i] = -1.e+37f;
+	}
+
+	return true;
+}
+
+
+// stop streaming and release everything, including the gpu buffers:
+
+void
+ObjStream::Close( )
+{
+	if( Fp != NULL )
+		fclose( Fp );
+	Fp = NULL;
+
+	free( Name );
+	Name = NULL;
+
+	for( size_t b = 0; b < Batches.size(); b++ )
+	{
+		glDeleteBuffers( 1, &Batches[b].VertexBuffer );
+		glDeleteBuffers( 1, &Batches[b].IndexBuffer );
+	}
+
+	std::vector<ObjStreamBatch>().swap( Batches );
+	std::vector<char>().swap( Text );
+	ObjPools().Vertices.swap( Pools.Vertices );
+	ObjPools().Normals.swap( Pools.Normals );
+	ObjPools().TextureCoords.swap( Pools.TextureCoords );
+	FaceMap().swap( Welded );
+	ClearObjMesh( Staging );
+
+	Carry = 0;
+	Done = true;
+	BytesRead = 0;
+	NumTriangles = 0;
+}
+
+
+bool
+ObjStream::IsOpen( )
+{
+	return Name != NULL;
+}
+
+
+bool
+ObjStream::IsDone( )
+{
+	return Done;
+}
+
+
+// bounds of the v records read so far:
+
+void
+ObjStream::GetBounds( float lo[3], float hi[3] )
 {
-	char *cmd;		// the command string
-	char *str;		// argument string
+	for( int i = 0; i < 3; i++ )
+	{
+		lo[i] = Min[i];
+		hi[i] = Max[i];
+	}
+}
+
+
+// upload the staging batch to the gpu and empty it:
+
+void
+ObjStream::FlushBatch( )
+{
+	if( Staging.Indices.size() == 0 )
+		return;
+
+	SmoothObjNormals( Staging );
+
+	int nv = (int)Staging.Positions.size() / 3;
+	std::vector<float> interleaved( 8*nv );
+	for( int i = 0; i < nv; i++ )
+	{
+		float *vp = &interleaved[ 8*i ];
+		vp[0] = Staging.Positions[ 3*i+0 ];
+		vp[1] = Staging.Positions[ 3*i+1 ];
+		vp[2] = Staging.Positions[ 3*i+2 ];
+		vp[3] = Staging.Normals[ 3*i+0 ];
+		vp[4] = Staging.Normals[ 3*i+1 ];
+		vp[5] = Staging.Normals[ 3*i+2 ];
+		vp[6] = Staging.TexCoords[ 2*i+0 ];
+		vp[7] = Staging.TexCoords[ 2*i+1 ];
+	}
+
+	std::vector<unsigned short> indices16;
+	GetObjIndices16( Staging, indices16 );
+
+	ObjStreamBatch batch;
+	batch.NumIndices = (int)indices16.size();
+
+	glGenBuffers( 1, &batch.VertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, batch.VertexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, interleaved.size()*sizeof(float), &interleaved[0], GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	glGenBuffers( 1, &batch.IndexBuffer );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, batch.IndexBuffer );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices16.size()*sizeof(unsigned short), &indices16[0], GL_STATIC_DRAW );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+	if( Batches.size() == 0 )
+	{
+		double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - OpenTime ).count( );
+		fprintf( stderr, "Streaming '%s': first geometry after %.1f ms\n", Name, ms );
+	}
+
+	Batches.push_back( batch );
+	NumTriangles += batch.NumIndices / 3;
+
+	ClearObjMesh( Staging );
+	Welded.clear( );
+}
+
+
+// read and parse the next OBJSTREAMCHUNK bytes, uploading every batch that fills up:
+// returns false once the whole file has been read
+
+bool
+ObjStream::Step( )
+{
+	if( Fp == NULL  ||  Done )
+		return false;
+
+	Text.resize( Carry + OBJSTREAMCHUNK );
+	size_t n = fread( &Text[Carry], 1, OBJSTREAMCHUNK, Fp );
+	BytesRead += n;
+
+	size_t len = Carry + n;
+	bool eof = ( n < OBJSTREAMCHUNK );
+
+
+	// only parse whole lines -- the last, unfinished, line waits for the next chunk:
+
+	size_t parseLen = len;
+	if( ! eof )
+	{
+		while( parseLen > 0  &&  Text[parseLen-1] != '\n' )
+			parseLen--;
+	}
 
-	std::vector <struct Vertex> Vertices(10000);
-	std::vector <struct Normal> Normals(10000);
-	std::vector <struct TextureCoord> TextureCoords(10000);
+	ObjChunk chunk;
+	ParseObjChunk( &Text[0], &Text[0] + parseLen, chunk );
+
+	for( int i = 0; i < 3; i++ )
+	{
+		if( chunk.Min[i] < Min[i] )	Min[i] = chunk.Min[i];
+		if( chunk.Max[i] > Max[i] )	Max[i] = chunk.Max[i];
+	}
 
-	Vertices.clear();
-	Normals.clear();
-	TextureCoords.clear();
+	int baseV = (int)Pools.Vertices.size();
+	int baseN = (int)Pools.Normals.size();
+	int baseT = (int)Pools.TextureCoords.size();
+	AppendObjPools( chunk, Pools );
 
-	struct Vertex sv;
-	struct Normal sn;
-	struct TextureCoord st;
+	const struct face *corner = chunk.Corners.empty() ? NULL : &chunk.Corners[0];
+	for( size_t f = 0; f < chunk.Faces.size(); f++ )
+	{
+		const ObjFaceRec &rec = chunk.Faces[f];
+		AddObjFace( corner, rec.NumCorners, baseV + rec.SizeV, baseN + rec.SizeN, baseT + rec.SizeT,
+				Pools, Welded, Staging );
+		corner += rec.NumCorners;
 
+		// a face has at most 10 corners, so adds at most 10 vertices: stop while there is still room for one more
 
-	// open the input file:
+		if( Staging.Positions.size()/3 > OBJSTREAMBATCH - 10 )
+			FlushBatch( );
+	}
 
-	FILE *fp = fopen( name, "r" );
-	if( fp == NULL )
+	// hand over what this chunk made, so it can be seen on the next frame:
+
+	FlushBatch( );
+
+	Carry = len - parseLen;
+	if( Carry > 0 )
+		memmove( &Text[0], &Text[parseLen], Carry );
+
+	if( eof )
 	{
-		fprintf( stderr, "Cannot open .obj file '%s'\n", name );
-		return 1;
+		double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - OpenTime ).count( );
+		fprintf( stderr, "Streamed '%s': %.1f MB, %lld triangles in %d batches, %.1f ms\n",
+			Name, (double)BytesRead / ( 1024.*1024. ), NumTriangles, (int)Batches.size(), ms );
+
+		// nothing can refer to the records any more, so only the gpu copy is left:
+
+		fclose( Fp );
+		Fp = NULL;
+		Done = true;
+		std::vector<char>().swap( Text );
+		ObjPools().Vertices.swap( Pools.Vertices );
+		ObjPools().Normals.swap( Pools.Normals );
+		ObjPools().TextureCoords.swap( Pools.TextureCoords );
+		FaceMap().swap( Welded );
+		Carry = 0;
 	}
 
+	return ! Done;
+}
 
-	float xmin = 1.e+37f;
-	float ymin = 1.e+37f;
-	float zmin = 1.e+37f;
-	float xmax = -xmin;
-	float ymax = -ymin;
-	float zmax = -zmin;
 
-	glBegin( GL_TRIANGLES );
+#define BUFFER_OFFSET(n)	( (const GLvoid *)(size_t)(n) )
 
-	for( ; ; )
+// draw every batch uploaded so far:
+
+void
+ObjStream::Draw( )
+{
+	if( Batches.size() == 0 )
+		return;
+
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_NORMAL_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+
+	for( size_t b = 0; b < Batches.size(); b++ )
 	{
-		char *line = ReadRestOfLine( fp );
-		if( line == NULL )
-			break;
+		glBindBuffer( GL_ARRAY_BUFFER, Batches[b].VertexBuffer );
+		glVertexPointer( 3, GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 0 ) );
+		glNormalPointer( GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 3*sizeof(float) ) );
+		glTexCoordPointer( 2, GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 6*sizeof(float) ) );
 
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, Batches[b].IndexBuffer );
+		glDrawElements( GL_TRIANGLES, Batches[b].NumIndices, GL_UNSIGNED_SHORT, BUFFER_OFFSET( 0 ) );
+	}
 
-		// skip this line if it is a comment:
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	glPopClientAttrib( );
+}
 
-		if( line[0] == '#' )
-			continue;
 
+// microbenchmark: time the number conversion for every v, vn, vt and f record in a file,
+// once with the old strtok-style token copy + atof/sscanf and once with the scanners above
+// prints MB/s (of the whole file) for each, and how many values disagree
 
-		// skip this line if it is something we don't feel like handling today:
+void
+BenchmarkObjNumbers( const char *name )
+{
+	MappedFile file;
+	if( ! MapFile( name, &file )  ||  file.Size == 0 )
+	{
+		fprintf( stderr, "Cannot open .obj file '%s'\n", name );
+		return;
+	}
 
-		if( line[0] == 'g' )
-			continue;
+	const char *end = file.Data + file.Size;
+	double sums[2] = { 0., 0. };
+	double seconds[2];
+	std::vector<float> values[2];
 
-		if( line[0] == 'm' )
-			continue;
+	for( int pass = 0; pass < 2; pass++ )
+	{
+		values[pass].reserve( file.Size / 8 );
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
 
-		if( line[0] == 's' )
-			continue;
+		char cmd[MAXTOKEN];
+		char str[MAXTOKEN];
+		for( const char *p = file.Data; p < end; )
+		{
+			const char *eol = (const char *) memchr( p, '\n', end - p );
+			if( eol == NULL )
+				eol = end;
+			const char *q = NextToken( p, eol, cmd );
+			p = ( eol < end ) ? eol + 1 : end;
+			if( q == NULL )
+				continue;
 
-		if( line[0] == 'u' )
-			continue;
+			if( strcmp( cmd, "v" ) == 0  ||  strcmp( cmd, "vn" ) == 0  ||  strcmp( cmd, "vt" ) == 0 )
+			{
+				float f;
+				for( int i = 0; i < 3; i++ )
+				{
+					if( pass == 0 )
+					{
+						q = NextToken( q, eol, str );
+						if( q == NULL )
+							break;
+						f = (float)atof( str );
+					}
+					else
+					{
+						q = NextFloat( q, eol, &f, 0.f );
+						if( q == NULL )
+							break;
+					}
+					values[pass].push_back( f );
+				}
+			}
+			else if( strcmp( cmd, "f" ) == 0 )
+			{
+				struct face c;
+				for( ; ; )
+				{
+					if( pass == 0 )
+					{
+						q = NextToken( q, eol, str );
+						if( q == NULL )
+							break;
+						ReadObjVTN( str, &c.v, &c.t, &c.n );
+					}
+					else
+					{
+						q = NextObjVTN( q, eol, &c );
+						if( q == NULL )
+							break;
+					}
+					values[pass].push_back( (float)( c.v + c.t + c.n ) );
+				}
+			}
+		}
 
+		seconds[pass] = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - t0 ).count( );
+		for( size_t i = 0; i < values[pass].size(); i++ )
+			sums[pass] += values[pass][i];
+	}
 
-		// get the command string:
+	int mismatches = 0;
+	if( values[0].size() != values[1].size() )
+		mismatches = -1;
+	else
+	{
+		for( size_t i = 0; i < values[0].size(); i++ )
+			if( values[0][i] != values[1][i] )
+				mismatches++;
+	}
 
-		cmd = strtok( line, OBJDELIMS );
+	double mb = (double)file.Size / ( 1024. * 1024. );
+	fprintf( stderr, "%-28s %6.2f MB  atof/sscanf: %7.1f MB/s  scanner: %7.1f MB/s  (%.1fx)  mismatches: %d\n",
+		name, mb, mb / seconds[0], mb / seconds[1], seconds[0] / seconds[1], mismatches );
 
+	UnmapFile( &file );
+}
 
-		// skip this line if it is empty:
 
-		if( cmd == NULL )
-			continue;
+// benchmark: parse an obj file, then the gzip-compressed copy of it next to it (<name>.gz),
+// and time just the inflate on its own
+// prints MB/s of obj text for each, and whether both gave the same mesh
 
+void
+BenchmarkObjGz( const char *name )
+{
+	std::string gzname = std::string( name ) + ".gz";
+	FILE *fp = fopen( gzname.c_str(), "rb" );
+	if( fp == NULL )
+	{
+		fprintf( stderr, "%-28s no '%s' to compare against (make one with gzip -k)\n", name, gzname.c_str() );
+		return;
+	}
+	fseek( fp, 0, SEEK_END );
+	double gzmb = (double)ftell( fp ) / ( 1024. * 1024. );
+	fclose( fp );
 
-		if( strcmp( cmd, "v" )  ==  0 )
-		{
-			str = strtok( NULL, OBJDELIMS );
-			sv.x = atof(str);
+	double seconds[4];
+	ObjMesh meshes[3];
+	for( int pass = 0; pass < 3; pass++ )
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+		int status;
+		if( pass == 0 )
+			status = ParseObjFile( name, meshes[pass], 1 );
+		else if( pass == 1 )
+			status = ParseObjFile( name, meshes[pass] );
+		else
+			status = ParseObjFile( gzname.c_str(), meshes[pass] );
+		seconds[pass] = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - t0 ).count( );
+		if( status != 0 )
+			return;
+	}
 
-			str = strtok( NULL, OBJDELIMS );
-			sv.y = atof(str);
+	GzStream gz;
+	if( ! OpenGzStream( gzname.c_str(), &gz ) )
+		return;
+	std::vector<char> text( OBJGZCHUNK );
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+	while( ReadGzStream( &gz, &text[0], OBJGZCHUNK ) == OBJGZCHUNK )
+		;
+	seconds[3] = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - t0 ).count( );
+	double mb = (double)gz.Bytes / ( 1024. * 1024. );
+	CloseGzStream( &gz );
+
+	bool same = meshes[2].Positions == meshes[0].Positions  &&  meshes[2].Indices == meshes[0].Indices;
+	fprintf( stderr, "%-28s %6.2f MB (%.1fx as .gz)  mapped: %7.1f MB/s (1 thread) %7.1f MB/s  .gz: %7.1f MB/s  inflate alone: %7.1f MB/s  same mesh: %s\n",
+		name, mb, mb / gzmb, mb / seconds[0], mb / seconds[1], mb / seconds[2], mb / seconds[3], same ? "yes" : "NO" );
+}
 
-			str = strtok( NULL, OBJDELIMS );
-			sv.z = atof(str);
 
-			Vertices.push_back( sv );
+// number of bytes needed per index: 2 if every vertex can be reached with a 16-bit index, else 4
 
-			if( sv.x < xmin )	xmin = sv.x;
-			if( sv.x > xmax )	xmax = sv.x;
-			if( sv.y < ymin )	ymin = sv.y;
-			if( sv.y > ymax )	ymax = sv.y;
-			if( sv.z < zmin )	zmin = sv.z;
-			if( sv.z > zmax )	zmax = sv.z;
+int
+ObjIndexSize( const ObjMesh &mesh )
+{
+	return ( mesh.Positions.size()/3 <= 65536 ) ? 2 : 4;
+}
 
-			continue;
-		}
 
+// narrow the mesh's indices to 16 bits:
+// (only meaningful when ObjIndexSize( ) returns 2)
 
-		if( strcmp( cmd, "vn" )  ==  0 )
-		{
-			str = strtok( NULL, OBJDELIMS );
-			sn.nx = atof( str );
+void
+GetObjIndices16( const ObjMesh &mesh, std::vector<unsigned short> &indices16 )
+{
+	indices16.resize( mesh.Indices.size() );
+	for( size_t i = 0; i < mesh.Indices.size(); i++ )
+		indices16[i] = (unsigned short)mesh.Indices[i];
+}
 
-			str = strtok( NULL, OBJDELIMS );
-			sn.ny = atof( str );
 
-			str = strtok( NULL, OBJDELIMS );
-			sn.nz = atof( str );
+// point the vertex arrays at the mesh:
 
-			Normals.push_back( sn );
+static void
+SetObjArrays( const ObjMesh &mesh )
+{
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, &mesh.Positions[0] );
 
-			continue;
-		}
+	glEnableClientState( GL_NORMAL_ARRAY );
+	glNormalPointer( GL_FLOAT, 0, &mesh.Normals[0] );
+
+	if( mesh.HasTexCoords )
+	{
+		glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+		glTexCoordPointer( 2, GL_FLOAT, 0, &mesh.TexCoords[0] );
+	}
+}
 
 
-		if( strcmp( cmd, "vt" )  ==  0 )
-		{
-			st.s = st.t = st.p = 0.;
+// draw a parsed mesh with vertex arrays:
+// (this is fine to call inside glNewList -- the arrays are copied into the list)
+
+void
+DrawObjMesh( const ObjMesh &mesh )
+{
+	if( mesh.Indices.size() == 0 )
+		return;
+
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+	SetObjArrays( mesh );
+
+	if( ObjIndexSize( mesh ) == 2 )
+	{
+		std::vector<unsigned short> indices16;
+		GetObjIndices16( mesh, indices16 );
+		glDrawElements( GL_TRIANGLES, (GLsizei)indices16.size(), GL_UNSIGNED_SHORT, &indices16[0] );
+	}
+	else
+	{
+		glDrawElements( GL_TRIANGLES, (GLsizei)mesh.Indices.size(), GL_UNSIGNED_INT, &mesh.Indices[0] );
+	}
 
-			str = strtok( NULL, OBJDELIMS );
-			st.s = atof( str );
+	glPopClientAttrib( );
+}
 
-			str = strtok( NULL, OBJDELIMS );
-			if( str != NULL )
-				st.t = atof( str );
 
-			str = strtok( NULL, OBJDELIMS );
-			if( str != NULL )
-				st.p = atof( str );
+// do two materials need exactly the same gl state?
 
-			TextureCoords.push_back( st );
+static bool
+SameObjMaterialState( const ObjMaterial &a, const ObjMaterial &b )
+{
+	return memcmp( a.Ambient,  b.Ambient,  sizeof(a.Ambient) )  == 0  &&
+	       memcmp( a.Diffuse,  b.Diffuse,  sizeof(a.Diffuse) )  == 0  &&
+	       memcmp( a.Specular, b.Specular, sizeof(a.Specular) ) == 0  &&
+	       a.Shininess == b.Shininess  &&  a.Opacity == b.Opacity  &&  a.DiffuseMap == b.DiffuseMap;
+}
 
-			continue;
-		}
 
+// gather the mesh's ranges into one batch per distinct material state:
+// ranges that follow each other in the index list are merged into one count
+// a mesh without materials is a single batch with Material = -1
 
-		if( strcmp( cmd, "f" )  ==  0 )
+void
+GetObjDrawBatches( const ObjMesh &mesh, vector<ObjDrawBatch> &batches )
+{
+	batches.clear( );
+	if( mesh.Indices.size() == 0 )
+		return;
+
+	if( mesh.Ranges.empty() )
+	{
+		ObjDrawBatch b;
+		b.Material = -1;
+		b.Counts.push_back( (GLsizei)mesh.Indices.size() );
+		b.FirstIndices.push_back( 0 );
+		batches.push_back( b );
+		return;
+	}
+
+	for( size_t r = 0; r < mesh.Ranges.size(); r++ )
+	{
+		const ObjRange &range = mesh.Ranges[r];
+		const ObjMaterial &m = mesh.Materials[ range.Material ];
+
+		size_t b = 0;
+		while( b < batches.size()  &&  ! SameObjMaterialState( mesh.Materials[ batches[b].Material ], m ) )
+			b++;
+
+		if( b == batches.size() )
 		{
-			struct face vertices[10];
-			for( int i = 0; i < 10; i++ )
-			{
-				vertices[i].v = 0;
-				vertices[i].n = 0;
-				vertices[i].t = 0;
-			}
+			batches.push_back( ObjDrawBatch() );
+			batches[b].Material = range.Material;
+		}
 
-			int sizev = (int)Vertices.size();
-			int sizen = (int)Normals.size();
-			int sizet = (int)TextureCoords.size();
+		ObjDrawBatch &batch = batches[b];
+		if( ! batch.Counts.empty()  &&  batch.FirstIndices.back() + batch.Counts.back() == range.FirstIndex )
+		{
+			batch.Counts.back() += range.NumIndices;
+		}
+		else
+		{
+			batch.Counts.push_back( range.NumIndices );
+			batch.FirstIndices.push_back( range.FirstIndex );
+		}
+	}
+}
 
-			int numVertices = 0;
-			bool valid = true;
-			int vtx = 0;
-			char *str;
-			while( ( str = strtok( NULL, OBJDELIMS ) )  !=  NULL )
-			{
-				int v, n, t;
-				ReadObjVTN( str, &v, &t, &n );
 
-				// if v, n, or t are negative, they are wrt the end of their respective list:
+// draw a mesh one material state at a time:
+// setMaterial( ) is called once before each batch (not at all for a mesh without materials)
 
-				if( v < 0 )
-					v += ( sizev + 1 );
+void
+DrawObjMaterials( const ObjMesh &mesh, ObjMaterialFunc setMaterial, void *data )
+{
+	std::vector<ObjDrawBatch> batches;
+	GetObjDrawBatches( mesh, batches );
+	if( batches.empty() )
+		return;
 
-				if( n < 0 )
-					n += ( sizen + 1 );
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+	SetObjArrays( mesh );
 
-				if( t < 0 )
-					t += ( sizet + 1 );
+	std::vector<unsigned short> indices16;
+	const char *base;
+	GLenum type;
+	int size = ObjIndexSize( mesh );
+	if( size == 2 )
+	{
+		GetObjIndices16( mesh, indices16 );
+		base = (const char *)&indices16[0];
+		type = GL_UNSIGNED_SHORT;
+	}
+	else
+	{
+		base = (const char *)&mesh.Indices[0];
+		type = GL_UNSIGNED_INT;
+	}
 
+	std::vector<const GLvoid *> starts;
+	for( size_t b = 0; b < batches.size(); b++ )
+	{
+		const ObjDrawBatch &batch = batches[b];
+		if( setMaterial != NULL  &&  batch.Material >= 0 )
+			( *setMaterial )( mesh.Materials[ batch.Material ], data );
 
-				// be sure we are not out-of-bounds (<vector> will abort):
+		starts.resize( batch.FirstIndices.size() );
+		for( size_t i = 0; i < starts.size(); i++ )
+			starts[i] = base + (size_t)batch.FirstIndices[i] * size;
 
-				if( t > sizet )
-				{
-					if( t != 0 )
-						fprintf( stderr, "Read texture coord %d, but only have %d so far\n", t, sizet );
-					t = 0;
-				}
+		glMultiDrawElements( GL_TRIANGLES, &batch.Counts[0], type, &starts[0], (GLsizei)starts.size() );
+	}
 
-				if( n > sizen )
-				{
-					if( n != 0 )
-						fprintf( stderr, "Read normal %d, but only have %d so far\n", n, sizen );
-					n = 0;
-				}
+	glPopClientAttrib( );
+}
 
-				if( v > sizev )
-				{
-					if( v != 0 )
-						fprintf( stderr, "Read vertex coord %d, but only have %d so far\n", v, sizev );
-					v = 0;
-					valid = false;
-				}
 
-				vertices[vtx].v = v;
-				vertices[vtx].n = n;
-				vertices[vtx].t = t;
-				vtx++;
+// print the size and bounds of a loaded mesh:
 
-				if( vtx >= 10 )
-					break;
+void
+PrintObjMeshInfo( const char *name, const ObjMesh &mesh )
+{
+	fprintf( stderr, "Obj file '%s': %d vertices, %d triangles, %d-bit indices\n", name,
+		(int)mesh.Positions.size()/3, (int)mesh.Indices.size()/3, 8*ObjIndexSize( mesh ) );
+	fprintf( stderr, "Obj file range: [%8.3f,%8.3f,%8.3f] -> [%8.3f,%8.3f,%8.3f]\n",
+		mesh.Min[0], mesh.Min[1], mesh.Min[2],  mesh.Max[0], mesh.Max[1], mesh.Max[2] );
+	fprintf( stderr, "Obj file center = (%8.3f,%8.3f,%8.3f)\n",
+		(mesh.Min[0]+mesh.Max[0])/2., (mesh.Min[1]+mesh.Max[1])/2., (mesh.Min[2]+mesh.Max[2])/2. );
+	fprintf( stderr, "Obj file  span = (%8.3f,%8.3f,%8.3f)\n",
+		mesh.Max[0]-mesh.Min[0], mesh.Max[1]-mesh.Min[1], mesh.Max[2]-mesh.Min[2] );
 
-				numVertices++;
-			}
+	if( ! mesh.Materials.empty() )
+	{
+		std::vector<ObjDrawBatch> batches;
+		GetObjDrawBatches( mesh, batches );
+		fprintf( stderr, "Obj file materials: %d, in %d index ranges, drawn in %d batches\n",
+			(int)mesh.Materials.size(), (int)mesh.Ranges.size(), (int)batches.size() );
+	}
+}
 
 
-			// if vertices are invalid, don't draw anything this time:
+// read the materials in an .mtl file onto the end of materials:
+// returns 0 on success, 1 if the file cannot be opened
+// (plenty of obj files name an mtllib that was never shipped with them, so that is only said under DebugOn)
 
-			if( ! valid )
-				continue;
+int
+ReadObjMtlFile( const char *name, vector<ObjMaterial> &materials )
+{
+	FILE *fp = fopen( name, "r" );
+	if( fp == NULL )
+	{
+		if( DebugOn != 0 )
+			fprintf( stderr, "Cannot open .mtl file '%s'\n", name );
+		return 1;
+	}
 
-			if( numVertices < 3 )
-				continue;
+	ObjMaterial *m = NULL;
+	char line[1024];
+	while( fgets( line, sizeof(line), fp ) != NULL )
+	{
+		const char *eol = line + strlen( line );
+		while( eol > line  &&  ( eol[-1] == '\n'  ||  IsObjDelim( eol[-1] ) ) )
+			eol--;
 
+		char cmd[MAXTOKEN];
+		const char *q = NextToken( line, eol, cmd );
+		if( q == NULL  ||  cmd[0] == '#' )
+			continue;
 
-			// list the vertices:
+		if( strcmp( cmd, "newmtl" ) == 0 )
+		{
+			materials.push_back( ObjMaterial() );
+			m = &materials.back();
+			InitObjMaterial( *m, RestOfObjLine( q, eol ) );
+			continue;
+		}
 
-			int numTriangles = numVertices - 2;
+		if( m == NULL )
+			continue;
 
-			for( int it = 0; it < numTriangles; it++ )
-			{
-				int vv[3];
-				vv[0] = 0;
-				vv[1] = it + 1;
-				vv[2] = it + 2;
-
-				// get the planar normal, in case vertex normals are not defined:
-
-				struct Vertex *v0 = &Vertices[ vertices[ vv[0] ].v - 1 ];
-				struct Vertex *v1 = &Vertices[ vertices[ vv[1] ].v - 1 ];
-				struct Vertex *v2 = &Vertices[ vertices[ vv[2] ].v - 1 ];
-
-				float v01[3], v02[3], norm[3];
-				v01[0] = v1->x - v0->x;
-				v01[1] = v1->y - v0->y;
-				v01[2] = v1->z - v0->z;
-				v02[0] = v2->x - v0->x;
-				v02[1] = v2->y - v0->y;
-				v02[2] = v2->z - v0->z;
-				CrossObj( v01, v02, norm );
-				UnitObj( norm, norm );
-				glNormal3fv( norm );
-
-				for( int vtx = 0; vtx < 3 ; vtx++ )
-				{
-					if( vertices[ vv[vtx] ].t != 0 )
-					{
-						struct TextureCoord *tp = &TextureCoords[ vertices[ vv[vtx] ].t - 1 ];
-						glTexCoord2f( tp->s, tp->t );
-					}
+		float *color = NULL;
+		if( strcmp( cmd, "Ka" ) == 0 )	color = m->Ambient;
+		if( strcmp( cmd, "Kd" ) == 0 )	color = m->Diffuse;
+		if( strcmp( cmd, "Ks" ) == 0 )	color = m->Specular;
+		if( color != NULL )
+		{
+			// "Kd r" means r r r:
 
-					if( vertices[ vv[vtx] ].n != 0 )
-					{
-						struct Normal *np = &Normals[ vertices[ vv[vtx] ].n - 1 ];
-						glNormal3f( np->nx, np->ny, np->nz );
-					}
+			q = NextFloat( q, eol, &color[0], color[0] );
+			q = NextFloat( q, eol, &color[1], color[0] );
+			q = NextFloat( q, eol, &color[2], color[1] );
+			continue;
+		}
 
-					struct Vertex *vp = &Vertices[ vertices[ vv[vtx] ].v - 1 ];
-					glVertex3f( vp->x, vp->y, vp->z );
-				}
-			}
+		if( strcmp( cmd, "Ns" ) == 0 )
+		{
+			NextFloat( q, eol, &m->Shininess, m->Shininess );
 			continue;
 		}
 
+		if( strcmp( cmd, "d" ) == 0 )
+		{
+			NextFloat( q, eol, &m->Opacity, m->Opacity );
+			continue;
+		}
 
-		if( strcmp( cmd, "s" )  ==  0 )
+		if( strcmp( cmd, "Tr" ) == 0 )
 		{
+			float tr;
+			NextFloat( q, eol, &tr, 1.f - m->Opacity );
+			m->Opacity = 1.f - tr;
 			continue;
 		}
 
+		if( strcmp( cmd, "map_Kd" ) == 0 )
+		{
+			// the file name is last, after any -option arguments:
+
+			const char *w = eol;
+			while( w > q  &&  ! IsObjDelim( w[-1] ) )
+				w--;
+			m->DiffuseMap = std::string( w, eol );
+			continue;
+		}
 	}
 
-	glEnd();
 	fclose( fp );
+	return 0;
+}
 
-	fprintf( stderr, "Obj file range: [%8.3f,%8.3f,%8.3f] -> [%8.3f,%8.3f,%8.3f]\n",
-		xmin, ymin, zmin,  xmax, ymax, zmax );
-	fprintf( stderr, "Obj file center = (%8.3f,%8.3f,%8.3f)\n",
-		(xmin+xmax)/2., (ymin+ymax)/2., (zmin+zmax)/2. );
-	fprintf( stderr, "Obj file  span = (%8.3f,%8.3f,%8.3f)\n",
-		xmax-xmin, ymax-ymin, zmax-zmin );
+
+// fill in the mesh's materials from its mtllib files, which are relative to the obj file:
+// a material that none of them describe keeps the default
+
+void
+ResolveObjMaterials( const char *objname, ObjMesh &mesh )
+{
+	if( mesh.Materials.empty() )
+		return;
+
+	std::string dir( objname );
+	size_t slash = dir.find_last_of( "/\\" );
+	dir = ( slash == std::string::npos ) ? std::string( "" ) : dir.substr( 0, slash + 1 );
+
+	std::vector<ObjMaterial> library;
+	for( size_t i = 0; i < mesh.MaterialLibs.size(); i++ )
+		ReadObjMtlFile( ( dir + mesh.MaterialLibs[i] ).c_str(), library );
+
+	for( size_t i = 0; i < mesh.Materials.size(); i++ )
+	{
+		for( size_t j = 0; j < library.size(); j++ )
+		{
+			if( library[j].Name == mesh.Materials[i].Name )
+			{
+				mesh.Materials[i] = library[j];
+				break;
+			}
+		}
+	}
+}
+
+
+// load an obj file (or its mesh cache) and draw it into the current display list:
+
+int
+LoadObjFile( char *name )
+{
+	ObjMesh mesh;
+	if( LoadObjMesh( name, mesh ) != 0 )
+		return 1;
+
+	DrawObjMesh( mesh );
+
+	PrintObjMeshInfo( name, mesh );
 
 	return 0;
 }
@@ -352,43 +2087,6 @@ UnitObj( float vin[3], float vout[3] )
 }
 
 
-char *
-ReadRestOfLine( FILE *fp )
-{
-	static char *line;
-	std::vector<char> tmp(1000);
-	tmp.clear();
-
-	for( ; ; )
-	{
-		int c = getc( fp );
-
-		if( c == EOF  &&  tmp.size() == 0 )
-		{
-			return NULL;
-		}
-
-		if( c == EOF  ||  c == '\n' )
-		{
-			delete [] line;
-			line = new char [ tmp.size()+1 ];
-			for( int i = 0; i < (int)tmp.size(); i++ )
-			{
-				line[i] = tmp[i];
-			}
-			line[ tmp.size() ] = '\0';	// terminating null
-			return line;
-		}
-		else
-		{
-			tmp.push_back( c );
-		}
-	}
-
-	return "";
-}
-
-
 void
 ReadObjVTN( char *str, int *v, int *t, int *n )
 {
@@ -20,6 +20,9 @@
 #include "glut.h"
 
 #include <vector>
+#include <string>
+#include <chrono>
+#include <unordered_map>
 
 #include "Vertex.h"
 
@@ -30,6 +33,14 @@ using std::vector;
 
 #define OBJDELIMS		" \t"
 
+// files at least this big are parsed on several threads:
+
+#define OBJPARALLELBYTES	( 1 << 20 )
+
+// a .obj.gz file is inflated and parsed this many bytes of text at a time:
+
+#define OBJGZCHUNK		( 1 << 20 )
+
 
 struct Normal
 {
@@ -48,9 +59,162 @@ struct face
 	int v, n, t;
 };
 
+
+// hash for welding identical v/t/n face corners into one mesh vertex:
+
+struct FaceHash
+{
+	size_t operator()( const struct face &f ) const
+	{
+		return (size_t)f.v * 73856093u  ^  (size_t)f.t * 19349663u  ^  (size_t)f.n * 83492791u;
+	}
+};
+
+struct FaceEqual
+{
+	bool operator()( const struct face &a, const struct face &b ) const
+	{
+		return a.v == b.v  &&  a.t == b.t  &&  a.n == b.n;
+	}
+};
+
+typedef std::unordered_map<struct face, unsigned int, FaceHash, FaceEqual>	FaceMap;
+
+
+// the v, vn and vt records read from a file so far -- face corners index into these:
+
+struct ObjPools
+{
+	vector<struct Vertex>		Vertices;
+	vector<struct Normal>		Normals;
+	vector<struct TextureCoord>	TextureCoords;
+};
+
+
+// a material named by usemtl, with whatever its mtllib file says about it
+// (materials that no .mtl file describes keep the OpenGL default material):
+
+struct ObjMaterial
+{
+	std::string	Name;
+	float		Ambient[3];	// Ka
+	float		Diffuse[3];	// Kd
+	float		Specular[3];	// Ks
+	float		Shininess;	// Ns
+	float		Opacity;	// d, or 1 - Tr
+	std::string	DiffuseMap;	// map_Kd, as written in the .mtl file
+};
+
+
+// the triangles that use one material are Indices[ FirstIndex .. FirstIndex+NumIndices-1 ]:
+
+struct ObjRange
+{
+	int		Material;	// into the mesh's Materials
+	unsigned int	FirstIndex;
+	unsigned int	NumIndices;
+};
+
+
+// a cpu-side indexed triangle mesh, ready to be drawn with vertex arrays or uploaded to buffers:
+// vertex i is Positions[3*i..3*i+2], Normals[3*i..3*i+2] and TexCoords[2*i..2*i+1]
+// if the file used any materials, the triangles are grouped into one range per material,
+// with materials that share a texture next to each other
+
+struct ObjMesh
+{
+	vector<float>		Positions;
+	vector<float>		Normals;
+	vector<float>		TexCoords;
+	vector<unsigned int>	Indices;	// 3 per triangle
+	bool			HasTexCoords;	// false if no face corner referenced a vt
+	float			Min[3];		// bounds of all the v records in the file
+	float			Max[3];
+	float			Center[3];	// a sphere around all of the mesh's vertices
+	float			Radius;
+	vector<std::string>	MaterialLibs;	// the mtllib files, as written in the obj file
+	vector<ObjMaterial>	Materials;	// in the order usemtl first named them
+	vector<ObjRange>	Ranges;		// in index order; empty if the file used no materials
+};
+
+
+// ranges whose materials need exactly the same gl state, drawn with one glMultiDrawElements( ):
+
+struct ObjDrawBatch
+{
+	int			Material;	// the first range's material
+	vector<GLsizei>		Counts;
+	vector<unsigned int>	FirstIndices;
+};
+
+// called once per batch by DrawObjMaterials( ) to set up that batch's material:
+
+typedef void	(*ObjMaterialFunc)( const ObjMaterial &, void * );
+
+// streams a (possibly huge) obj file onto the gpu a chunk at a time:
+// call Step( ) from the GL thread, say once a frame, and Draw( ) whatever has arrived so far
+// finished triangle batches live only in gpu buffers -- the cpu keeps just the v/vn/vt records,
+// since a face may refer back to any of them
+
+#define OBJSTREAMCHUNK		( 4 << 20 )	// bytes of text parsed per Step( )
+#define OBJSTREAMBATCH		65536		// most vertices in one batch, so 16-bit indices always work
+
+struct ObjStreamBatch
+{
+	GLuint	VertexBuffer;			// interleaved position, normal, texcoord
+	GLuint	IndexBuffer;			// 16-bit indices
+	int	NumIndices;
+};
+
+class ObjStream
+{
+private:
+	FILE *			Fp;
+	char *			Name;
+	vector<char>		Text;		// the chunk of text being parsed
+	size_t			Carry;		// bytes at the front of Text that start an unfinished line
+	ObjPools		Pools;
+	ObjMesh			Staging;	// the batch being filled
+	FaceMap			Welded;		// v/t/n -> vertex in Staging
+	vector<ObjStreamBatch>	Batches;
+	bool			Done;
+	long long		BytesRead;
+	long long		NumTriangles;
+	float			Min[3], Max[3];
+	std::chrono::steady_clock::time_point	OpenTime;
+
+	void	FlushBatch( );
+
+public:
+	ObjStream( );
+
+	bool	Open( const char * );
+	void	Close( );
+	void	Draw( );
+	void	GetBounds( float [3], float [3] );
+	bool	IsDone( );
+	bool	IsOpen( );
+	bool	Step( );
+};
+
+
+void	BenchmarkObjGz( const char * );
+void	BenchmarkObjNumbers( const char * );
+void	ComputeObjSphere( ObjMesh & );
 void	CrossObj( float [3], float [3], float [3] );
-char *	ReadRestOfLine( FILE * );
+void	DrawObjMaterials( const ObjMesh &, ObjMaterialFunc, void * );
+void	DrawObjMesh( const ObjMesh & );
+void	GetObjDrawBatches( const ObjMesh &, vector<ObjDrawBatch> & );
+void	GetObjIndices16( const ObjMesh &, vector<unsigned short> & );
+void	GetObjPositionIds( const ObjMesh &, vector<unsigned int> & );
+void	InitObjMaterial( ObjMaterial &, const std::string & );
+int	ObjIndexSize( const ObjMesh & );
+int	ParseObjFile( const char *, ObjMesh &, int = 0 );
+void	PrintObjMeshInfo( const char *, const ObjMesh & );
+int	ReadObjMtlFile( const char *, vector<ObjMaterial> & );
 void	ReadObjVTN( char *, int *, int *, int * );
+void	ResolveObjMaterials( const char *, ObjMesh & );
+void	SmoothObjNormals( ObjMesh & );
 float	UnitObj( float [3] );
 float	UnitObj( float [3], float [3] );
 int     LoadObjFile( char *name );
@@ -0,0 +1,487 @@
+#include "meshbvh.h"
+
+#include <algorithm>
+
+
+// how many rays the benchmark shoots, and how many of them also go through the brute-force test:
+
+#define BENCHMARKRAYS		200000
+#define BENCHMARKBRUTE		500
+
+
+struct BvhBox
+{
+	float	Min[3], Max[3];
+};
+
+
+static void
+EmptyBox( BvhBox &b )
+{
+	for( int k = 0; k < 3; k++ )
+	{
+		b.Min[k] =  1.e+37f;
+		b.Max[k] = -1.e+37f;
+	}
+}
+
+
+static void
+GrowBox( BvhBox &b, const BvhBox &c )
+{
+	for( int k = 0; k < 3; k++ )
+	{
+		if( c.Min[k] < b.Min[k] )	b.Min[k] = c.Min[k];
+		if( c.Max[k] > b.Max[k] )	b.Max[k] = c.Max[k];
+	}
+}
+
+
+static float
+HalfArea( const BvhBox &b )
+{
+	float dx = b.Max[0] - b.Min[0];
+	float dy = b.Max[1] - b.Min[1];
+	float dz = b.Max[2] - b.Min[2];
+	if( dx < 0.  ||  dy < 0.  ||  dz < 0. )
+		return 0.;
+	return dx*dy + dy*dz + dz*dx;
+}
+
+
+// everything the build needs to know about each triangle:
+
+struct BvhBuild
+{
+	std::vector<BvhBox>		Boxes;
+	std::vector<float>		Centroids;	// 3 per triangle
+	std::vector<unsigned int>	Order;		// triangle numbers, partitioned in place
+	ObjBvh *			Bvh;
+};
+
+
+// make Nodes[node] cover Order[begin..end-1], splitting it if there are too many triangles for one leaf:
+
+static void
+BuildBvhNode( BvhBuild &b, int node, int begin, int end, int depth )
+{
+	BvhBox bounds, centroids;
+	EmptyBox( bounds );
+	EmptyBox( centroids );
+	for( int i = begin; i < end; i++ )
+	{
+		unsigned int t = b.Order[i];
+		GrowBox( bounds, b.Boxes[t] );
+
+		BvhBox c;
+		for( int k = 0; k < 3; k++ )
+			c.Min[k] = c.Max[k] = b.Centroids[ 3*t+k ];
+		GrowBox( centroids, c );
+	}
+
+	ObjBvhNode *n = &b.Bvh->Nodes[node];
+	memcpy( n->Min, bounds.Min, sizeof(n->Min) );
+	memcpy( n->Max, bounds.Max, sizeof(n->Max) );
+
+	int count = end - begin;
+	if( count <= OBJBVHLEAFSIZE  ||  depth >= OBJBVHDEPTH - 2 )
+	{
+		n->Offset = begin;
+		n->Count = count;
+		return;
+	}
+
+
+	// bin the centroids along each axis and sweep for the cheapest split:
+
+	int bestAxis = -1, bestSplit = 0;
+	float bestCost = 1.e+37f;
+	for( int axis = 0; axis < 3; axis++ )
+	{
+		float lo = centroids.Min[axis];
+		float extent = centroids.Max[axis] - lo;
+		if( extent <= 0. )
+			continue;
+
+		int binCount[ OBJBVHBINS ] = { 0 };
+		BvhBox binBox[ OBJBVHBINS ];
+		for( int i = 0; i < OBJBVHBINS; i++ )
+			EmptyBox( binBox[i] );
+
+		float scale = OBJBVHBINS / extent;
+		for( int i = begin; i < end; i++ )
+		{
+			unsigned int t = b.Order[i];
+			int bin = (int)( ( b.Centroids[ 3*t+axis ] - lo ) * scale );
+			if( bin >= OBJBVHBINS )
+				bin = OBJBVHBINS - 1;
+			binCount[bin]++;
+			GrowBox( binBox[bin], b.Boxes[t] );
+		}
+
+		// areas and counts of everything right of each split, then sweep from the left:
+
+		float rightArea[ OBJBVHBINS ];
+		int rightCount[ OBJBVHBINS ];
+		BvhBox acc;
+		EmptyBox( acc );
+		int sum = 0;
+		for( int i = OBJBVHBINS - 1; i > 0; i-- )
+		{
+			GrowBox( acc, binBox[i] );
+			sum += binCount[i];
+			rightArea[i] = HalfArea( acc );
+			rightCount[i] = sum;
+		}
+
+		EmptyBox( acc );
+		sum = 0;
+		for( int i = 1; i < OBJBVHBINS; i++ )
+		{
+			GrowBox( acc, binBox[i-1] );
+			sum += binCount[i-1];
+			if( sum == 0  ||  rightCount[i] == 0 )
+				continue;
+
+			float cost = HalfArea( acc ) * sum + rightArea[i] * rightCount[i];
+			if( cost < bestCost )
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	int mid;
+	if( bestAxis >= 0 )
+	{
+		float lo = centroids.Min[bestAxis];
+		float scale = OBJBVHBINS / ( centroids.Max[bestAxis] - lo );
+		const std::vector<float> &cen = b.Centroids;
+		mid = (int)( std::partition( b.Order.begin() + begin, b.Order.begin() + end, [&]( unsigned int t )
+		{
+			int bin = (int)( ( cen[ 3*t+bestAxis ] - lo ) * scale );
+			return ( bin < OBJBVHBINS ? bin : OBJBVHBINS - 1 ) < bestSplit;
+		} ) - b.Order.begin() );
+	}
+	else
+	{
+		// every centroid is in the same place, so any split is as good as any other:
+
+		mid = ( begin + end ) / 2;
+	}
+
+	int first = (int)b.Bvh->Nodes.size();
+	b.Bvh->Nodes.resize( first + 1 );
+	BuildBvhNode( b, first, begin, mid, depth + 1 );
+
+	int second = (int)b.Bvh->Nodes.size();
+	b.Bvh->Nodes.resize( second + 1 );
+	BuildBvhNode( b, second, mid, end, depth + 1 );
+
+	n = &b.Bvh->Nodes[node];		// the resizes may have moved it
+	n->Offset = second;
+	n->Count = 0;
+}
+
+
+void
+BuildObjBvh( const ObjMesh &mesh, ObjBvh &bvh )
+{
+	bvh.Nodes.clear( );
+	bvh.Triangles.clear( );
+	bvh.Corners.clear( );
+
+	int nt = (int)( mesh.Indices.size() / 3 );
+	if( nt == 0 )
+		return;
+
+	BvhBuild b;
+	b.Bvh = &bvh;
+	b.Boxes.resize( nt );
+	b.Centroids.resize( 3*nt );
+	b.Order.resize( nt );
+	for( int t = 0; t < nt; t++ )
+	{
+		EmptyBox( b.Boxes[t] );
+		for( int c = 0; c < 3; c++ )
+		{
+			const float *p = &mesh.Positions[ 3*mesh.Indices[ 3*t+c ] ];
+			BvhBox pb;
+			memcpy( pb.Min, p, sizeof(pb.Min) );
+			memcpy( pb.Max, p, sizeof(pb.Max) );
+			GrowBox( b.Boxes[t], pb );
+		}
+		for( int k = 0; k < 3; k++ )
+			b.Centroids[ 3*t+k ] = ( b.Boxes[t].Min[k] + b.Boxes[t].Max[k] ) / 2.f;
+		b.Order[t] = t;
+	}
+
+	bvh.Nodes.reserve( 2*nt / OBJBVHLEAFSIZE + 1 );
+	bvh.Nodes.resize( 1 );
+	BuildBvhNode( b, 0, 0, nt, 0 );
+
+
+	// the leaves' triangles, copied out in the order the leaves refer to them:
+
+	bvh.Triangles.swap( b.Order );
+	bvh.Corners.resize( 9*nt );
+	for( int i = 0; i < nt; i++ )
+	{
+		for( int c = 0; c < 3; c++ )
+			memcpy( &bvh.Corners[ 9*i + 3*c ], &mesh.Positions[ 3*mesh.Indices[ 3*bvh.Triangles[i] + c ] ], 3*sizeof(float) );
+	}
+}
+
+
+// Moller-Trumbore, from both sides:
+
+static inline bool
+IntersectTriangle( const float *p, const float org[3], const float dir[3], float tMax, float *t, float *u, float *v )
+{
+	float e1[3] = { p[3] - p[0], p[4] - p[1], p[5] - p[2] };
+	float e2[3] = { p[6] - p[0], p[7] - p[1], p[8] - p[2] };
+
+	float pv[3] = { dir[1]*e2[2] - dir[2]*e2[1], dir[2]*e2[0] - dir[0]*e2[2], dir[0]*e2[1] - dir[1]*e2[0] };
+	float det = e1[0]*pv[0] + e1[1]*pv[1] + e1[2]*pv[2];
+	if( det == 0. )
+		return false;
+
+	float inv = 1.f / det;
+	float tv[3] = { org[0] - p[0], org[1] - p[1], org[2] - p[2] };
+	float uu = ( tv[0]*pv[0] + tv[1]*pv[1] + tv[2]*pv[2] ) * inv;
+	if( uu < 0.  ||  uu > 1. )
+		return false;
+
+	float qv[3] = { tv[1]*e1[2] - tv[2]*e1[1], tv[2]*e1[0] - tv[0]*e1[2], tv[0]*e1[1] - tv[1]*e1[0] };
+	float vv = ( dir[0]*qv[0] + dir[1]*qv[1] + dir[2]*qv[2] ) * inv;
+	if( vv < 0.  ||  uu + vv > 1. )
+		return false;
+
+	float tt = ( e2[0]*qv[0] + e2[1]*qv[1] + e2[2]*qv[2] ) * inv;
+	if( tt < 0.  ||  tt >= tMax )
+		return false;
+
+	*t = tt;
+	*u = uu;
+	*v = vv;
+	return true;
+}
+
+
+// where the ray enters the box, or -1. if it misses it before tMax:
+
+static inline float
+IntersectBox( const ObjBvhNode &n, const float org[3], const float inv[3], float tMax )
+{
+	float t0 = 0., t1 = tMax;
+	for( int k = 0; k < 3; k++ )
+	{
+		float a = ( n.Min[k] - org[k] ) * inv[k];
+		float b = ( n.Max[k] - org[k] ) * inv[k];
+		if( a > b )
+			std::swap( a, b );
+		t0 = ( a > t0 ) ? a : t0;		// (NaNs, from a ray lying in a face, lose both comparisons)
+		t1 = ( b < t1 ) ? b : t1;
+	}
+	return ( t0 <= t1 ) ? t0 : -1.f;
+}
+
+
+// nearest hit along the ray, if any:
+
+bool
+IntersectObjBvh( const ObjBvh &bvh, const float org[3], const float dir[3], float tMax, ObjRayHit *hit )
+{
+	if( bvh.Nodes.empty() )
+		return false;
+
+	float inv[3];
+	for( int k = 0; k < 3; k++ )
+		inv[k] = ( dir[k] != 0. ) ? 1.f / dir[k] : 1.e+37f;
+
+	const ObjBvhNode *nodes = &bvh.Nodes[0];
+	if( IntersectBox( nodes[0], org, inv, tMax ) < 0. )
+		return false;
+
+	int stack[ OBJBVHDEPTH ];
+	float entry[ OBJBVHDEPTH ];
+	stack[0] = 0;
+	entry[0] = 0.;
+	int top = 1;
+
+	bool found = false;
+	while( top > 0 )
+	{
+		top--;
+		if( entry[top] >= tMax )
+			continue;		// something nearer has been hit since this was pushed
+
+		const ObjBvhNode &n = nodes[ stack[top] ];
+		if( n.Count > 0 )
+		{
+			for( unsigned int i = n.Offset; i < n.Offset + n.Count; i++ )
+			{
+				float t, u, v;
+				if( IntersectTriangle( &bvh.Corners[ 9*i ], org, dir, tMax, &t, &u, &v ) )
+				{
+					tMax = t;
+					hit->T = t;
+					hit->Triangle = bvh.Triangles[i];
+					hit->U = u;
+					hit->V = v;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		int a = stack[top] + 1;
+		int b = n.Offset;
+		float ta = IntersectBox( nodes[a], org, inv, tMax );
+		float tb = IntersectBox( nodes[b], org, inv, tMax );
+
+		// push the farther child first, so the nearer one is visited next:
+
+		if( ta >= 0.  &&  tb >= 0.  &&  tb < ta )
+		{
+			std::swap( a, b );
+			std::swap( ta, tb );
+		}
+		if( tb >= 0. )
+		{
+			stack[top] = b;
+			entry[top] = tb;
+			top++;
+		}
+		if( ta >= 0. )
+		{
+			stack[top] = a;
+			entry[top] = ta;
+			top++;
+		}
+	}
+
+	return found;
+}
+
+
+// nearest hit along the ray, testing every triangle:
+
+bool
+IntersectObjMesh( const ObjMesh &mesh, const float org[3], const float dir[3], float tMax, ObjRayHit *hit )
+{
+	bool found = false;
+	int nt = (int)( mesh.Indices.size() / 3 );
+	for( int tri = 0; tri < nt; tri++ )
+	{
+		float p[9];
+		for( int c = 0; c < 3; c++ )
+			memcpy( &p[3*c], &mesh.Positions[ 3*mesh.Indices[ 3*tri+c ] ], 3*sizeof(float) );
+
+		float t, u, v;
+		if( IntersectTriangle( p, org, dir, tMax, &t, &u, &v ) )
+		{
+			tMax = t;
+			hit->T = t;
+			hit->Triangle = tri;
+			hit->U = u;
+			hit->V = v;
+			found = true;
+		}
+	}
+	return found;
+}
+
+
+// does the ray come within the mesh's bounding sphere before tMax?
+
+bool
+IntersectObjSphere( const ObjMesh &mesh, const float org[3], const float dir[3], float tMax )
+{
+	float oc[3] = { org[0] - mesh.Center[0], org[1] - mesh.Center[1], org[2] - mesh.Center[2] };
+	float a = dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2];
+	float b = oc[0]*dir[0] + oc[1]*dir[1] + oc[2]*dir[2];
+	float c = oc[0]*oc[0] + oc[1]*oc[1] + oc[2]*oc[2] - mesh.Radius*mesh.Radius;
+	if( c <= 0. )
+		return true;			// starts inside
+	if( a == 0.  ||  b >= 0. )
+		return false;			// standing still, or heading away
+
+	float disc = b*b - a*c;
+	if( disc < 0. )
+		return false;
+	return ( -b - sqrtf( disc ) ) / a < tMax;
+}
+
+
+// time building the hierarchy and shooting random rays through the mesh's bounding sphere,
+// with and without it (results go to stderr):
+
+void
+BenchmarkObjBvh( const char *name, const ObjMesh &mesh )
+{
+	if( mesh.Indices.size() == 0 )
+		return;
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+	ObjBvh bvh;
+	BuildObjBvh( mesh, bvh );
+	double buildMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+
+
+	// rays from a sphere twice the size of the bounds, aimed at points inside the bounds:
+
+	std::vector<float> rays( 6*BENCHMARKRAYS );
+	unsigned int seed = 12345;
+	for( int r = 0; r < BENCHMARKRAYS; r++ )
+	{
+		float dir[3], to[3];
+		for( int k = 0; k < 3; k++ )
+		{
+			seed = 1664525u*seed + 1013904223u;
+			dir[k] = (float)( seed >> 8 ) / (float)( 1 << 24 ) - 0.5f;
+			seed = 1664525u*seed + 1013904223u;
+			to[k] = mesh.Center[k] + mesh.Radius * ( (float)( seed >> 8 ) / (float)( 1 << 24 ) - 0.5f );
+		}
+		UnitObj( dir );
+
+		float *ray = &rays[ 6*r ];
+		for( int k = 0; k < 3; k++ )
+		{
+			ray[k] = mesh.Center[k] + 2.f * mesh.Radius * dir[k];
+			ray[3+k] = to[k] - ray[k];
+		}
+	}
+
+	t0 = std::chrono::steady_clock::now( );
+	int hits = 0;
+	for( int r = 0; r < BENCHMARKRAYS; r++ )
+	{
+		ObjRayHit hit;
+		if( IntersectObjBvh( bvh, &rays[ 6*r ], &rays[ 6*r + 3 ], 1.e+37f, &hit ) )
+			hits++;
+	}
+	double bvhSec = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - t0 ).count( );
+
+	t0 = std::chrono::steady_clock::now( );
+	int mismatches = 0;
+	for( int r = 0; r < BENCHMARKBRUTE; r++ )
+	{
+		ObjRayHit brute, fast;
+		bool b = IntersectObjMesh( mesh, &rays[ 6*r ], &rays[ 6*r + 3 ], 1.e+37f, &brute );
+		bool f = IntersectObjBvh( bvh, &rays[ 6*r ], &rays[ 6*r + 3 ], 1.e+37f, &fast );
+		if( b != f  ||  ( b  &&  fabsf( brute.T - fast.T ) > 1.e-5f * ( 1.f + brute.T ) ) )
+			mismatches++;
+	}
+	double bruteSec = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - t0 ).count( );
+
+	size_t bytes = bvh.Nodes.size()*sizeof(ObjBvhNode) + bvh.Triangles.size()*sizeof(unsigned int) + bvh.Corners.size()*sizeof(float);
+	fprintf( stderr, "Bvh '%s': %d triangles, %d nodes, %d KB, built in %.1f ms\n",
+		name, (int)bvh.Triangles.size(), (int)bvh.Nodes.size(), (int)( bytes / 1024 ), buildMs );
+	fprintf( stderr, "    bvh:         %8.3f Mrays/s  (%d of %d rays hit)\n",
+		BENCHMARKRAYS / bvhSec / 1.e6, hits, BENCHMARKRAYS );
+	fprintf( stderr, "    brute force: %8.3f Mrays/s  (%d of the first %d disagree with the bvh)\n",
+		BENCHMARKBRUTE / bruteSec / 1.e6, mismatches, BENCHMARKBRUTE );
+}
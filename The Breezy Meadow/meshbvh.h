@@ -0,0 +1,61 @@
+/*****************************************************************
+* Description: Ray queries against ObjMeshes.
+*
+*              BuildObjBvh() builds a bounding volume hierarchy over a
+*              mesh's triangles, splitting each node where the surface
+*              area heuristic says a ray will do the least work (the
+*              candidate splits are OBJBVHBINS bins of the triangles'
+*              centroids along each axis). The leaves keep their own
+*              copy of their triangles' corners, so a query never goes
+*              back to the mesh.
+*
+*              IntersectObjBvh() finds the nearest hit along a ray,
+*              visiting the nearer child of each node first.
+*              IntersectObjMesh() does the same by testing every
+*              triangle, for checking the hierarchy against and for
+*              meshes too small to be worth one.
+*
+*              Rays are org + t*dir for 0 <= t < tMax; dir need not be
+*              unit length, so a ray moved into a mesh's own coordinates
+*              by an affine matrix still measures t in world units.
+*/
+
+#pragma once
+#ifndef MESHBVH_H
+#define MESHBVH_H
+
+#include "loadobjfile.h"
+
+#define OBJBVHBINS		16		// split candidates per axis
+#define OBJBVHLEAFSIZE		4		// most triangles in a leaf
+#define OBJBVHDEPTH		64		// deepest the traversal stack goes
+
+struct ObjBvhNode
+{
+	float		Min[3];
+	unsigned int	Offset;			// leaf: first triangle; inner: the second child (the first follows this node)
+	float		Max[3];
+	unsigned int	Count;			// triangles in a leaf, 0 for an inner node
+};
+
+struct ObjBvh
+{
+	vector<ObjBvhNode>	Nodes;		// Nodes[0] is the root
+	vector<unsigned int>	Triangles;	// the mesh's triangle numbers, in leaf order
+	vector<float>		Corners;	// 9 floats per entry of Triangles
+};
+
+struct ObjRayHit
+{
+	float		T;
+	unsigned int	Triangle;		// into the mesh's Indices, 3 per triangle
+	float		U, V;			// barycentric weights of the triangle's second and third corners
+};
+
+void	BenchmarkObjBvh( const char *, const ObjMesh & );
+void	BuildObjBvh( const ObjMesh &, ObjBvh & );
+bool	IntersectObjBvh( const ObjBvh &, const float [3], const float [3], float, ObjRayHit * );
+bool	IntersectObjMesh( const ObjMesh &, const float [3], const float [3], float, ObjRayHit * );
+bool	IntersectObjSphere( const ObjMesh &, const float [3], const float [3], float );
+
+#endif
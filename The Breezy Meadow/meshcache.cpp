@@ -0,0 +1,243 @@
+#include "meshcache.h"
+#include "mappedfile.h"
+#include "meshoptimize.h"
+
+#include <string>
+
+
+// the cache is a raw image of little-endian memory:
+
+static bool
+IsLittleEndian( )
+{
+	unsigned int one = 1;
+	return *(unsigned char *)&one == 1;
+}
+
+
+static std::string
+CacheName( const char *objname )
+{
+	return std::string( objname ) + MESHCACHE_EXT;
+}
+
+
+// fill the mesh from the cache file for objname:
+// returns false if there is no cache, it is out of date, or it was not built with these flags
+
+bool
+ReadMeshCache( const char *objname, ObjMesh &mesh, unsigned int flags )
+{
+	if( ! IsLittleEndian( ) )
+		return false;
+
+	unsigned long long size;
+	long long mtime;
+	if( ! GetSourceStamp( objname, &size, &mtime ) )
+		return false;
+
+	MappedFile file;
+	if( ! MapFile( CacheName( objname ).c_str(), &file ) )
+		return false;
+
+	if( file.Size < sizeof(MeshCacheHeader) )
+	{
+		UnmapFile( &file );
+		return false;
+	}
+
+	MeshCacheHeader hdr;
+	memcpy( &hdr, file.Data, sizeof(hdr) );
+
+	size_t nv = hdr.NumVertices;
+	size_t ni = hdr.NumIndices;
+	size_t nr = hdr.NumRanges;
+	size_t expected = sizeof(hdr) + nv*( 3 + 3 + 2 )*sizeof(float) + ni*sizeof(unsigned int) +
+				nr*sizeof(ObjRange) + hdr.NameBytes;
+
+	if( hdr.Magic != MESHCACHE_MAGIC  ||  hdr.Version != MESHCACHE_VERSION  ||
+	    hdr.SourceSize != size  ||  hdr.SourceTime != mtime  ||  hdr.Flags != flags  ||  file.Size != expected )
+	{
+		UnmapFile( &file );
+		return false;
+	}
+
+	const char *p = file.Data + sizeof(hdr);
+
+	mesh.Positions.resize( 3*nv );
+	mesh.Normals.resize( 3*nv );
+	mesh.TexCoords.resize( 2*nv );
+	mesh.Indices.resize( ni );
+
+	if( nv > 0 )
+	{
+		memcpy( &mesh.Positions[0], p, 3*nv*sizeof(float) );	p += 3*nv*sizeof(float);
+		memcpy( &mesh.Normals[0],   p, 3*nv*sizeof(float) );	p += 3*nv*sizeof(float);
+		memcpy( &mesh.TexCoords[0], p, 2*nv*sizeof(float) );	p += 2*nv*sizeof(float);
+	}
+	if( ni > 0 )
+	{
+		memcpy( &mesh.Indices[0], p, ni*sizeof(unsigned int) );
+		p += ni*sizeof(unsigned int);
+	}
+
+	mesh.Ranges.resize( nr );
+	if( nr > 0 )
+	{
+		memcpy( &mesh.Ranges[0], p, nr*sizeof(ObjRange) );
+		p += nr*sizeof(ObjRange);
+	}
+
+
+	// split the names back up, making sure they are all there and end where they should:
+
+	std::vector<std::string> names;
+	const char *end = p + hdr.NameBytes;
+	while( p < end )
+	{
+		const char *nul = (const char *) memchr( p, '\0', end - p );
+		if( nul == NULL )
+			break;
+		names.push_back( std::string( p, nul ) );
+		p = nul + 1;
+	}
+
+	bool ok = ( p == end  &&  names.size() == (size_t)hdr.NumMaterialLibs + hdr.NumMaterials );
+	for( size_t r = 0; ok  &&  r < nr; r++ )
+	{
+		const ObjRange &range = mesh.Ranges[r];
+		ok = range.Material >= 0  &&  range.Material < (int)hdr.NumMaterials  &&
+		     range.FirstIndex <= ni  &&  range.NumIndices <= ni - range.FirstIndex;
+	}
+	if( ! ok )
+	{
+		UnmapFile( &file );
+		return false;
+	}
+
+	mesh.MaterialLibs.assign( names.begin(), names.begin() + hdr.NumMaterialLibs );
+	mesh.Materials.resize( hdr.NumMaterials );
+	for( unsigned int i = 0; i < hdr.NumMaterials; i++ )
+		InitObjMaterial( mesh.Materials[i], names[ hdr.NumMaterialLibs + i ] );
+
+	mesh.HasTexCoords = ( hdr.HasTexCoords != 0 );
+	for( int i = 0; i < 3; i++ )
+	{
+		mesh.Min[i] = hdr.Min[i];
+		mesh.Max[i] = hdr.Max[i];
+	}
+
+	UnmapFile( &file );
+
+	ResolveObjMaterials( objname, mesh );
+	ComputeObjSphere( mesh );
+	return true;
+}
+
+
+// write the cache file for objname:
+// the file is written under a temporary name and renamed, so a crash never leaves a half-written cache
+
+bool
+WriteMeshCache( const char *objname, const ObjMesh &mesh, unsigned int flags )
+{
+	if( ! IsLittleEndian( ) )
+		return false;
+
+	MeshCacheHeader hdr;
+	memset( &hdr, 0, sizeof(hdr) );
+	hdr.Magic = MESHCACHE_MAGIC;
+	hdr.Version = MESHCACHE_VERSION;
+	hdr.Flags = flags;
+	if( ! GetSourceStamp( objname, &hdr.SourceSize, &hdr.SourceTime ) )
+		return false;
+
+	hdr.NumVertices = (unsigned int)( mesh.Positions.size() / 3 );
+	hdr.NumIndices  = (unsigned int)mesh.Indices.size();
+	hdr.HasTexCoords = mesh.HasTexCoords ? 1 : 0;
+	for( int i = 0; i < 3; i++ )
+	{
+		hdr.Min[i] = mesh.Min[i];
+		hdr.Max[i] = mesh.Max[i];
+	}
+
+	std::string names;
+	for( size_t i = 0; i < mesh.MaterialLibs.size(); i++ )
+		names.append( mesh.MaterialLibs[i].c_str(), mesh.MaterialLibs[i].size() + 1 );
+	for( size_t i = 0; i < mesh.Materials.size(); i++ )
+		names.append( mesh.Materials[i].Name.c_str(), mesh.Materials[i].Name.size() + 1 );
+
+	hdr.NumRanges = (unsigned int)mesh.Ranges.size();
+	hdr.NumMaterials = (unsigned int)mesh.Materials.size();
+	hdr.NumMaterialLibs = (unsigned int)mesh.MaterialLibs.size();
+	hdr.NameBytes = (unsigned int)names.size();
+
+	std::string name = CacheName( objname );
+	std::string tmpname = name + ".tmp";
+
+	FILE *fp = fopen( tmpname.c_str(), "wb" );
+	if( fp == NULL )
+	{
+		fprintf( stderr, "Cannot write mesh cache '%s'\n", tmpname.c_str() );
+		return false;
+	}
+
+	size_t nv = hdr.NumVertices;
+	size_t ni = hdr.NumIndices;
+	bool ok = fwrite( &hdr, sizeof(hdr), 1, fp ) == 1;
+	if( ok  &&  nv > 0 )
+	{
+		ok = fwrite( &mesh.Positions[0], sizeof(float), 3*nv, fp ) == 3*nv  &&
+		     fwrite( &mesh.Normals[0],   sizeof(float), 3*nv, fp ) == 3*nv  &&
+		     fwrite( &mesh.TexCoords[0], sizeof(float), 2*nv, fp ) == 2*nv;
+	}
+	if( ok  &&  ni > 0 )
+		ok = fwrite( &mesh.Indices[0], sizeof(unsigned int), ni, fp ) == ni;
+	if( ok  &&  hdr.NumRanges > 0 )
+		ok = fwrite( &mesh.Ranges[0], sizeof(ObjRange), hdr.NumRanges, fp ) == hdr.NumRanges;
+	if( ok  &&  hdr.NameBytes > 0 )
+		ok = fwrite( names.data(), 1, names.size(), fp ) == names.size();
+
+	if( fclose( fp ) != 0 )
+		ok = false;
+
+#ifdef WIN32
+	if( ok )
+		ok = MoveFileExA( tmpname.c_str(), name.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+	if( ok )
+		ok = rename( tmpname.c_str(), name.c_str() ) == 0;
+#endif
+
+	if( ! ok )
+	{
+		fprintf( stderr, "Cannot write mesh cache '%s'\n", name.c_str() );
+		remove( tmpname.c_str() );
+	}
+
+	return ok;
+}
+
+
+// get the mesh for an obj file, from its cache if that is up to date, else by parsing the file
+// (and, if asked, reordering it for the vertex cache):
+// returns 0 on success, 1 if the obj file cannot be read
+
+int
+LoadObjMesh( const char *objname, ObjMesh &mesh, bool optimize )
+{
+	unsigned int flags = optimize ? MESHCACHE_OPTIMIZED : 0;
+	if( ReadMeshCache( objname, mesh, flags ) )
+		return 0;
+
+	if( ParseObjFile( objname, mesh ) != 0 )
+		return 1;
+
+	if( optimize )
+		OptimizeObjMesh( objname, mesh );
+
+	// not being able to write the cache only costs us time on the next run:
+
+	WriteMeshCache( objname, mesh, flags );
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*****************************************************************
+* Description: On-disk binary cache for parsed obj meshes.
+*
+*              The first time an obj file is loaded its final ObjMesh
+*              is written next to it as <name>.obj.meshcache. Later
+*              loads map the cache file and copy the arrays straight
+*              out, skipping the text parse completely.
+*
+*              The cache remembers the size and modification time of
+*              the obj file it was built from; if either changes, or
+*              the format version changes, the cache is rebuilt. It
+*              also remembers whether the mesh was run through
+*              OptimizeObjMesh(), and is rebuilt if that is not what
+*              the caller asked for.
+*
+*              File layout (all little-endian):
+*                  MeshCacheHeader
+*                  float          positions[ 3*NumVertices ]
+*                  float          normals[ 3*NumVertices ]
+*                  float          texcoords[ 2*NumVertices ]
+*                  unsigned int   indices[ NumIndices ]
+*                  ObjRange       ranges[ NumRanges ]
+*                  char           names[ NameBytes ]
+*
+*              names holds the NumMaterialLibs mtllib file names and
+*              then the NumMaterials material names, each ending in a
+*              0 byte. The .mtl files themselves are read again on
+*              every load, so editing one never needs a new cache.
+*/
+
+#pragma once
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "loadobjfile.h"
+
+#define MESHCACHE_EXT		".meshcache"
+#define MESHCACHE_MAGIC		0x4843534d		// "MSCH"
+#define MESHCACHE_VERSION	3
+
+#define MESHCACHE_OPTIMIZED	0x1			// Flags bit: triangles and vertices reordered for the gpu
+
+struct MeshCacheHeader
+{
+	unsigned int		Magic;
+	unsigned int		Version;
+	unsigned long long	SourceSize;		// size of the obj file in bytes
+	long long		SourceTime;		// modification time of the obj file
+	unsigned int		NumVertices;
+	unsigned int		NumIndices;
+	unsigned int		HasTexCoords;
+	float			Min[3];
+	float			Max[3];
+	unsigned int		NumRanges;
+	unsigned int		NumMaterials;
+	unsigned int		NumMaterialLibs;
+	unsigned int		NameBytes;
+	unsigned int		Flags;			// also keeps the arrays 8-byte aligned
+};
+
+int	LoadObjMesh( const char *, ObjMesh &, bool = true );
+bool	ReadMeshCache( const char *, ObjMesh &, unsigned int );
+bool	WriteMeshCache( const char *, const ObjMesh &, unsigned int );
+
+#endif
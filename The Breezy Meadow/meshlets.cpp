@@ -0,0 +1,337 @@
+#include "meshlets.h"
+
+
+#define BUFFER_OFFSET(n)	( (const GLvoid *)(size_t)(n) )
+
+// a normal cone wider than this (the smallest dot product with its axis) is not worth testing:
+
+#define MINCONEDOT		0.1f
+
+
+// cut the index list into meshlets:
+
+void
+BuildObjMeshlets( const ObjMesh &mesh, vector<ObjMeshlet> &meshlets )
+{
+	meshlets.clear( );
+
+	int nv = (int)( mesh.Positions.size() / 3 );
+	int nt = (int)( mesh.Indices.size() / 3 );
+
+	// inMeshlet[v] is the number of the meshlet that last took vertex v:
+
+	std::vector<int> inMeshlet( nv, -1 );
+
+	// a meshlet never spans two materials:
+
+	std::vector<char> startsRange( nt + 1, 0 );
+	for( size_t r = 0; r < mesh.Ranges.size(); r++ )
+		startsRange[ mesh.Ranges[r].FirstIndex / 3 ] = 1;
+
+	ObjMeshlet current;
+	int numVertices = 0;
+	current.FirstIndex = 0;
+	current.NumTriangles = 0;
+
+	for( int t = 0; t < nt; t++ )
+	{
+		const unsigned int *tri = &mesh.Indices[ 3*t ];
+		int id = (int)meshlets.size();
+
+		int added = 0;
+		for( int k = 0; k < 3; k++ )
+		{
+			if( inMeshlet[ tri[k] ] != id  &&  ( k < 1  ||  tri[k] != tri[0] )  &&  ( k < 2  ||  tri[k] != tri[1] ) )
+				added++;
+		}
+
+		if( numVertices + added > MESHLETVERTICES  ||  current.NumTriangles + 1 > MESHLETTRIANGLES  ||
+		    ( startsRange[t]  &&  current.NumTriangles > 0 ) )
+		{
+			meshlets.push_back( current );
+			id++;
+			current.FirstIndex = 3*t;
+			current.NumTriangles = 0;
+			numVertices = 0;
+		}
+
+		for( int k = 0; k < 3; k++ )
+		{
+			if( inMeshlet[ tri[k] ] != id )
+			{
+				inMeshlet[ tri[k] ] = id;
+				numVertices++;
+			}
+		}
+		current.NumTriangles++;
+	}
+
+	if( current.NumTriangles > 0 )
+		meshlets.push_back( current );
+
+	ComputeObjMeshletBounds( mesh, meshlets );
+}
+
+
+// bounding sphere and normal cone of every meshlet, from mesh's positions:
+
+void
+ComputeObjMeshletBounds( const ObjMesh &mesh, vector<ObjMeshlet> &meshlets )
+{
+	for( size_t m = 0; m < meshlets.size(); m++ )
+	{
+		ObjMeshlet &ml = meshlets[m];
+		const unsigned int *idx = &mesh.Indices[ ml.FirstIndex ];
+		int ni = 3 * ml.NumTriangles;
+
+
+		// sphere around the center of the box:
+
+		float lo[3], hi[3];
+		for( int k = 0; k < 3; k++ )
+			lo[k] = hi[k] = mesh.Positions[ 3*idx[0] + k ];
+		for( int i = 1; i < ni; i++ )
+		{
+			const float *p = &mesh.Positions[ 3*idx[i] ];
+			for( int k = 0; k < 3; k++ )
+			{
+				if( p[k] < lo[k] )	lo[k] = p[k];
+				if( p[k] > hi[k] )	hi[k] = p[k];
+			}
+		}
+
+		float r2 = 0.;
+		for( int k = 0; k < 3; k++ )
+			ml.Center[k] = ( lo[k] + hi[k] ) / 2.f;
+		for( int i = 0; i < ni; i++ )
+		{
+			const float *p = &mesh.Positions[ 3*idx[i] ];
+			float dx = p[0] - ml.Center[0], dy = p[1] - ml.Center[1], dz = p[2] - ml.Center[2];
+			float d2 = dx*dx + dy*dy + dz*dz;
+			if( d2 > r2 )
+				r2 = d2;
+		}
+		ml.Radius = sqrtf( r2 );
+
+
+		// cone around the average of the triangles' facing directions:
+
+		std::vector<float> normals( 3 * ml.NumTriangles );
+		float axis[3] = { 0., 0., 0. };
+		for( unsigned int t = 0; t < ml.NumTriangles; t++ )
+		{
+			float *p0 = (float *) &mesh.Positions[ 3*idx[3*t+0] ];
+			float *p1 = (float *) &mesh.Positions[ 3*idx[3*t+1] ];
+			float *p2 = (float *) &mesh.Positions[ 3*idx[3*t+2] ];
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float *n = &normals[ 3*t ];
+			CrossObj( e1, e2, n );
+			UnitObj( n );
+			for( int k = 0; k < 3; k++ )
+				axis[k] += n[k];
+		}
+		UnitObj( axis );
+
+		float minDot = 1.;
+		for( unsigned int t = 0; t < ml.NumTriangles; t++ )
+		{
+			const float *n = &normals[ 3*t ];
+			if( n[0] == 0.  &&  n[1] == 0.  &&  n[2] == 0. )
+				continue;		// degenerate, can't be seen anyway
+
+			float d = n[0]*axis[0] + n[1]*axis[1] + n[2]*axis[2];
+			if( d < minDot )
+				minDot = d;
+		}
+
+		for( int k = 0; k < 3; k++ )
+			ml.ConeAxis[k] = axis[k];
+		ml.ConeCutoff = ( minDot > MINCONEDOT ) ? sqrtf( 1.f - minDot*minDot ) : 1.f;
+	}
+}
+
+
+// copy the mesh into gpu buffers for drawing by meshlet:
+
+void
+UploadMeshletMesh( const ObjMesh &mesh, const vector<ObjMeshlet> &meshlets, MeshletMesh &out )
+{
+	out.Meshlets = meshlets;
+	out.NumTriangles = (int)( mesh.Indices.size() / 3 );
+	out.VertexBuffer = out.IndexBuffer = 0;
+	if( mesh.Indices.size() == 0 )
+		return;
+
+	int nv = (int)( mesh.Positions.size() / 3 );
+	std::vector<float> interleaved( 8*nv );
+	for( int i = 0; i < nv; i++ )
+	{
+		float *vp = &interleaved[ 8*i ];
+		memcpy( &vp[0], &mesh.Positions[ 3*i ], 3*sizeof(float) );
+		memcpy( &vp[3], &mesh.Normals[ 3*i ],   3*sizeof(float) );
+		memcpy( &vp[6], &mesh.TexCoords[ 2*i ], 2*sizeof(float) );
+	}
+
+	glGenBuffers( 1, &out.VertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, out.VertexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, interleaved.size()*sizeof(float), &interleaved[0], GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	glGenBuffers( 1, &out.IndexBuffer );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, out.IndexBuffer );
+	if( ObjIndexSize( mesh ) == 2 )
+	{
+		std::vector<unsigned short> indices16;
+		GetObjIndices16( mesh, indices16 );
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices16.size()*sizeof(unsigned short), &indices16[0], GL_STATIC_DRAW );
+		out.IndexType = GL_UNSIGNED_SHORT;
+	}
+	else
+	{
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, mesh.Indices.size()*sizeof(unsigned int), &mesh.Indices[0], GL_STATIC_DRAW );
+		out.IndexType = GL_UNSIGNED_INT;
+	}
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+}
+
+
+// cull and draw under the current modelview and projection matrices:
+// returns the number of triangles drawn
+
+int
+DrawMeshletMesh( const MeshletMesh &mm, bool cullBackfaces )
+{
+	if( mm.VertexBuffer == 0 )
+		return 0;
+
+	GLfloat mv[16], pr[16];
+	glGetFloatv( GL_MODELVIEW_MATRIX, mv );
+	glGetFloatv( GL_PROJECTION_MATRIX, pr );
+
+
+	// the frustum planes in the mesh's own coordinates are the rows of projection * modelview:
+
+	float clip[16];
+	for( int c = 0; c < 4; c++ )
+	{
+		for( int r = 0; r < 4; r++ )
+		{
+			clip[ 4*c + r ] = pr[ 0*4 + r ] * mv[ 4*c + 0 ] + pr[ 1*4 + r ] * mv[ 4*c + 1 ]
+					+ pr[ 2*4 + r ] * mv[ 4*c + 2 ] + pr[ 3*4 + r ] * mv[ 4*c + 3 ];
+		}
+	}
+
+	float planes[6][4];
+	for( int i = 0; i < 6; i++ )
+	{
+		int row = i / 2;
+		float sign = ( i % 2 == 0 ) ? 1.f : -1.f;
+		for( int k = 0; k < 4; k++ )
+			planes[i][k] = clip[ 4*k + 3 ] + sign * clip[ 4*k + row ];
+
+		float len = sqrtf( planes[i][0]*planes[i][0] + planes[i][1]*planes[i][1] + planes[i][2]*planes[i][2] );
+		if( len > 0. )
+		{
+			for( int k = 0; k < 4; k++ )
+				planes[i][k] /= len;
+		}
+	}
+
+
+	// the eye in the mesh's own coordinates, -inverse( A ) * t for modelview = [ A | t ]:
+
+	float eye[3] = { 0., 0., 0. };
+	if( cullBackfaces )
+	{
+		float a[3][3];
+		for( int r = 0; r < 3; r++ )
+			for( int c = 0; c < 3; c++ )
+				a[r][c] = mv[ 4*c + r ];
+
+		float inv[3][3];
+		inv[0][0] = a[1][1]*a[2][2] - a[1][2]*a[2][1];
+		inv[0][1] = a[0][2]*a[2][1] - a[0][1]*a[2][2];
+		inv[0][2] = a[0][1]*a[1][2] - a[0][2]*a[1][1];
+		inv[1][0] = a[1][2]*a[2][0] - a[1][0]*a[2][2];
+		inv[1][1] = a[0][0]*a[2][2] - a[0][2]*a[2][0];
+		inv[1][2] = a[0][2]*a[1][0] - a[0][0]*a[1][2];
+		inv[2][0] = a[1][0]*a[2][1] - a[1][1]*a[2][0];
+		inv[2][1] = a[0][1]*a[2][0] - a[0][0]*a[2][1];
+		inv[2][2] = a[0][0]*a[1][1] - a[0][1]*a[1][0];
+		float det = a[0][0]*inv[0][0] + a[0][1]*inv[1][0] + a[0][2]*inv[2][0];
+
+		if( det != 0. )
+		{
+			for( int r = 0; r < 3; r++ )
+				eye[r] = -( inv[r][0]*mv[12] + inv[r][1]*mv[13] + inv[r][2]*mv[14] ) / det;
+		}
+		else
+		{
+			cullBackfaces = false;
+		}
+	}
+
+
+	// gather the visible meshlets, running neighbours together into one range:
+
+	std::vector<GLsizei> counts;
+	std::vector<const GLvoid *> offsets;
+	int indexSize = ( mm.IndexType == GL_UNSIGNED_SHORT ) ? 2 : 4;
+	unsigned int runEnd = 0;
+	int drawn = 0;
+
+	for( size_t m = 0; m < mm.Meshlets.size(); m++ )
+	{
+		const ObjMeshlet &ml = mm.Meshlets[m];
+		const float *c = ml.Center;
+
+		bool visible = true;
+		for( int i = 0; i < 6  &&  visible; i++ )
+			visible = planes[i][0]*c[0] + planes[i][1]*c[1] + planes[i][2]*c[2] + planes[i][3] >= -ml.Radius;
+
+		if( visible  &&  cullBackfaces )
+		{
+			float v[3] = { c[0] - eye[0], c[1] - eye[1], c[2] - eye[2] };
+			float d = sqrtf( v[0]*v[0] + v[1]*v[1] + v[2]*v[2] );
+			visible = v[0]*ml.ConeAxis[0] + v[1]*ml.ConeAxis[1] + v[2]*ml.ConeAxis[2] < ml.ConeCutoff*d + ml.Radius;
+		}
+
+		if( ! visible )
+			continue;
+
+		if( counts.size() > 0  &&  runEnd == ml.FirstIndex )
+		{
+			counts.back() += 3 * ml.NumTriangles;
+		}
+		else
+		{
+			counts.push_back( 3 * ml.NumTriangles );
+			offsets.push_back( BUFFER_OFFSET( (size_t)ml.FirstIndex * indexSize ) );
+		}
+		runEnd = ml.FirstIndex + 3 * ml.NumTriangles;
+		drawn += ml.NumTriangles;
+	}
+
+	if( counts.size() == 0 )
+		return 0;
+
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_NORMAL_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mm.VertexBuffer );
+	glVertexPointer( 3, GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 0 ) );
+	glNormalPointer( GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 3*sizeof(float) ) );
+	glTexCoordPointer( 2, GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 6*sizeof(float) ) );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mm.IndexBuffer );
+	glMultiDrawElements( GL_TRIANGLES, &counts[0], mm.IndexType, &offsets[0], (GLsizei)counts.size() );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glPopClientAttrib( );
+
+	return drawn;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************
+* Description: Splits an ObjMesh into small clusters of triangles
+*              (meshlets) that can each be culled before drawing.
+*
+*              BuildObjMeshlets() cuts the index list, in its current
+*              order, into runs of at most MESHLETTRIANGLES triangles
+*              touching at most MESHLETVERTICES vertices, and never
+*              across the end of a material's range. LoadObjMesh() has
+*              already put the triangles in vertex cache order, so
+*              neighbouring triangles land in the same meshlet.
+*
+*              Every meshlet has a bounding sphere and a normal cone
+*              (an axis and a cutoff: all of its triangles face within
+*              asin( cutoff ) of the axis). ComputeObjMeshletBounds()
+*              can recompute these from other positions -- for example
+*              after the same displacement the vertex shader applies.
+*
+*              DrawMeshletMesh() culls the meshlets that are outside the
+*              view frustum (and, if asked, the ones facing completely
+*              away from the eye) under the current GL matrices and
+*              draws the rest with one glMultiDrawElements( ).
+*/
+
+#pragma once
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include "loadobjfile.h"
+
+#define MESHLETVERTICES		64
+#define MESHLETTRIANGLES	124
+
+struct ObjMeshlet
+{
+	unsigned int	FirstIndex;		// into the mesh's Indices
+	unsigned int	NumTriangles;
+	float		Center[3];
+	float		Radius;
+	float		ConeAxis[3];
+	float		ConeCutoff;		// 1. if the triangles face too many ways to ever cull
+};
+
+struct MeshletMesh
+{
+	vector<ObjMeshlet>	Meshlets;
+	GLuint			VertexBuffer;	// interleaved position, normal, texcoord
+	GLuint			IndexBuffer;
+	GLenum			IndexType;
+	int			NumTriangles;
+};
+
+void	BuildObjMeshlets( const ObjMesh &, vector<ObjMeshlet> & );
+void	ComputeObjMeshletBounds( const ObjMesh &, vector<ObjMeshlet> & );
+int	DrawMeshletMesh( const MeshletMesh &, bool );
+void	UploadMeshletMesh( const ObjMesh &, const vector<ObjMeshlet> &, MeshletMesh & );
+
+#endif
@@ -0,0 +1,290 @@
+#include "meshoptimize.h"
+
+#include <algorithm>
+
+
+// Forsyth's scoring constants:
+
+#define CACHEDECAYPOWER		1.5f
+#define LASTTRISCORE		0.75f
+#define VALENCEBOOSTSCALE	2.0f
+#define VALENCEBOOSTPOWER	0.5f
+
+#define MAXSCOREDVALENCE	32		// valence scores above this are computed, not looked up
+
+
+// the score tables, filled in before main( ) runs so the loader threads can share them:
+
+static struct ForsythScores
+{
+	float	Cache[ FORSYTHCACHESIZE ];
+	float	Valence[ MAXSCOREDVALENCE ];
+
+	ForsythScores( )
+	{
+		for( int i = 0; i < FORSYTHCACHESIZE; i++ )
+		{
+			// the three vertices of the triangle just drawn get a fixed score,
+			// so the next triangle doesn't always continue the same strip:
+
+			if( i < 3 )
+				Cache[i] = LASTTRISCORE;
+			else
+				Cache[i] = powf( 1.f - (float)( i - 3 ) / (float)( FORSYTHCACHESIZE - 3 ), CACHEDECAYPOWER );
+		}
+
+		for( int i = 0; i < MAXSCOREDVALENCE; i++ )
+			Valence[i] = ( i == 0 ) ? 0.f : VALENCEBOOSTSCALE * powf( (float)i, -VALENCEBOOSTPOWER );
+	}
+} Scores;
+
+
+// how much we want to use a vertex next:
+// cachePos is -1 if the vertex is not in the cache
+
+static float
+VertexScore( int cachePos, int remaining )
+{
+	if( remaining == 0 )
+		return -1.f;
+
+	float score = ( cachePos >= 0 ) ? Scores.Cache[ cachePos ] : 0.f;
+	if( remaining < MAXSCOREDVALENCE )
+		score += Scores.Valence[ remaining ];
+	else
+		score += VALENCEBOOSTSCALE * powf( (float)remaining, -VALENCEBOOSTPOWER );
+
+	return score;
+}
+
+
+// simulate a fifo post-transform cache over the index list:
+
+VertexCacheStats
+AnalyzeVertexCache( const ObjMesh &mesh, int cacheSize )
+{
+	VertexCacheStats stats;
+	stats.Acmr = stats.Atvr = 0.f;
+
+	size_t nv = mesh.Positions.size() / 3;
+	size_t ni = mesh.Indices.size();
+	if( nv == 0  ||  ni < 3 )
+		return stats;
+
+	// a vertex is still in the cache if fewer than cacheSize misses have happened since it was loaded:
+
+	std::vector<unsigned int> loadedAt( nv, 0 );
+	unsigned int misses = 0;
+	for( size_t i = 0; i < ni; i++ )
+	{
+		unsigned int v = mesh.Indices[i];
+		if( loadedAt[v] == 0  ||  misses - loadedAt[v] >= (unsigned int)cacheSize )
+		{
+			misses++;
+			loadedAt[v] = misses;
+		}
+	}
+
+	stats.Acmr = (float)misses / (float)( ni / 3 );
+	stats.Atvr = (float)misses / (float)nv;
+	return stats;
+}
+
+
+// reorder the triangles for the post-transform cache:
+
+void
+OptimizeVertexCache( ObjMesh &mesh )
+{
+	int nv = (int)( mesh.Positions.size() / 3 );
+	int nt = (int)( mesh.Indices.size() / 3 );
+	if( nt == 0 )
+		return;
+
+	// for each vertex, the triangles that use it and have not been drawn yet
+	// (live ones are kept at the front of the vertex's slice of adjacency):
+
+	std::vector<int> remaining( nv, 0 );
+	for( int i = 0; i < 3*nt; i++ )
+		remaining[ mesh.Indices[i] ]++;
+
+	std::vector<int> offsets( nv + 1, 0 );
+	for( int v = 0; v < nv; v++ )
+		offsets[v+1] = offsets[v] + remaining[v];
+
+	std::vector<int> adjacency( 3*nt );
+	std::vector<int> filled( nv, 0 );
+	for( int t = 0; t < nt; t++ )
+	{
+		for( int k = 0; k < 3; k++ )
+		{
+			int v = mesh.Indices[ 3*t+k ];
+			adjacency[ offsets[v] + filled[v]++ ] = t;
+		}
+	}
+
+	std::vector<int> cachePos( nv, -1 );
+	std::vector<float> vertexScore( nv );
+	for( int v = 0; v < nv; v++ )
+		vertexScore[v] = VertexScore( -1, remaining[v] );
+
+	// triangles never leave their material's range -- the ranges are in index order,
+	// so restarting at the first undrawn triangle finishes each range before the next:
+
+	std::vector<int> range( nt, 0 );
+	for( size_t r = 0; r < mesh.Ranges.size(); r++ )
+	{
+		for( unsigned int i = 0; i < mesh.Ranges[r].NumIndices / 3; i++ )
+			range[ mesh.Ranges[r].FirstIndex / 3 + i ] = (int)r;
+	}
+
+	std::vector<char> drawn( nt, 0 );
+	std::vector<unsigned int> out;
+	out.reserve( 3*nt );
+
+	int cache[ FORSYTHCACHESIZE + 3 ];
+	int cacheCount = 0;
+	int best = -1;
+	int nextUndrawn = 0;
+
+	for( int n = 0; n < nt; n++ )
+	{
+		// nothing in the cache has triangles left, so start again somewhere new:
+
+		if( best < 0 )
+		{
+			while( drawn[ nextUndrawn ] )
+				nextUndrawn++;
+			best = nextUndrawn;
+		}
+
+		const unsigned int *tri = &mesh.Indices[ 3*best ];
+		out.push_back( tri[0] );
+		out.push_back( tri[1] );
+		out.push_back( tri[2] );
+		drawn[ best ] = 1;
+		int lastDrawn = best;
+
+		for( int k = 0; k < 3; k++ )
+		{
+			int v = tri[k];
+			int *adj = &adjacency[ offsets[v] ];
+			for( int j = 0; j < remaining[v]; j++ )
+			{
+				if( adj[j] == best )
+				{
+					adj[j] = adj[ remaining[v] - 1 ];
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// the triangle's vertices go to the front of the lru cache, everything else moves back:
+
+		int newCache[ FORSYTHCACHESIZE + 3 ];
+		int newCount = 0;
+		for( int k = 0; k < 3; k++ )
+		{
+			int v = tri[k];
+			if( std::find( newCache, newCache + newCount, v ) == newCache + newCount )
+				newCache[ newCount++ ] = v;
+		}
+		for( int i = 0; i < cacheCount; i++ )
+		{
+			int v = cache[i];
+			if( v != (int)tri[0]  &&  v != (int)tri[1]  &&  v != (int)tri[2] )
+				newCache[ newCount++ ] = v;
+		}
+
+		for( int i = 0; i < newCount; i++ )
+		{
+			int v = newCache[i];
+			cachePos[v] = ( i < FORSYTHCACHESIZE ) ? i : -1;
+			vertexScore[v] = VertexScore( cachePos[v], remaining[v] );
+		}
+
+		// rescore the triangles that touch the cache and take the best of them next:
+
+		best = -1;
+		float bestScore = -1.f;
+		for( int i = 0; i < newCount; i++ )
+		{
+			int v = newCache[i];
+			const int *adj = &adjacency[ offsets[v] ];
+			for( int j = 0; j < remaining[v]; j++ )
+			{
+				int t = adj[j];
+				if( range[t] != range[ lastDrawn ] )
+					continue;
+
+				const unsigned int *ti = &mesh.Indices[ 3*t ];
+				float score = vertexScore[ ti[0] ] + vertexScore[ ti[1] ] + vertexScore[ ti[2] ];
+				if( score > bestScore )
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		cacheCount = ( newCount < FORSYTHCACHESIZE ) ? newCount : FORSYTHCACHESIZE;
+		memcpy( cache, newCache, cacheCount*sizeof(int) );
+	}
+
+	mesh.Indices.swap( out );
+}
+
+
+// renumber the vertices in the order the index list first reaches them:
+// vertices no triangle uses are dropped
+
+void
+OptimizeVertexFetch( ObjMesh &mesh )
+{
+	size_t nv = mesh.Positions.size() / 3;
+	std::vector<int> remap( nv, -1 );
+
+	int next = 0;
+	for( size_t i = 0; i < mesh.Indices.size(); i++ )
+	{
+		unsigned int v = mesh.Indices[i];
+		if( remap[v] < 0 )
+			remap[v] = next++;
+		mesh.Indices[i] = remap[v];
+	}
+
+	std::vector<float> positions( 3*next ), normals( 3*next ), texcoords( 2*next );
+	for( size_t v = 0; v < nv; v++ )
+	{
+		int r = remap[v];
+		if( r < 0 )
+			continue;
+
+		memcpy( &positions[ 3*r ], &mesh.Positions[ 3*v ], 3*sizeof(float) );
+		memcpy( &normals[ 3*r ],   &mesh.Normals[ 3*v ],   3*sizeof(float) );
+		memcpy( &texcoords[ 2*r ], &mesh.TexCoords[ 2*v ], 2*sizeof(float) );
+	}
+
+	mesh.Positions.swap( positions );
+	mesh.Normals.swap( normals );
+	mesh.TexCoords.swap( texcoords );
+}
+
+
+// both passes, reporting what they bought:
+
+void
+OptimizeObjMesh( const char *name, ObjMesh &mesh )
+{
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+
+	VertexCacheStats before = AnalyzeVertexCache( mesh );
+	OptimizeVertexCache( mesh );
+	OptimizeVertexFetch( mesh );
+	VertexCacheStats after = AnalyzeVertexCache( mesh );
+
+	double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+	fprintf( stderr, "Optimized '%s': ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%d-entry fifo), %.1f ms\n",
+		name, before.Acmr, after.Acmr, before.Atvr, after.Atvr, VERTEXCACHESIZE, ms );
+}
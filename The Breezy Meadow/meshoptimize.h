@@ -0,0 +1,40 @@
+/*****************************************************************
+* Description: Post-load reordering of an ObjMesh for the gpu.
+*
+*              OptimizeVertexCache() reorders the triangles so that
+*              neighbouring triangles share vertices while they are
+*              still in the post-transform cache (Tom Forsyth's
+*              "Linear-Speed Vertex Cache Optimisation"). Triangles
+*              stay inside their material's range.
+*
+*              OptimizeVertexFetch() then renumbers the vertices in the
+*              order the triangles first use them, so the vertex arrays
+*              are read front to back.
+*
+*              AnalyzeVertexCache() simulates a FIFO cache of the given
+*              size and reports
+*                  ACMR - cache misses per triangle (0.5 is ideal, 3 is worst)
+*                  ATVR - cache misses per vertex (1.0 is ideal)
+*/
+
+#pragma once
+#ifndef MESHOPTIMIZE_H
+#define MESHOPTIMIZE_H
+
+#include "loadobjfile.h"
+
+#define FORSYTHCACHESIZE	32		// lru cache the triangle ordering is tuned for
+#define VERTEXCACHESIZE		16		// fifo cache the statistics are measured with
+
+struct VertexCacheStats
+{
+	float	Acmr;
+	float	Atvr;
+};
+
+VertexCacheStats	AnalyzeVertexCache( const ObjMesh &, int = VERTEXCACHESIZE );
+void			OptimizeObjMesh( const char *, ObjMesh & );
+void			OptimizeVertexCache( ObjMesh & );
+void			OptimizeVertexFetch( ObjMesh & );
+
+#endif
@@ -0,0 +1,464 @@
+#include "meshpack.h"
+#include "mappedfile.h"
+#include "meshcache.h"
+
+#include <string>
+
+
+// the header is written as a raw image of little-endian memory:
+
+static bool
+IsLittleEndian( )
+{
+	unsigned int one = 1;
+	return *(unsigned char *)&one == 1;
+}
+
+
+static std::string
+PackName( const char *objname )
+{
+	return std::string( objname ) + MESHPACK_EXT;
+}
+
+
+static inline unsigned int
+Zigzag( int d )
+{
+	return ( (unsigned int)d << 1 ) ^ (unsigned int)( d >> 31 );
+}
+
+
+static inline int
+Unzigzag( unsigned int z )
+{
+	return (int)( z >> 1 ) ^ -(int)( z & 1 );
+}
+
+
+static inline void
+PutVarint( std::vector<unsigned char> &out, unsigned int v )
+{
+	while( v >= 0x80 )
+	{
+		out.push_back( (unsigned char)( v | 0x80 ) );
+		v >>= 7;
+	}
+	out.push_back( (unsigned char)v );
+}
+
+
+// read one varint:
+// returns NULL if it runs past end or is longer than an unsigned int can be
+
+static inline const unsigned char *
+GetVarint( const unsigned char *p, const unsigned char *end, unsigned int *v )
+{
+	if( p < end  &&  *p < 0x80 )
+	{
+		*v = *p;
+		return p + 1;
+	}
+
+	unsigned int x = 0;
+	for( int shift = 0; shift < 35; shift += 7 )
+	{
+		if( p == end )
+			return NULL;
+		unsigned int b = *p++;
+		x |= ( b & 0x7f ) << shift;
+		if( b < 0x80 )
+		{
+			*v = x;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+
+// the 7 shorts of a vertex, in the order they are stored:
+
+static void
+GetVertexShorts( const PackedVertex &pv, short s[7] )
+{
+	s[0] = pv.Position[0];
+	s[1] = pv.Position[1];
+	s[2] = pv.Position[2];
+	s[3] = pv.Normal[0];
+	s[4] = pv.Normal[1];
+	s[5] = pv.TexCoord[0];
+	s[6] = pv.TexCoord[1];
+}
+
+
+// decode the vertex stream into out, a whole vertex at a time
+// (out may be write-combined gpu memory, so it is only ever written in order, never read):
+// returns false if the stream is damaged
+
+static bool
+DecodeMeshPackVertices( const unsigned char *p, const unsigned char *end, PackedVertex *out, unsigned int nv )
+{
+	short prev[7] = { 0, 0, 0, 0, 0, 0, 0 };
+	for( unsigned int v = 0; v < nv; v++ )
+	{
+		for( int k = 0; k < 7; k++ )
+		{
+			unsigned int z;
+			p = GetVarint( p, end, &z );
+			if( p == NULL )
+				return false;
+			prev[k] = (short)( prev[k] + Unzigzag( z ) );
+		}
+
+		PackedVertex pv;
+		pv.Position[0] = prev[0];
+		pv.Position[1] = prev[1];
+		pv.Position[2] = prev[2];
+		pv.Position[3] = 0;
+		pv.Normal[0] = prev[3];
+		pv.Normal[1] = prev[4];
+		pv.TexCoord[0] = prev[5];
+		pv.TexCoord[1] = prev[6];
+		out[v] = pv;
+	}
+	return p == end;
+}
+
+
+// decode the index stream into whichever of out16 and out32 is not NULL:
+// returns false if the stream is damaged or an index is out of range
+
+static bool
+DecodeMeshPackIndices( const unsigned char *p, const unsigned char *end, unsigned short *out16, unsigned int *out32,
+			unsigned int ni, unsigned int nv )
+{
+	unsigned int prev = 0;
+	for( unsigned int i = 0; i < ni; i++ )
+	{
+		unsigned int z;
+		p = GetVarint( p, end, &z );
+		if( p == NULL )
+			return false;
+		prev += (unsigned int)Unzigzag( z );
+		if( prev >= nv )
+			return false;
+
+		if( out16 != NULL )
+			out16[i] = (unsigned short)prev;
+		else
+			out32[i] = prev;
+	}
+	return p == end;
+}
+
+
+// map the pack for objname and check that it is whole and up to date:
+// on success, the caller must unmap file
+
+static bool
+OpenMeshPack( const char *objname, MappedFile *file, MeshPackHeader *hdr )
+{
+	if( ! IsLittleEndian( ) )
+		return false;
+
+	if( ! MapFile( PackName( objname ).c_str(), file ) )
+		return false;
+
+	if( file->Size < sizeof(MeshPackHeader) )
+	{
+		UnmapFile( file );
+		return false;
+	}
+
+	memcpy( hdr, file->Data, sizeof(MeshPackHeader) );
+
+	bool ok = hdr->Magic == MESHPACK_MAGIC  &&  hdr->Version == MESHPACK_VERSION  &&
+		  file->Size == sizeof(MeshPackHeader) + (size_t)hdr->VertexBytes + hdr->IndexBytes  &&
+		  hdr->NumIndices % 3 == 0;
+
+	// a pack shipped without its obj file is used as it is:
+
+	unsigned long long size;
+	long long mtime;
+	if( ok  &&  hdr->SourceSize != 0  &&  GetSourceStamp( objname, &size, &mtime ) )
+		ok = ( hdr->SourceSize == size  &&  hdr->SourceTime == mtime );
+
+	if( ! ok )
+		UnmapFile( file );
+	return ok;
+}
+
+
+static void
+SetPackedFields( const MeshPackHeader &hdr, PackedMesh &packed )
+{
+	for( int k = 0; k < 3; k++ )
+	{
+		packed.PosOffset[k] = hdr.PosOffset[k];
+		packed.PosScale[k] = hdr.PosScale[k];
+	}
+	for( int k = 0; k < 2; k++ )
+	{
+		packed.TexOffset[k] = hdr.TexOffset[k];
+		packed.TexScale[k] = hdr.TexScale[k];
+	}
+	packed.NumIndices = (int)hdr.NumIndices;
+	packed.IndexType = ( hdr.NumVertices <= 65536 ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	packed.VertexBuffer = packed.IndexBuffer = 0;
+}
+
+
+// decode the pack for objname into packed's cpu-side arrays, ready for UploadPackedMesh( ):
+// returns false if there is no pack, it is out of date, or it is damaged
+
+bool
+ReadMeshPack( const char *objname, PackedMesh &packed )
+{
+	MappedFile file;
+	MeshPackHeader hdr;
+	if( ! OpenMeshPack( objname, &file, &hdr ) )
+		return false;
+
+	const unsigned char *p = (const unsigned char *)file.Data + sizeof(hdr);
+	const unsigned char *mid = p + hdr.VertexBytes;
+	const unsigned char *end = mid + hdr.IndexBytes;
+
+	packed.Vertices.resize( hdr.NumVertices );
+	packed.Indices.resize( hdr.NumIndices );
+	bool ok = DecodeMeshPackVertices( p, mid, packed.Vertices.data(), hdr.NumVertices )  &&
+		  DecodeMeshPackIndices( mid, end, NULL, packed.Indices.data(), hdr.NumIndices, hdr.NumVertices );
+	UnmapFile( &file );
+
+	if( ! ok )
+	{
+		fprintf( stderr, "Mesh pack '%s' is damaged\n", PackName( objname ).c_str() );
+		std::vector<PackedVertex>().swap( packed.Vertices );
+		std::vector<unsigned int>().swap( packed.Indices );
+		return false;
+	}
+
+	SetPackedFields( hdr, packed );
+	return true;
+}
+
+
+// decode the pack for objname straight into new gpu buffers, as if UploadPackedMesh( ) had been called:
+// returns false if there is no pack, it is out of date, or it is damaged
+
+bool
+LoadMeshPack( const char *objname, PackedMesh &packed )
+{
+	MappedFile file;
+	MeshPackHeader hdr;
+	if( ! OpenMeshPack( objname, &file, &hdr ) )
+		return false;
+
+	if( hdr.NumVertices == 0  ||  hdr.NumIndices == 0 )
+	{
+		UnmapFile( &file );
+		return false;
+	}
+
+	const unsigned char *p = (const unsigned char *)file.Data + sizeof(hdr);
+	const unsigned char *mid = p + hdr.VertexBytes;
+	const unsigned char *end = mid + hdr.IndexBytes;
+	SetPackedFields( hdr, packed );
+	std::vector<PackedVertex>().swap( packed.Vertices );
+	std::vector<unsigned int>().swap( packed.Indices );
+
+	size_t indexSize = ( packed.IndexType == GL_UNSIGNED_SHORT ) ? sizeof(unsigned short) : sizeof(unsigned int);
+
+	glGenBuffers( 1, &packed.VertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, packed.VertexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, hdr.NumVertices*sizeof(PackedVertex), NULL, GL_STATIC_DRAW );
+	PackedVertex *vertices = (PackedVertex *) glMapBuffer( GL_ARRAY_BUFFER, GL_WRITE_ONLY );
+	bool ok = ( vertices != NULL )  &&  DecodeMeshPackVertices( p, mid, vertices, hdr.NumVertices );
+	if( vertices != NULL  &&  glUnmapBuffer( GL_ARRAY_BUFFER ) == GL_FALSE )
+		ok = false;
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	if( ok )
+	{
+		glGenBuffers( 1, &packed.IndexBuffer );
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, packed.IndexBuffer );
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, hdr.NumIndices*indexSize, NULL, GL_STATIC_DRAW );
+		void *indices = glMapBuffer( GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY );
+		if( indices == NULL )
+			ok = false;
+		else if( packed.IndexType == GL_UNSIGNED_SHORT )
+			ok = DecodeMeshPackIndices( mid, end, (unsigned short *)indices, NULL, hdr.NumIndices, hdr.NumVertices );
+		else
+			ok = DecodeMeshPackIndices( mid, end, NULL, (unsigned int *)indices, hdr.NumIndices, hdr.NumVertices );
+		if( indices != NULL  &&  glUnmapBuffer( GL_ELEMENT_ARRAY_BUFFER ) == GL_FALSE )
+			ok = false;
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	}
+
+	UnmapFile( &file );
+
+	if( ! ok )
+	{
+		fprintf( stderr, "Cannot decode mesh pack '%s' into gpu buffers\n", PackName( objname ).c_str() );
+		DeletePackedMesh( packed );
+		return false;
+	}
+
+	return true;
+}
+
+
+// write the pack for objname from packed's cpu-side arrays (so before UploadPackedMesh( ) frees them):
+// the file is written under a temporary name and renamed, so a crash never leaves a half-written pack
+
+bool
+WriteMeshPack( const char *objname, const PackedMesh &packed )
+{
+	if( ! IsLittleEndian( ) )
+		return false;
+
+	MeshPackHeader hdr;
+	memset( &hdr, 0, sizeof(hdr) );
+	hdr.Magic = MESHPACK_MAGIC;
+	hdr.Version = MESHPACK_VERSION;
+	if( ! GetSourceStamp( objname, &hdr.SourceSize, &hdr.SourceTime ) )
+		hdr.SourceSize = 0;
+
+	hdr.NumVertices = (unsigned int)packed.Vertices.size();
+	hdr.NumIndices = (unsigned int)packed.Indices.size();
+	for( int k = 0; k < 3; k++ )
+	{
+		hdr.PosOffset[k] = packed.PosOffset[k];
+		hdr.PosScale[k] = packed.PosScale[k];
+	}
+	for( int k = 0; k < 2; k++ )
+	{
+		hdr.TexOffset[k] = packed.TexOffset[k];
+		hdr.TexScale[k] = packed.TexScale[k];
+	}
+
+
+	// the differences wrap around in 16 bits, so no vertex ever takes more than 3 bytes a short:
+
+	std::vector<unsigned char> bytes;
+	bytes.reserve( packed.Vertices.size() * 8 + packed.Indices.size() * 2 );
+
+	short prev[7] = { 0, 0, 0, 0, 0, 0, 0 };
+	for( size_t v = 0; v < packed.Vertices.size(); v++ )
+	{
+		short s[7];
+		GetVertexShorts( packed.Vertices[v], s );
+		for( int k = 0; k < 7; k++ )
+		{
+			PutVarint( bytes, Zigzag( (short)( s[k] - prev[k] ) ) );
+			prev[k] = s[k];
+		}
+	}
+	hdr.VertexBytes = (unsigned int)bytes.size();
+
+	unsigned int prevIndex = 0;
+	for( size_t i = 0; i < packed.Indices.size(); i++ )
+	{
+		PutVarint( bytes, Zigzag( (int)( packed.Indices[i] - prevIndex ) ) );
+		prevIndex = packed.Indices[i];
+	}
+	hdr.IndexBytes = (unsigned int)bytes.size() - hdr.VertexBytes;
+
+	std::string name = PackName( objname );
+	std::string tmpname = name + ".tmp";
+
+	FILE *fp = fopen( tmpname.c_str(), "wb" );
+	if( fp == NULL )
+	{
+		fprintf( stderr, "Cannot write mesh pack '%s'\n", tmpname.c_str() );
+		return false;
+	}
+
+	bool ok = fwrite( &hdr, sizeof(hdr), 1, fp ) == 1;
+	if( ok  &&  bytes.size() > 0 )
+		ok = fwrite( &bytes[0], 1, bytes.size(), fp ) == bytes.size();
+	if( fclose( fp ) != 0 )
+		ok = false;
+
+#ifdef WIN32
+	if( ok )
+		ok = MoveFileExA( tmpname.c_str(), name.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+	if( ok )
+		ok = rename( tmpname.c_str(), name.c_str() ) == 0;
+#endif
+
+	if( ! ok )
+	{
+		fprintf( stderr, "Cannot write mesh pack '%s'\n", name.c_str() );
+		remove( tmpname.c_str() );
+	}
+
+	return ok;
+}
+
+
+static long long
+GetFileBytes( const char *name )
+{
+	FILE *fp = fopen( name, "rb" );
+	if( fp == NULL )
+		return 0;
+	fseek( fp, 0, SEEK_END );
+	long long n = (long long)ftell( fp );
+	fclose( fp );
+	return n;
+}
+
+
+// benchmark: pack an obj file's mesh, then compare the sizes of the obj text, its mesh cache
+// and its pack, and the time to parse the text with the time to decode the pack
+// (best of several runs of each), checking that the pack decodes to exactly what was packed
+
+void
+BenchmarkMeshPack( const char *objname )
+{
+	ObjMesh mesh;
+	if( LoadObjMesh( objname, mesh ) != 0 )
+		return;
+
+	PackedMesh packed;
+	PackObjMesh( mesh, packed );
+	if( ! WriteMeshPack( objname, packed ) )
+		return;
+
+	double parseMs = 1.e+37;
+	for( int run = 0; run < 3; run++ )
+	{
+		ObjMesh parsed;
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+		ParseObjFile( objname, parsed );
+		double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+		if( ms < parseMs )
+			parseMs = ms;
+	}
+
+	double decodeMs = 1.e+37;
+	bool same = true;
+	for( int run = 0; run < 10; run++ )
+	{
+		PackedMesh decoded;
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+		bool ok = ReadMeshPack( objname, decoded );
+		double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+		if( ms < decodeMs )
+			decodeMs = ms;
+
+		same = same  &&  ok  &&  decoded.Indices == packed.Indices  &&  decoded.Vertices.size() == packed.Vertices.size()  &&
+			( packed.Vertices.size() == 0  ||
+			  memcmp( &decoded.Vertices[0], &packed.Vertices[0], packed.Vertices.size()*sizeof(PackedVertex) ) == 0 );
+	}
+
+	long long objBytes = GetFileBytes( objname );
+	long long cacheBytes = GetFileBytes( ( std::string( objname ) + MESHCACHE_EXT ).c_str() );
+	long long packBytes = GetFileBytes( PackName( objname ).c_str() );
+	fprintf( stderr, "%-28s obj %6d KB  cache %6d KB  pack %5d KB (%.1fx smaller)  parse %7.2f ms  decode %6.2f ms (%.0fx faster)  same: %s\n",
+		objname, (int)( objBytes / 1024 ), (int)( cacheBytes / 1024 ), (int)( packBytes / 1024 ),
+		packBytes > 0 ? (double)objBytes / (double)packBytes : 0., parseMs, decodeMs, parseMs / decodeMs,
+		same ? "yes" : "NO" );
+}
@@ -0,0 +1,66 @@
+/*****************************************************************
+* Description: Compressed container for shipping PackedMeshes.
+*
+*              A .meshpack file holds a mesh already quantized the
+*              way PackObjMesh() does it, so loading one is only a
+*              decode into the 16-byte PackedVertex layout - no text,
+*              no floats. LoadMeshPack() decodes straight into mapped
+*              gpu buffers; ReadMeshPack() into the cpu-side arrays.
+*
+*              Each vertex is its 7 shorts (position, octahedral
+*              normal, texcoord) stored as the difference from the
+*              vertex before it, and each index as the difference from
+*              the index before it. Every difference is zigzagged, so
+*              small negative ones stay small, and written as a
+*              little-endian base-128 varint: 7 bits a byte, the high
+*              bit set on every byte but the last. Meshes that have
+*              been through OptimizeObjMesh() number their vertices in
+*              the order the triangles use them, which is what keeps
+*              both kinds of difference small.
+*
+*              File layout:
+*                  MeshPackHeader
+*                  unsigned char  vertices[ VertexBytes ]
+*                  unsigned char  indices[ IndexBytes ]
+*
+*              Like the mesh cache, a pack written next to an obj file
+*              remembers that file's size and modification time and is
+*              ignored if the obj file changes. A pack shipped without
+*              its obj file is always used.
+*
+*              The meadow only writes and reads packs under
+*              BENCHMARK_LOADERS: its flowers' levels of detail are
+*              simplified from the obj meshes at startup, so those have
+*              to be loaded whether or not there is a pack.
+*/
+
+#pragma once
+#ifndef MESHPACK_H
+#define MESHPACK_H
+
+#include "packedmesh.h"
+
+#define MESHPACK_EXT		".meshpack"
+#define MESHPACK_MAGIC		0x4b41504d		// "MPAK"
+#define MESHPACK_VERSION	1
+
+struct MeshPackHeader
+{
+	unsigned int		Magic;
+	unsigned int		Version;
+	unsigned long long	SourceSize;		// size of the obj file in bytes, 0 if there wasn't one
+	long long		SourceTime;		// modification time of the obj file
+	unsigned int		NumVertices;
+	unsigned int		NumIndices;
+	float			PosOffset[3], PosScale[3];
+	float			TexOffset[2], TexScale[2];
+	unsigned int		VertexBytes;
+	unsigned int		IndexBytes;
+};
+
+void	BenchmarkMeshPack( const char * );
+bool	LoadMeshPack( const char *, PackedMesh & );
+bool	ReadMeshPack( const char *, PackedMesh & );
+bool	WriteMeshPack( const char *, const PackedMesh & );
+
+#endif
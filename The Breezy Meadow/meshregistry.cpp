@@ -0,0 +1,254 @@
+#include "meshregistry.h"
+#include "mappedfile.h"
+#include "meshcache.h"
+
+#include <stdlib.h>
+#include <ctype.h>
+#include <limits.h>
+#include <map>
+
+
+#define BUFFER_OFFSET(n)	( (const GLvoid *)(size_t)(n) )
+
+
+// every registered mesh under each canonical path it was asked for by, and under its contents:
+
+static std::map<std::string, SharedMesh *>		MeshesByPath;
+static std::map<unsigned long long, SharedMesh *>	MeshesByHash;
+
+
+// turn a file name into one string per file, whichever way it was spelled:
+
+void
+GetCanonicalPath( const char *name, std::string &path )
+{
+#ifdef WIN32
+	char full[ _MAX_PATH ];
+	if( _fullpath( full, name, _MAX_PATH ) == NULL )
+		path = name;
+	else
+		path = full;
+
+	// windows file names are case-insensitive and take either slash:
+
+	for( size_t i = 0; i < path.size(); i++ )
+	{
+		if( path[i] == '\\' )
+			path[i] = '/';
+		else
+			path[i] = (char)tolower( (unsigned char)path[i] );
+	}
+#else
+	char *full = realpath( name, NULL );
+	if( full == NULL )
+	{
+		path = name;
+	}
+	else
+	{
+		path = full;
+		free( full );
+	}
+#endif
+}
+
+
+// 64-bit FNV-1a of a whole file:
+
+bool
+HashFileContents( const char *name, unsigned long long *hash )
+{
+	MappedFile mf;
+	if( ! MapFile( name, &mf ) )
+		return false;
+
+	unsigned long long h = 14695981039346656037ULL;
+	for( size_t i = 0; i < mf.Size; i++ )
+	{
+		h ^= (unsigned char)mf.Data[i];
+		h *= 1099511628211ULL;
+	}
+
+	UnmapFile( &mf );
+	*hash = h;
+	return true;
+}
+
+
+static bool
+UploadSharedMesh( const ObjMesh &mesh, SharedMesh *shared )
+{
+	int nv = (int)( mesh.Positions.size() / 3 );
+	if( nv == 0  ||  mesh.Indices.size() == 0 )
+		return false;
+
+	std::vector<float> interleaved( 8*nv );
+	for( int i = 0; i < nv; i++ )
+	{
+		float *vp = &interleaved[ 8*i ];
+		memcpy( &vp[0], &mesh.Positions[ 3*i ], 3*sizeof(float) );
+		memcpy( &vp[3], &mesh.Normals[ 3*i ],   3*sizeof(float) );
+		memcpy( &vp[6], &mesh.TexCoords[ 2*i ], 2*sizeof(float) );
+	}
+
+	glGenBuffers( 1, &shared->VertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, shared->VertexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, interleaved.size()*sizeof(float), &interleaved[0], GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	glGenBuffers( 1, &shared->IndexBuffer );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, shared->IndexBuffer );
+	if( ObjIndexSize( mesh ) == 2 )
+	{
+		std::vector<unsigned short> indices16;
+		GetObjIndices16( mesh, indices16 );
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices16.size()*sizeof(unsigned short), &indices16[0], GL_STATIC_DRAW );
+		shared->IndexType = GL_UNSIGNED_SHORT;
+	}
+	else
+	{
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, mesh.Indices.size()*sizeof(unsigned int), &mesh.Indices[0], GL_STATIC_DRAW );
+		shared->IndexType = GL_UNSIGNED_INT;
+	}
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+	shared->NumIndices = (int)mesh.Indices.size();
+	shared->NumVertices = nv;
+	return true;
+}
+
+
+// get a reference to the gpu copy of an obj file, uploading it if this is the first:
+// if loaded is given, it is the file's mesh, already read, and is used instead of reading it again
+// returns NULL if the file can't be read or has no triangles
+
+SharedMesh *
+AcquireObjMesh( const char *name, const ObjMesh *loaded )
+{
+	std::string path;
+	GetCanonicalPath( name, path );
+
+	std::map<std::string, SharedMesh *>::iterator byPath = MeshesByPath.find( path );
+	if( byPath != MeshesByPath.end() )
+	{
+		byPath->second->RefCount++;
+		return byPath->second;
+	}
+
+	unsigned long long hash = 0;
+	bool hashed = HashFileContents( name, &hash );
+	if( hashed )
+	{
+		std::map<unsigned long long, SharedMesh *>::iterator byHash = MeshesByHash.find( hash );
+		if( byHash != MeshesByHash.end() )
+		{
+			MeshesByPath[ path ] = byHash->second;
+			byHash->second->RefCount++;
+			return byHash->second;
+		}
+	}
+
+	ObjMesh mesh;
+	if( loaded == NULL )
+	{
+		if( LoadObjMesh( name, mesh ) != 0 )
+			return NULL;
+		loaded = &mesh;
+	}
+
+	SharedMesh *shared = new SharedMesh;
+	shared->Path = path;
+	shared->Hash = hash;
+	shared->VertexBuffer = shared->IndexBuffer = 0;
+	shared->IndexType = GL_UNSIGNED_INT;
+	shared->NumIndices = shared->NumVertices = 0;
+	shared->RefCount = 1;
+
+	if( ! UploadSharedMesh( *loaded, shared ) )
+	{
+		fprintf( stderr, "Obj file '%s' has no triangles to share\n", name );
+		delete shared;
+		return NULL;
+	}
+
+	MeshesByPath[ path ] = shared;
+	if( hashed )
+		MeshesByHash[ hash ] = shared;
+	return shared;
+}
+
+
+// give back one reference, deleting the gpu copy with the last one:
+
+void
+ReleaseObjMesh( SharedMesh *shared )
+{
+	if( shared == NULL  ||  --shared->RefCount > 0 )
+		return;
+
+	for( std::map<std::string, SharedMesh *>::iterator it = MeshesByPath.begin(); it != MeshesByPath.end(); )
+	{
+		if( it->second == shared )
+			MeshesByPath.erase( it++ );
+		else
+			++it;
+	}
+
+	std::map<unsigned long long, SharedMesh *>::iterator byHash = MeshesByHash.find( shared->Hash );
+	if( byHash != MeshesByHash.end()  &&  byHash->second == shared )
+		MeshesByHash.erase( byHash );
+
+	glDeleteBuffers( 1, &shared->VertexBuffer );
+	glDeleteBuffers( 1, &shared->IndexBuffer );
+	delete shared;
+}
+
+
+void
+DrawSharedMesh( const SharedMesh *shared )
+{
+	if( shared == NULL )
+		return;
+
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_NORMAL_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+
+	glBindBuffer( GL_ARRAY_BUFFER, shared->VertexBuffer );
+	glVertexPointer( 3, GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 0 ) );
+	glNormalPointer( GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 3*sizeof(float) ) );
+	glTexCoordPointer( 2, GL_FLOAT, 8*sizeof(float), BUFFER_OFFSET( 6*sizeof(float) ) );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, shared->IndexBuffer );
+	glDrawElements( GL_TRIANGLES, shared->NumIndices, shared->IndexType, BUFFER_OFFSET( 0 ) );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glPopClientAttrib( );
+}
+
+
+// list what is registered, how many references each has, and what sharing saved:
+
+void
+PrintMeshRegistry( )
+{
+	std::map<SharedMesh *, int> paths;
+	for( std::map<std::string, SharedMesh *>::iterator it = MeshesByPath.begin(); it != MeshesByPath.end(); ++it )
+		paths[ it->second ]++;
+
+	size_t bytes = 0, saved = 0;
+	for( std::map<SharedMesh *, int>::iterator it = paths.begin(); it != paths.end(); ++it )
+	{
+		SharedMesh *shared = it->first;
+		size_t size = (size_t)shared->NumVertices * 8 * sizeof(float) +
+			(size_t)shared->NumIndices * ( shared->IndexType == GL_UNSIGNED_SHORT ? 2 : 4 );
+		bytes += size;
+		saved += size * ( shared->RefCount - 1 );
+		fprintf( stderr, "Shared mesh '%s': %d references, %d path(s), %d KB\n",
+			shared->Path.c_str(), shared->RefCount, it->second, (int)( size / 1024 ) );
+	}
+	fprintf( stderr, "Shared meshes use %d KB on the gpu, %d KB less than one copy per reference\n",
+		(int)( bytes / 1024 ), (int)( saved / 1024 ) );
+}
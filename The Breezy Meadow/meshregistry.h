@@ -0,0 +1,48 @@
+/*****************************************************************
+* Description: A registry of obj meshes that have been uploaded to
+*              the gpu, so that any number of objects can draw from
+*              one copy of the same geometry.
+*
+*              AcquireObjMesh() looks a file up by its canonical path
+*              first. If that misses, it hashes the file's contents,
+*              so the same file reached through a different path, or
+*              a byte-for-byte copy of it, is still shared. Only if
+*              both miss is the mesh loaded (or taken from an already
+*              loaded ObjMesh) and uploaded.
+*
+*              Every AcquireObjMesh() hands out one more reference;
+*              ReleaseObjMesh() gives one back and deletes the gpu
+*              buffers when the last one is gone.
+*
+*              Uses GL, so call it from the thread that owns the
+*              context.
+*/
+
+#pragma once
+#ifndef MESHREGISTRY_H
+#define MESHREGISTRY_H
+
+#include <string>
+
+#include "loadobjfile.h"
+
+struct SharedMesh
+{
+	std::string		Path;		// canonical path of the first file it was loaded from
+	unsigned long long	Hash;		// of that file's contents
+	GLuint			VertexBuffer;	// interleaved position, normal, texcoord
+	GLuint			IndexBuffer;
+	GLenum			IndexType;
+	int			NumIndices;
+	int			NumVertices;
+	int			RefCount;
+};
+
+SharedMesh *	AcquireObjMesh( const char *, const ObjMesh * = NULL );
+void		DrawSharedMesh( const SharedMesh * );
+void		GetCanonicalPath( const char *, std::string & );
+bool		HashFileContents( const char *, unsigned long long * );
+void		PrintMeshRegistry( );
+void		ReleaseObjMesh( SharedMesh * );
+
+#endif
@@ -0,0 +1,481 @@
+#include "meshsimplify.h"
+#include "meshoptimize.h"
+
+#include <algorithm>
+
+
+// how much more an open border's outline counts than the surface itself:
+
+#define BORDERWEIGHT		10.
+
+
+// what a vertex is allowed to do:
+
+enum VertexKinds
+{
+	VERTEX_MANIFOLD,		// may collapse onto any neighbour
+	VERTEX_BORDER,			// on an open edge: may only collapse along that edge
+	VERTEX_LOCKED,			// on a seam, or somewhere odd: never collapses
+};
+
+
+// symmetric 4x4 error quadric -- the weighted sum of squared distances to a set of planes:
+
+struct Quadric
+{
+	double	A2, AB, AC, AD, B2, BC, BD, C2, CD, D2;
+	double	W;			// total weight, so the error can be given as an average
+};
+
+
+struct Collapse
+{
+	unsigned int	From, To;
+	double		Error;
+
+	bool operator<( const Collapse &c ) const	{ return Error < c.Error; }
+};
+
+
+static void
+AddPlaneQuadric( Quadric &q, double a, double b, double c, double d, double w )
+{
+	q.A2 += w*a*a;	q.AB += w*a*b;	q.AC += w*a*c;	q.AD += w*a*d;
+	q.B2 += w*b*b;	q.BC += w*b*c;	q.BD += w*b*d;
+	q.C2 += w*c*c;	q.CD += w*c*d;
+	q.D2 += w*d*d;
+	q.W += w;
+}
+
+
+static void
+AddQuadric( Quadric &q, const Quadric &r )
+{
+	q.A2 += r.A2;	q.AB += r.AB;	q.AC += r.AC;	q.AD += r.AD;
+	q.B2 += r.B2;	q.BC += r.BC;	q.BD += r.BD;
+	q.C2 += r.C2;	q.CD += r.CD;
+	q.D2 += r.D2;
+	q.W += r.W;
+}
+
+
+// average squared distance from p to the quadric's planes:
+
+static double
+QuadricError( const Quadric &q, const float p[3] )
+{
+	if( q.W <= 0. )
+		return 0.;
+
+	double x = p[0], y = p[1], z = p[2];
+	double e = q.A2*x*x + 2.*q.AB*x*y + 2.*q.AC*x*z + 2.*q.AD*x
+		 + q.B2*y*y + 2.*q.BC*y*z + 2.*q.BD*y
+		 + q.C2*z*z + 2.*q.CD*z
+		 + q.D2;
+
+	return ( e > 0. ) ? e / q.W : 0.;
+}
+
+
+static inline unsigned long long
+EdgeKey( unsigned int a, unsigned int b )
+{
+	return ( (unsigned long long)a << 32 ) | b;
+}
+
+
+// count how many triangles run along each edge, in position space and in winding order:
+
+static void
+CountHalfEdges( const std::vector<unsigned int> &indices, int numTris, const std::vector<unsigned int> &posId,
+		std::unordered_map<unsigned long long, int> &halfEdges )
+{
+	halfEdges.clear( );
+	for( int i = 0; i < 3*numTris; i++ )
+	{
+		unsigned int a = posId[ indices[i] ];
+		unsigned int b = posId[ indices[ ( i % 3 == 2 ) ? i - 2 : i + 1 ] ];
+		halfEdges[ EdgeKey( a, b ) ]++;
+	}
+}
+
+
+// does moving vertex from onto to turn any of from's other triangles over?
+
+static bool
+CollapseFlips( const ObjMesh &mesh, const std::vector<unsigned int> &indices,
+		const std::vector<int> &offsets, const std::vector<int> &adjacency, unsigned int from, unsigned int to )
+{
+	const float *pto = &mesh.Positions[ 3*to ];
+
+	for( int j = offsets[from]; j < offsets[from+1]; j++ )
+	{
+		const unsigned int *tri = &indices[ 3*adjacency[j] ];
+		if( tri[0] == to  ||  tri[1] == to  ||  tri[2] == to )
+			continue;		// this one goes away
+
+		const float *p[3], *q[3];
+		for( int k = 0; k < 3; k++ )
+		{
+			p[k] = &mesh.Positions[ 3*tri[k] ];
+			q[k] = ( tri[k] == from ) ? pto : p[k];
+		}
+
+		float e1[3], e2[3], nold[3], nnew[3];
+		for( int k = 0; k < 3; k++ )
+		{
+			e1[k] = p[1][k] - p[0][k];
+			e2[k] = p[2][k] - p[0][k];
+		}
+		CrossObj( e1, e2, nold );
+
+		for( int k = 0; k < 3; k++ )
+		{
+			e1[k] = q[1][k] - q[0][k];
+			e2[k] = q[2][k] - q[0][k];
+		}
+		CrossObj( e1, e2, nnew );
+
+		if( nold[0]*nnew[0] + nold[1]*nnew[1] + nold[2]*nnew[2] <= 0. )
+			return true;
+	}
+
+	return false;
+}
+
+
+// simplify in down to about targetTriangles, moving the surface by no more than
+// maxError times in's bounding box diagonal:
+// returns the number of triangles in out
+
+int
+SimplifyObjMesh( const ObjMesh &in, int targetTriangles, float maxError, ObjMesh &out )
+{
+	out = in;
+
+	std::vector<unsigned int> &indices = out.Indices;
+	int nv = (int)( out.Positions.size() / 3 );
+	int numTris = (int)( indices.size() / 3 );
+	if( numTris <= targetTriangles  ||  nv == 0 )
+		return numTris;
+
+	const float *pos = &out.Positions[0];
+
+
+	// vertices at the same position are one point of the surface, split by a seam:
+	// posId[v] is the first vertex at v's position, groupSize how many share it
+
+	std::vector<unsigned int> posId;
+	GetObjPositionIds( out, posId );
+
+
+	// each triangle's range, so the ranges can be counted again afterwards:
+
+	std::vector<int> triRange( numTris, 0 );
+	for( size_t r = 0; r < out.Ranges.size(); r++ )
+	{
+		for( unsigned int i = 0; i < out.Ranges[r].NumIndices / 3; i++ )
+			triRange[ out.Ranges[r].FirstIndex / 3 + i ] = (int)r;
+	}
+
+	std::vector<int> groupSize( nv, 0 );
+	for( int v = 0; v < nv; v++ )
+		groupSize[ posId[v] ]++;
+	for( int v = 0; v < nv; v++ )
+		groupSize[v] = groupSize[ posId[v] ];
+
+
+	// an edge that only one triangle (in position space) runs along is an open border:
+
+	std::unordered_map<unsigned long long, int> halfEdges;
+	CountHalfEdges( indices, numTris, posId, halfEdges );
+
+	std::vector<char> kind( nv, VERTEX_MANIFOLD );
+	std::vector<Quadric> quadrics( nv );
+	memset( &quadrics[0], 0, nv*sizeof(Quadric) );
+
+	for( int t = 0; t < numTris; t++ )
+	{
+		const unsigned int *tri = &indices[ 3*t ];
+		const float *p0 = &pos[ 3*tri[0] ], *p1 = &pos[ 3*tri[1] ], *p2 = &pos[ 3*tri[2] ];
+
+		float e1[3], e2[3], n[3];
+		for( int k = 0; k < 3; k++ )
+		{
+			e1[k] = p1[k] - p0[k];
+			e2[k] = p2[k] - p0[k];
+		}
+		CrossObj( e1, e2, n );
+		float area = 0.5f * UnitObj( n );
+		double d = -( n[0]*p0[0] + n[1]*p0[1] + n[2]*p0[2] );
+
+		for( int k = 0; k < 3; k++ )
+			AddPlaneQuadric( quadrics[ posId[ tri[k] ] ], n[0], n[1], n[2], d, area );
+
+		for( int k = 0; k < 3; k++ )
+		{
+			unsigned int a = posId[ tri[k] ];
+			unsigned int b = posId[ tri[ (k+1) % 3 ] ];
+
+			if( halfEdges[ EdgeKey( a, b ) ] > 1 )
+			{
+				kind[a] = kind[b] = VERTEX_LOCKED;		// non-manifold: leave it alone
+				continue;
+			}
+
+			if( halfEdges.find( EdgeKey( b, a ) ) != halfEdges.end() )
+				continue;
+
+			// keep the outline where it is with a plane through the edge, square to the triangle:
+
+			if( kind[a] == VERTEX_MANIFOLD )	kind[a] = VERTEX_BORDER;
+			if( kind[b] == VERTEX_MANIFOLD )	kind[b] = VERTEX_BORDER;
+
+			const float *pa = &pos[ 3*a ], *pb = &pos[ 3*b ];
+			float edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+			float length = UnitObj( edge );
+			float en[3];
+			CrossObj( edge, n, en );
+			UnitObj( en );
+			double ed = -( en[0]*pa[0] + en[1]*pa[1] + en[2]*pa[2] );
+
+			AddPlaneQuadric( quadrics[a], en[0], en[1], en[2], ed, BORDERWEIGHT*length*length );
+			AddPlaneQuadric( quadrics[b], en[0], en[1], en[2], ed, BORDERWEIGHT*length*length );
+		}
+	}
+
+	for( int v = 0; v < nv; v++ )
+	{
+		if( groupSize[v] > 1 )
+			kind[v] = VERTEX_LOCKED;
+	}
+
+	float diag[3] = { in.Max[0] - in.Min[0], in.Max[1] - in.Min[1], in.Max[2] - in.Min[2] };
+	double limit = maxError * sqrt( diag[0]*diag[0] + diag[1]*diag[1] + diag[2]*diag[2] );
+	double limit2 = limit * limit;
+
+
+	// collapse in passes: in each pass, take the cheapest collapses whose neighbourhoods don't overlap
+
+	std::vector<int> offsets( nv + 1 );
+	std::vector<int> adjacency;
+	std::vector<unsigned int> collapseTo( nv );
+	std::vector<char> touched( nv );
+	std::vector<Collapse> candidates;
+
+	for( int pass = 0; numTris > targetTriangles; pass++ )
+	{
+		// the collapses so far have made new edges, which the border test below has to know about:
+
+		if( pass > 0 )
+		{
+			CountHalfEdges( indices, numTris, posId, halfEdges );
+			for( int i = 0; i < 3*numTris; i++ )
+			{
+				unsigned int a = posId[ indices[i] ];
+				unsigned int b = posId[ indices[ ( i % 3 == 2 ) ? i - 2 : i + 1 ] ];
+				if( halfEdges.find( EdgeKey( b, a ) ) != halfEdges.end() )
+					continue;
+				if( kind[a] == VERTEX_MANIFOLD )	kind[a] = VERTEX_BORDER;
+				if( kind[b] == VERTEX_MANIFOLD )	kind[b] = VERTEX_BORDER;
+			}
+		}
+
+		std::fill( offsets.begin(), offsets.end(), 0 );
+		for( int i = 0; i < 3*numTris; i++ )
+			offsets[ indices[i] + 1 ]++;
+		for( int v = 0; v < nv; v++ )
+			offsets[v+1] += offsets[v];
+
+		adjacency.resize( 3*numTris );
+		std::vector<int> filled( offsets.begin(), offsets.end() - 1 );
+		for( int i = 0; i < 3*numTris; i++ )
+			adjacency[ filled[ indices[i] ]++ ] = i / 3;
+
+		candidates.clear( );
+		for( int i = 0; i < 3*numTris; i++ )
+		{
+			unsigned int a = indices[i];
+			unsigned int b = indices[ ( i % 3 == 2 ) ? i - 2 : i + 1 ];
+
+			for( int dir = 0; dir < 2; dir++ )
+			{
+				unsigned int from = dir ? b : a;
+				unsigned int to   = dir ? a : b;
+
+				if( kind[from] == VERTEX_LOCKED )
+					continue;
+
+				if( kind[from] == VERTEX_BORDER  &&
+				    halfEdges.find( EdgeKey( posId[to], from ) ) != halfEdges.end()  &&
+				    halfEdges.find( EdgeKey( from, posId[to] ) ) != halfEdges.end() )
+					continue;	// that would pull the border inwards
+
+				Collapse c;
+				c.From = from;
+				c.To = to;
+				c.Error = QuadricError( quadrics[from], &pos[ 3*to ] );
+				candidates.push_back( c );
+			}
+		}
+
+		std::sort( candidates.begin(), candidates.end() );
+
+		for( int v = 0; v < nv; v++ )
+			collapseTo[v] = v;
+		std::fill( touched.begin(), touched.end(), 0 );
+
+		int toRemove = numTris - targetTriangles;
+		int removed = 0;
+		int collapsed = 0;
+		for( size_t c = 0; c < candidates.size()  &&  removed < toRemove; c++ )
+		{
+			unsigned int from = candidates[c].From;
+			unsigned int to = candidates[c].To;
+
+			if( candidates[c].Error > limit2 )
+				break;
+
+			if( touched[from]  ||  touched[to] )
+				continue;
+
+			if( CollapseFlips( out, indices, offsets, adjacency, from, to ) )
+				continue;
+
+			collapseTo[from] = to;
+			AddQuadric( quadrics[ posId[to] ], quadrics[from] );
+			collapsed++;
+
+			// nothing around from may change again this pass, or the flip test above would be stale:
+
+			for( int j = offsets[from]; j < offsets[from+1]; j++ )
+			{
+				const unsigned int *tri = &indices[ 3*adjacency[j] ];
+				touched[ tri[0] ] = touched[ tri[1] ] = touched[ tri[2] ] = 1;
+				if( tri[0] == to  ||  tri[1] == to  ||  tri[2] == to )
+					removed++;
+			}
+		}
+
+		if( collapsed == 0 )
+			break;
+
+		// apply the collapses and drop the triangles that have become slivers:
+
+		int n = 0;
+		for( int t = 0; t < numTris; t++ )
+		{
+			unsigned int a = collapseTo[ indices[3*t+0] ];
+			unsigned int b = collapseTo[ indices[3*t+1] ];
+			unsigned int c = collapseTo[ indices[3*t+2] ];
+			if( posId[a] == posId[b]  ||  posId[b] == posId[c]  ||  posId[c] == posId[a] )
+				continue;
+
+			indices[3*n+0] = a;
+			indices[3*n+1] = b;
+			indices[3*n+2] = c;
+			triRange[n] = triRange[t];
+			n++;
+		}
+		numTris = n;
+		indices.resize( 3*numTris );
+		triRange.resize( numTris );
+	}
+
+	// the survivors are still in range order, so only the counts have changed:
+
+	if( ! out.Ranges.empty() )
+	{
+		std::vector<ObjRange> ranges;
+		for( int t = 0; t < numTris; t++ )
+		{
+			if( ranges.empty()  ||  ranges.back().Material != out.Ranges[ triRange[t] ].Material )
+			{
+				ObjRange r = out.Ranges[ triRange[t] ];
+				r.FirstIndex = 3*t;
+				r.NumIndices = 0;
+				ranges.push_back( r );
+			}
+			ranges.back().NumIndices += 3;
+		}
+		out.Ranges.swap( ranges );
+	}
+
+	OptimizeVertexCache( out );
+	OptimizeVertexFetch( out );
+	return numTris;
+}
+
+
+// each level aims at half the triangles of the last;
+// its error limit doubles too, since SelectObjLod( ) uses it at half the screen size
+// (the chain ends early if a level comes out no smaller than the one before it)
+
+void
+BuildObjLods( const ObjMesh &mesh, vector<ObjMesh> &lods )
+{
+	lods.clear( );
+	lods.reserve( OBJLODLEVELS - 1 );
+
+	float maxError = OBJLODMAXERROR;
+	for( int i = 0; i < OBJLODLEVELS - 1; i++ )
+	{
+		const ObjMesh &src = ( i == 0 ) ? mesh : lods[i-1];
+		ObjMesh lod;
+		if( SimplifyObjMesh( src, (int)( src.Indices.size() / 6 ), maxError, lod ) >= (int)( src.Indices.size() / 3 ) )
+			break;
+		lods.push_back( std::move( lod ) );
+		maxError *= 2.f;
+	}
+}
+
+
+// radius of a sphere around the mesh's own origin that holds all of it:
+
+float
+ObjMeshRadius( const ObjMesh &mesh )
+{
+	float r2 = 0.;
+	for( size_t i = 0; i < mesh.Positions.size(); i += 3 )
+	{
+		const float *p = &mesh.Positions[i];
+		float d2 = p[0]*p[0] + p[1]*p[1] + p[2]*p[2];
+		if( d2 > r2 )
+			r2 = d2;
+	}
+
+	return sqrtf( r2 );
+}
+
+
+// which level to draw an object of this radius (in its own coordinates) at,
+// given where the current modelview matrix puts its origin:
+
+int
+SelectObjLod( float radius, int numLevels )
+{
+	GLfloat modelview[16], projection[16];
+	GLint viewport[4];
+	glGetFloatv( GL_MODELVIEW_MATRIX, modelview );
+	glGetFloatv( GL_PROJECTION_MATRIX, projection );
+	glGetIntegerv( GL_VIEWPORT, viewport );
+
+	// the modelview's translation is the origin in eye coordinates, the length of its first column the scale;
+	// w is the eye distance in a perspective projection, and 1 in an orthographic one:
+
+	float scale = sqrtf( modelview[0]*modelview[0] + modelview[1]*modelview[1] + modelview[2]*modelview[2] );
+	float w = projection[11]*modelview[14] + projection[15];
+	if( w <= 0. )
+		return 0;
+
+	float pixels = radius * scale * projection[5] * (float)viewport[3] / w;
+
+	int level = 0;
+	while( level < numLevels - 1  &&  pixels < OBJLODPIXELS )
+	{
+		pixels *= 2.f;
+		level++;
+	}
+
+	return level;
+}
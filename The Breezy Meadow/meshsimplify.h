@@ -0,0 +1,43 @@
+/*****************************************************************
+* Description: Quadric error mesh simplification and level of
+*              detail selection for ObjMeshes.
+*
+*              SimplifyObjMesh() removes triangles by collapsing edges
+*              (one vertex is moved onto a neighbour) in order of the
+*              Garland-Heckbert quadric error, until the triangle count
+*              reaches the target or the next collapse would move the
+*              surface by more than maxError (a fraction of the mesh's
+*              size). Vertices are never moved off their neighbours, so
+*              the kept vertices' texture coordinates and normals stay
+*              valid; vertices on a texture or normal seam are never
+*              collapsed, and open borders only collapse along
+*              themselves, so seams and outlines stay intact.
+*
+*              BuildObjLods() makes a chain of up to OBJLODLEVELS-1
+*              meshes, each with about half the triangles of the one
+*              before (level 0 is the mesh itself). It stops early once
+*              the error limit keeps a level from losing any
+*              triangles, so a mesh can have fewer levels.
+*
+*              SelectObjLod() picks the level to draw for an object of
+*              the given radius, from how large it currently projects
+*              on the screen under the GL modelview and projection
+*              matrices.
+*/
+
+#pragma once
+#ifndef MESHSIMPLIFY_H
+#define MESHSIMPLIFY_H
+
+#include "loadobjfile.h"
+
+#define OBJLODLEVELS		4		// full resolution plus three simplified levels
+#define OBJLODMAXERROR		0.02f		// largest error allowed, as a fraction of the bounding box diagonal
+#define OBJLODPIXELS		160.f		// projected diameter, in pixels, below which level 1 is used
+
+void	BuildObjLods( const ObjMesh &, vector<ObjMesh> & );
+float	ObjMeshRadius( const ObjMesh & );
+int	SelectObjLod( float, int );
+int	SimplifyObjMesh( const ObjMesh &, int, float, ObjMesh & );
+
+#endif
@@ -0,0 +1,52 @@
+/*****************************************************************
+* Description: Builds and uploads mipmap chains for RGB textures.
+*
+*              BuildMipChain() makes every level below a texture's
+*              full-size image, each from the one above it, down to
+*              1x1. The filtering is done in linear light (the texels
+*              are taken to be sRGB) and is separable: a vertical pass
+*              over whole rows, four floats at a time with SSE2, then
+*              a horizontal pass. Each level is split into bands of
+*              output rows that are filtered in parallel.
+*
+*              The filters:
+*                  MIPBOX     - the average of each 2x2 block
+*                  MIPKAISER  - Kaiser-windowed sinc, 3 texels wide
+*                  MIPLANCZOS - Lanczos-3 windowed sinc
+*              The windowed sincs stay sharper as the levels get
+*              smaller; their ringing is clamped away at the end.
+*
+*              UploadMipChain() sends the full-size image and its
+*              chain to the bound GL_TEXTURE_2D and switches it to
+*              trilinear minification.
+*
+*              Nothing here but UploadMipChain() calls OpenGL, so the
+*              chains can be built on the asset-loading threads.
+*/
+
+#pragma once
+#ifndef MIPMAPS_H
+#define MIPMAPS_H
+
+#include "glew.h"
+#include <GL/gl.h>
+
+#include <vector>
+
+#define MIPBOX			0
+#define MIPKAISER		1
+#define MIPLANCZOS		2
+
+#define MIPBANDROWS		16		// output rows filtered by each parallel job
+
+struct MipLevel
+{
+	int				Width, Height;
+	std::vector<unsigned char>	Texels;		// RGB, bottom row first, rows not padded
+};
+
+void	BenchmarkMipChain( const char *, const unsigned char *, int, int );
+void	BuildMipChain( const unsigned char *, int, int, int, std::vector<MipLevel> & );
+void	UploadMipChain( const unsigned char *, int, int, const std::vector<MipLevel> & );
+
+#endif
@@ -0,0 +1,200 @@
+#include "packedmesh.h"
+
+#include <stddef.h>
+
+
+#define BUFFER_OFFSET(n)	( (const GLvoid *)(size_t)(n) )
+
+
+// find the offset and scale that map [lo,hi] onto the full range of a short:
+
+static void
+GetQuantization( float lo, float hi, float *offset, float *scale )
+{
+	*scale = ( hi > lo ) ? ( hi - lo ) / 65535.f : 0.f;
+	*offset = lo + 32768.f * *scale;
+}
+
+
+static short
+Quantize( float x, float offset, float scale )
+{
+	if( scale == 0. )
+		return 0;
+
+	float q = floorf( ( x - offset ) / scale + 0.5f );
+	if( q < -32768.f )	q = -32768.f;
+	if( q >  32767.f )	q =  32767.f;
+	return (short)q;
+}
+
+
+static short
+SnormShort( float x )
+{
+	if( x < -1.f )	x = -1.f;
+	if( x >  1.f )	x =  1.f;
+	return (short)floorf( x * 32767.f + 0.5f );
+}
+
+
+// project a unit normal onto the octahedron |x|+|y|+|z| = 1 and unfold the lower half over the upper:
+
+static void
+OctEncode( const float n[3], short out[2] )
+{
+	float sum = fabsf( n[0] ) + fabsf( n[1] ) + fabsf( n[2] );
+	float x = ( sum > 0.f ) ? n[0] / sum : 0.f;
+	float y = ( sum > 0.f ) ? n[1] / sum : 0.f;
+
+	if( n[2] < 0.f )
+	{
+		float ox = ( 1.f - fabsf( y ) ) * ( x >= 0.f ? 1.f : -1.f );
+		float oy = ( 1.f - fabsf( x ) ) * ( y >= 0.f ? 1.f : -1.f );
+		x = ox;
+		y = oy;
+	}
+
+	out[0] = SnormShort( x );
+	out[1] = SnormShort( y );
+}
+
+
+// quantize mesh into packed:
+
+void
+PackObjMesh( const ObjMesh &mesh, PackedMesh &packed )
+{
+	int nv = (int)( mesh.Positions.size() / 3 );
+
+	float lo[3] = { 0., 0., 0. }, hi[3] = { 0., 0., 0. };
+	float tlo[2] = { 0., 0. }, thi[2] = { 0., 0. };
+	for( int v = 0; v < nv; v++ )
+	{
+		const float *p = &mesh.Positions[ 3*v ];
+		const float *t = &mesh.TexCoords[ 2*v ];
+		for( int k = 0; k < 3; k++ )
+		{
+			if( v == 0  ||  p[k] < lo[k] )	lo[k] = p[k];
+			if( v == 0  ||  p[k] > hi[k] )	hi[k] = p[k];
+		}
+		for( int k = 0; k < 2; k++ )
+		{
+			if( v == 0  ||  t[k] < tlo[k] )	tlo[k] = t[k];
+			if( v == 0  ||  t[k] > thi[k] )	thi[k] = t[k];
+		}
+	}
+
+	for( int k = 0; k < 3; k++ )
+		GetQuantization( lo[k], hi[k], &packed.PosOffset[k], &packed.PosScale[k] );
+	for( int k = 0; k < 2; k++ )
+		GetQuantization( tlo[k], thi[k], &packed.TexOffset[k], &packed.TexScale[k] );
+
+	packed.Vertices.resize( nv );
+	for( int v = 0; v < nv; v++ )
+	{
+		PackedVertex &pv = packed.Vertices[v];
+		for( int k = 0; k < 3; k++ )
+			pv.Position[k] = Quantize( mesh.Positions[ 3*v+k ], packed.PosOffset[k], packed.PosScale[k] );
+		pv.Position[3] = 0;
+
+		OctEncode( &mesh.Normals[ 3*v ], pv.Normal );
+
+		for( int k = 0; k < 2; k++ )
+			pv.TexCoord[k] = Quantize( mesh.TexCoords[ 2*v+k ], packed.TexOffset[k], packed.TexScale[k] );
+	}
+
+	packed.Indices = mesh.Indices;
+	packed.NumIndices = (int)mesh.Indices.size();
+	packed.VertexBuffer = packed.IndexBuffer = 0;
+	packed.IndexType = ( nv <= 65536 ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+
+// copy the packed arrays into gpu buffers and free the cpu copies:
+
+void
+UploadPackedMesh( PackedMesh &packed )
+{
+	if( packed.Vertices.size() == 0  ||  packed.Indices.size() == 0 )
+		return;
+
+	glGenBuffers( 1, &packed.VertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, packed.VertexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, packed.Vertices.size()*sizeof(PackedVertex), &packed.Vertices[0], GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	glGenBuffers( 1, &packed.IndexBuffer );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, packed.IndexBuffer );
+	if( packed.IndexType == GL_UNSIGNED_SHORT )
+	{
+		std::vector<unsigned short> indices16( packed.Indices.begin(), packed.Indices.end() );
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices16.size()*sizeof(unsigned short), &indices16[0], GL_STATIC_DRAW );
+	}
+	else
+	{
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, packed.Indices.size()*sizeof(unsigned int), &packed.Indices[0], GL_STATIC_DRAW );
+	}
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+	std::vector<PackedVertex>().swap( packed.Vertices );
+	std::vector<unsigned int>().swap( packed.Indices );
+}
+
+
+void
+DeletePackedMesh( PackedMesh &packed )
+{
+	if( packed.VertexBuffer != 0 )
+		glDeleteBuffers( 1, &packed.VertexBuffer );
+	if( packed.IndexBuffer != 0 )
+		glDeleteBuffers( 1, &packed.IndexBuffer );
+
+	packed.VertexBuffer = packed.IndexBuffer = 0;
+	packed.NumIndices = 0;
+}
+
+
+// draw an uploaded packed mesh with the current shader program, which must understand uPacked:
+
+void
+DrawPackedMesh( const PackedMesh &packed )
+{
+	if( packed.VertexBuffer == 0 )
+		return;
+
+	GLint program = 0;
+	glGetIntegerv( GL_CURRENT_PROGRAM, &program );
+	if( program == 0 )
+		return;
+
+	glUniform1i( glGetUniformLocation( program, "uPacked" ), 1 );
+	glUniform3f( glGetUniformLocation( program, "uPosOffset" ), packed.PosOffset[0], packed.PosOffset[1], packed.PosOffset[2] );
+	glUniform3f( glGetUniformLocation( program, "uPosScale" ), packed.PosScale[0], packed.PosScale[1], packed.PosScale[2] );
+	glUniform2f( glGetUniformLocation( program, "uTexOffset" ), packed.TexOffset[0], packed.TexOffset[1] );
+	glUniform2f( glGetUniformLocation( program, "uTexScale" ), packed.TexScale[0], packed.TexScale[1] );
+
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+	glBindBuffer( GL_ARRAY_BUFFER, packed.VertexBuffer );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_SHORT, sizeof(PackedVertex), BUFFER_OFFSET( offsetof( PackedVertex, Position ) ) );
+
+	glClientActiveTexture( GL_TEXTURE0 );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 2, GL_SHORT, sizeof(PackedVertex), BUFFER_OFFSET( offsetof( PackedVertex, TexCoord ) ) );
+
+	glClientActiveTexture( GL_TEXTURE1 );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 2, GL_SHORT, sizeof(PackedVertex), BUFFER_OFFSET( offsetof( PackedVertex, Normal ) ) );
+	glClientActiveTexture( GL_TEXTURE0 );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, packed.IndexBuffer );
+	glDrawElements( GL_TRIANGLES, packed.NumIndices, packed.IndexType, BUFFER_OFFSET( 0 ) );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glPopClientAttrib( );
+
+	glUniform1i( glGetUniformLocation( program, "uPacked" ), 0 );
+}
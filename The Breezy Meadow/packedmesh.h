@@ -0,0 +1,48 @@
+/*****************************************************************
+* Description: Quantized vertex layout for uploading ObjMeshes
+*              to the gpu at half the size.
+*
+*              Each PackedVertex is 16 bytes instead of 32:
+*                  positions  - 3 x 16-bit, relative to the mesh's
+*                               bounding box
+*                  normals    - 2 x 16-bit octahedral encoding
+*                  texcoords  - 2 x 16-bit, relative to the mesh's
+*                               texture coordinate range
+*
+*              They are fed through the ordinary vertex, texcoord 0
+*              and texcoord 1 arrays as raw shorts, and pattern.vert
+*              turns them back into floats when uPacked is set, using
+*              the offsets and scales DrawPackedMesh() passes in.
+*/
+
+#pragma once
+#ifndef PACKEDMESH_H
+#define PACKEDMESH_H
+
+#include "loadobjfile.h"
+
+struct PackedVertex
+{
+	short	Position[4];		// [3] is padding, to keep the vertex 4-byte aligned
+	short	Normal[2];
+	short	TexCoord[2];
+};
+
+struct PackedMesh
+{
+	vector<PackedVertex>	Vertices;	// freed once the mesh is uploaded
+	vector<unsigned int>	Indices;
+	float			PosOffset[3], PosScale[3];	// position = PosOffset + short * PosScale
+	float			TexOffset[2], TexScale[2];
+	GLuint			VertexBuffer;
+	GLuint			IndexBuffer;
+	GLenum			IndexType;
+	int			NumIndices;
+};
+
+void	DeletePackedMesh( PackedMesh & );
+void	DrawPackedMesh( const PackedMesh & );
+void	PackObjMesh( const ObjMesh &, PackedMesh & );
+void	UploadPackedMesh( PackedMesh & );
+
+#endif
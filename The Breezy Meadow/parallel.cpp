@@ -0,0 +1,176 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// one ParallelFor( ) call, shared by the thread that made it and the pool threads helping out:
+
+struct ParallelJob
+{
+	const std::function<void(int)> *	Fn;
+	int					Count;
+	int					MaxThreads;	// how many threads may work on it, its caller included
+	std::atomic<int>			Next;		// the next index nobody has claimed
+	int					Threads;	// how many are working on it, guarded by the pool's Lock
+	int					Done;		// how many of its calls have finished, guarded by the pool's Lock
+};
+
+struct WorkerPool
+{
+	std::mutex			Lock;
+	std::condition_variable		Work;		// signalled when a job is queued
+	std::condition_variable		Finished;	// signalled when a pool thread leaves a job
+	std::deque<ParallelJob *>	Jobs;		// jobs that may still have unclaimed indices
+};
+
+// the pool is never freed, so its threads can never be left waiting on a destroyed lock at exit:
+
+static WorkerPool *		Pool = NULL;
+static std::once_flag		PoolStarted;
+
+// set on the pool threads, and on any thread while it is inside a ParallelFor( )'s fn:
+
+static thread_local bool	InParallelFor = false;
+
+
+// number of threads to use for parallel work (at least 1):
+
+int
+NumWorkerThreads( )
+{
+	int n = (int)std::thread::hardware_concurrency( );
+	return ( n > 0 ) ? n : 1;
+}
+
+
+// claim and run indices of a job until there are none left:
+// returns how many were run
+
+static int
+RunJob( ParallelJob &job )
+{
+	bool wasInside = InParallelFor;
+	InParallelFor = true;
+
+	int ran = 0;
+	for( int i = job.Next++; i < job.Count; i = job.Next++ )
+	{
+		( *job.Fn )( i );
+		ran++;
+	}
+
+	InParallelFor = wasInside;
+	return ran;
+}
+
+
+// with the pool locked: the oldest job that still has indices to claim and room for another thread,
+// dropping the jobs that are all claimed
+
+static ParallelJob *
+FindJob( )
+{
+	while( ! Pool->Jobs.empty( )  &&  Pool->Jobs.front()->Next >= Pool->Jobs.front()->Count )
+		Pool->Jobs.pop_front( );
+
+	for( size_t i = 0; i < Pool->Jobs.size(); i++ )
+	{
+		ParallelJob *job = Pool->Jobs[i];
+		if( job->Next < job->Count  &&  job->Threads < job->MaxThreads )
+			return job;
+	}
+	return NULL;
+}
+
+
+static void
+PoolThread( )
+{
+	InParallelFor = true;
+
+	std::unique_lock<std::mutex> lock( Pool->Lock );
+	for( ; ; )
+	{
+		ParallelJob *job;
+		Pool->Work.wait( lock, [&]( ) { return ( job = FindJob( ) ) != NULL; } );
+		job->Threads++;
+
+		lock.unlock( );
+		int ran = RunJob( *job );
+		lock.lock( );
+
+		// the job's caller may return as soon as this is done, so don't touch job after it:
+
+		job->Threads--;
+		job->Done += ran;
+		Pool->Finished.notify_all( );
+	}
+}
+
+
+static void
+StartPool( )
+{
+	Pool = new WorkerPool;
+	for( int t = 1; t < NumWorkerThreads( ); t++ )
+		std::thread( PoolThread ).detach( );
+}
+
+
+void
+ParallelFor( int count, const std::function<void(int)> &fn, int maxThreads )
+{
+	if( count <= 0 )
+		return;
+
+	int numThreads = NumWorkerThreads( );
+	if( maxThreads > 0  &&  maxThreads < numThreads )
+		numThreads = maxThreads;
+	if( numThreads > count )
+		numThreads = count;
+
+	if( numThreads == 1  ||  InParallelFor )
+	{
+		for( int i = 0; i < count; i++ )
+			fn( i );
+		return;
+	}
+
+	std::call_once( PoolStarted, StartPool );
+
+	ParallelJob job;
+	job.Fn = &fn;
+	job.Count = count;
+	job.MaxThreads = numThreads;
+	job.Next = 0;
+	job.Threads = 1;
+	job.Done = 0;
+
+	{
+		std::lock_guard<std::mutex> lock( Pool->Lock );
+		Pool->Jobs.push_back( &job );
+	}
+	Pool->Work.notify_all( );
+
+	// every thread on the job pulls the next unclaimed index until they are all gone:
+
+	int ran = RunJob( job );
+
+	std::unique_lock<std::mutex> lock( Pool->Lock );
+	for( size_t i = 0; i < Pool->Jobs.size(); i++ )
+	{
+		if( Pool->Jobs[i] == &job )
+		{
+			Pool->Jobs.erase( Pool->Jobs.begin() + i );
+			break;
+		}
+	}
+	job.Threads--;
+	job.Done += ran;
+	Pool->Finished.wait( lock, [&]( ) { return job.Done == job.Count  &&  job.Threads == 0; } );
+}
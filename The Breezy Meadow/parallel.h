@@ -0,0 +1,29 @@
+/*****************************************************************
+* Description: Small helpers for spreading load-time work across
+*              the cpu cores.
+*
+*              ParallelFor( n, fn ) calls fn( 0 ) ... fn( n-1 ), each
+*              exactly once, on up to NumWorkerThreads( ) threads
+*              (the calling thread is one of them) and returns when
+*              all of the calls have finished. An optional third
+*              argument caps the number of threads lower still.
+*
+*              The threads come from one pool, started the first
+*              time it is needed and kept for the life of the
+*              program, so a ParallelFor( ) costs no thread creation.
+*              Several threads may run a ParallelFor( ) at once; they
+*              share the pool. A ParallelFor( ) made from inside
+*              another one's fn runs serially on the thread that made
+*              it, since the outer one already has the cores busy.
+*/
+
+#pragma once
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+int	NumWorkerThreads( );
+void	ParallelFor( int, const std::function<void(int)> &, int = 0 );
+
+#endif
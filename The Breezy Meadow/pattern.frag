@@ -6,6 +6,9 @@ uniform vec3  objectColor;		// object color
 uniform int objectId;			// Id of object being rendered
 
 uniform sampler2D uTexUnit;
+uniform sampler2DArray uTexArray;	// the texture array the object's texture is a layer of
+uniform bool uUseTexArray;		// take the texture from layer uTexLayer of uTexArray instead of uTexUnit
+uniform int uTexLayer;
 
 in  vec2  vST;			// texture coords
 in  vec3  vN;			// normal vector
@@ -87,7 +90,11 @@ main( )
 
 	vec3 totalLight = min(unitVec, combinedLight);
 	
-	vec3 newcolor = texture( uTexUnit, vST ).rgb;
+	vec3 newcolor;
+	if( uUseTexArray )
+		newcolor = texture( uTexArray, vec3( vST, float(uTexLayer) ) ).rgb;
+	else
+		newcolor = texture( uTexUnit, vST ).rgb;
 	gl_FragColor = vec4( newcolor*(totalLight), 1. );
 	
 }
\ No newline at end of file
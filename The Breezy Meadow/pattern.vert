@@ -26,6 +26,14 @@ uniform float flowerDamp; // each flower damps at a different rate
 uniform float oscRate; // each flower damps at a different rate
 uniform float omegaf; // the amount each flower oscillates by
 uniform float tdelay; // the amount each flower oscillates by
+
+// vertices in the quantized PackedVertex layout (packedmesh.h) arrive as raw shorts:
+// position in gl_Vertex, texture coords in gl_MultiTexCoord0, octahedral normal in gl_MultiTexCoord1
+uniform bool uPacked;
+uniform vec3 uPosOffset;  // position = uPosOffset + short * uPosScale
+uniform vec3 uPosScale;
+uniform vec2 uTexOffset;  // texture coords the same way
+uniform vec2 uTexScale;
  
 float ampV = 0.8; // amplitude for wind blasts --- verify don't need
 float damp = 1.0f; // 1.5f; // vibration damping
@@ -123,12 +131,33 @@ float zVibration( float z, float st)
 
 
 
+// Undo the octahedral normal encoding: the lower half of the octahedron was folded over the upper
+vec3 OctDecode( vec2 e )
+{
+	vec3 n = vec3( e.xy, 1. - abs(e.x) - abs(e.y) );
+	if (n.z < 0.){
+		vec2 s = vec2( n.x >= 0. ? 1. : -1., n.y >= 0. ? 1. : -1. );
+		n.xy = ( 1. - abs(n.yx) ) * s;
+	}
+	return normalize( n );
+}
+
 void main( )
 { 
-	vST = gl_MultiTexCoord0.st;
-	vec3 vert = gl_Vertex.xyz;
+	vec3 vert;
+	vec3 normal;
+	if (uPacked){
+		vST = uTexOffset + gl_MultiTexCoord0.st * uTexScale;
+		vert = uPosOffset + gl_Vertex.xyz * uPosScale;
+		normal = OctDecode( gl_MultiTexCoord1.st / 32767. );
+	}
+	else{
+		vST = gl_MultiTexCoord0.st;
+		vert = gl_Vertex.xyz;
+		normal = gl_Normal;
+	}
 	vec4 ECposition = gl_ModelViewMatrix * vec4( vert, 1. );
-	vN = normalize( gl_NormalMatrix * gl_Normal );	// normal vector
+	vN = normalize( gl_NormalMatrix * normal );	// normal vector
 	vL = LightPosition - ECposition.xyz;		// vector from the point
 							// to the light position
 	vL2 = LightPosition2 - ECposition.xyz;
@@ -7,6 +7,10 @@
 * 
 *              To start the wind breezes press the "w" key
 *              To drop the apple press the "a" key 
+*
+*              To stream in another (possibly huge) obj file, give its name on
+*              the command line -- it shows up in the middle of the meadow,
+*              growing as it arrives
 * 
 */
 
@@ -15,6 +19,8 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <time.h>
+#include <chrono>
+#include <thread>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -37,8 +43,23 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "blockcompress.h"
+#include "bmptexture.h"
 #include "glslprogram.h"
 #include "loadobjfile.h"
+#include "meshbvh.h"
+#include "meshcache.h"
+#include "meshlets.h"
+#include "meshpack.h"
+#include "meshregistry.h"
+#include "meshsimplify.h"
+#include "mipmaps.h"
+#include "packedmesh.h"
+#include "parallel.h"
+#include "texcache.h"
+#include "texturemanager.h"
+#include "texturepipeline.h"
+#include "uploadring.h"
 
 
 
@@ -200,6 +221,63 @@ const GLfloat FOGEND      = { 4. };
 
 //#define ENABLE_SHADOWS
 
+// should we time the asset loaders on the meadow's files at startup?
+// (results go to stderr)
+
+//#define BENCHMARK_LOADERS
+
+// should we time ray queries against the meadow's meshes at startup?
+// (results go to stderr)
+
+//#define BENCHMARK_RAYS
+
+// should the flowers be drawn from quantized, half-size vertex buffers
+// instead of full-float display lists?
+
+#define PACKED_VERTICES
+
+// should the grass and the tree trunk be drawn in meshlets, skipping
+// the ones the camera can't see?
+
+#define CULL_MESHLETS
+
+// how the textures' mipmap chains are filtered (MIPBOX, MIPKAISER or MIPLANCZOS):
+
+#define MIPMAP_FILTER	MIPKAISER
+
+// should the textures go to the gpu block-compressed (BC1), and how hard should
+// the encoder try (BCFAST or BCQUALITY)?
+
+#define COMPRESS_TEXTURES	BCFAST
+
+#ifdef COMPRESS_TEXTURES
+#define TEXTURE_ENCODING	COMPRESS_TEXTURES
+#else
+#define TEXTURE_ENCODING	TEXCACHE_UNCOMPRESSED
+#endif
+
+// should the textures go into the layers of texture arrays, one for each size, so that
+// switching objects only changes uniforms and never a texture binding?
+// (the arrays are bound to units TEXTUREARRAY_UNIT, TEXTUREARRAY_UNIT+1, ...)
+
+#define TEXTURE_ARRAY
+
+#define TEXTUREARRAY_UNIT	11
+
+// how much gpu memory the textures may take (0 for no limit), and how many frames one
+// has to go undrawn before it can be evicted to stay within that (with TEXTURE_ARRAY,
+// a whole array goes once all of its layers have):
+
+#define TEXTURE_BUDGET_MB	32
+#define TEXTURE_IDLE_FRAMES	300
+
+// how many persistently mapped pixel buffers the texture uploads are staged through
+// (0 to upload straight from client memory), and how big each one is - big enough
+// for a whole 1024x1024 RGB mipmap chain (they are freed once every texture is up):
+
+#define TEXTURE_PBO_SLOTS	3
+#define TEXTURE_PBO_SLOT_MB	6
+
 
 
 // non-constant global variables:
@@ -234,24 +312,34 @@ void	DoDebugMenu( int );
 void	DoMainMenu( int );
 void	DoProjectMenu( int );
 void	DoShadowMenu();
+void	DrawButterfly( GLuint, const SharedMesh *, glm::vec3, float );
+void	DrawFlower( GLuint, int, float );
+void	DrawMeshLod( int, int );
+const ObjMesh &	GetMeshLod( int, int );
+int	GetNumMeshLods( int );
 void	DoRasterString( float, float, float, char * );
 void	DoStrokeString( float, float, float, float, char * );
 float	ElapsedSeconds( );
+void	FinishLoadingAssets( );
+void	FinishLoadingTextures( );
+glm::mat4	GetAppleMatrix( );
+void	GetGrassHill( ObjMesh & );
+glm::mat4	GetGrassMatrix( );
 void	InitGraphics( );
 void	InitLists( );
 void	InitMenus( );
 void	Keyboard( unsigned char, int, int );
 void	MouseButton( int, int, int, int );
 void	MouseMotion( int, int );
+void	PickObject( int, int );
 void	Reset( );
 void	Resize( int, int );
+void	StartLoadingAssets( );
+void	UseTexture( int );
 void	Visibility( int );
 
 void			Axes( float );
-unsigned char *	BmpToTexture( char *, int *, int * );
 void			HsvRgb( float[3], float [3] );
-int				ReadInt( FILE * );
-short			ReadShort( FILE * );
 
 void			Cross(float[3], float[3], float[3]);
 float			Dot(float [3], float [3]);
@@ -324,6 +412,12 @@ bool appleRoll = false; // this flag becomes true after the apple has landed on
 glm::vec3 grassBoundary = glm::vec3(-1.3f, -0.5f, -2.0f);
 glm::vec3 treePosition = glm::vec3(grassBoundary.x, grassBoundary.y + 0.4f, 0.0f);
 glm::vec3 applePosition = glm::vec3(treePosition.x + 0.5f, 1.3f, 0.0f); 
+glm::vec3 grassScale = glm::vec3(0.01667f, 0.0133, 0.0133f); 
+float treeScale = 0.03f;
+glm::vec3 butterflyPosition = glm::vec3(1.0f, grassBoundary.y + 01.f, 0.2f);
+glm::vec3 butterflyPosition2 = glm::vec3(0.4f, grassBoundary.y + 0.8f, -0.8f);
+float butterflyScale = 0.02;
+float appleScale = 2.0f; 
 
 // display lists for the indicated object
 GLuint	grassList;				
@@ -333,13 +427,15 @@ GLuint	treeLeavesList;
 GLuint	appleList;				
 GLuint	butterflyList;			
 GLuint	butterflyList2;				
-GLuint	daisyList;				
+GLuint	daisyList;				// GetNumMeshLods( ) lists in a row, from full resolution down
 GLuint	whiteFlowerList;
 GLuint	snowdropList;
+float	daisyRadius;				// how big each flower is, for picking its level of detail
+float	whiteFlowerRadius;
+float	snowdropRadius;
 GLuint	woodList;
 
 // Textures for the indicated object
-unsigned char* Texture;
 GLuint	grassTex;
 GLuint	barkTex;
 GLuint	leafTex;
@@ -353,15 +449,108 @@ GLuint	snowdropTex;
 GLuint	woodTex;
 GLuint	uTexUnit;
 
+// every obj and bmp file the meadow is built from:
+// these are all read and decoded at the same time on worker threads, starting before
+// the window is even open, so only the GL uploads are left for InitGraphics( ) and InitLists( )
+
+enum MeshAssetIds
+{
+	GRASS_OBJ,
+	TREETRUNK_OBJ,
+	TREELEAVES_OBJ,
+	TREEFRUIT_OBJ,
+	APPLE_OBJ,
+	BUTTERFLY_OBJ,
+	DAISY_OBJ,
+	WHITEFLOWER_OBJ,
+	SNOWDROP_OBJ,
+	NUM_MESH_ASSETS
+};
+
+const char * MeshAssetFiles[ ] =
+{
+	"objects/grass.obj",
+	"objects/treeTrunk.obj",
+	"objects/treeLeaves.obj",
+	"objects/treeFruit.obj",
+	"objects/apple.obj",
+	"objects/butterfly.obj",
+	"objects/daisy.obj",
+	"objects/whiteFlower.obj",
+	"objects/snowdrop.obj"
+};
+
+enum TextureAssetIds
+{
+	GRASS_BMP,
+	BARK_BMP,
+	LEAF_BMP,
+	APPLE_BMP,
+	APPLEWHOLE_BMP,
+	YELLOWBUTTERFLY_BMP,
+	DAISY_BMP,
+	WHITEFLOWER_BMP,
+	SNOWDROP_BMP,
+	ORANGEBUTTERFLY_BMP,
+	NUM_TEXTURE_ASSETS
+};
+
+// each texture's file, wrap, magnification filter, the texture unit Display( ) binds it to, and its name:
+
+const TextureDesc TextureAssets[ ] =
+{
+	{ "textures/grassPatch.bmp",		GL_REPEAT,	GL_LINEAR,	1,	&grassTex },
+	{ "textures/bark.bmp",			GL_REPEAT,	GL_LINEAR,	2,	&barkTex },
+	{ "textures/leaf.bmp",			GL_REPEAT,	GL_LINEAR,	3,	&leafTex },
+	{ "textures/apple.bmp",			GL_REPEAT,	GL_LINEAR,	4,	&appleTex },
+	{ "textures/appleWhole.bmp",		GL_REPEAT,	GL_LINEAR,	5,	&appleWholeTex },
+	{ "textures/yellowButterfly.bmp",	GL_REPEAT,	GL_LINEAR,	6,	&butterflyTex },
+	{ "textures/daisy.bmp",			GL_REPEAT,	GL_LINEAR,	8,	&daisyTex },
+	{ "textures/whiteFlower.bmp",		GL_REPEAT,	GL_LINEAR,	9,	&whiteFlowerTex },
+	{ "textures/snowdrop.bmp",		GL_REPEAT,	GL_LINEAR,	10,	&snowdropTex },
+	{ "textures/orangeButterfly.bmp",	GL_REPEAT,	GL_LINEAR,	7,	&butterflyTex2 }
+};
+
+ObjMesh		Meshes[ NUM_MESH_ASSETS ];
+vector<ObjMesh>	MeshLods[ NUM_MESH_ASSETS ];	// simplified levels 1, 2, ... (level 0 is Meshes[ ])
+PackedMesh	PackedLods[ NUM_MESH_ASSETS ][ OBJLODLEVELS ];	// quantized copies of the flowers' levels of detail
+float		FlowerScales[ NUM_MESH_ASSETS ];	// the glScalef( ) in each flower's display list
+MeshletMesh	GrassMeshlets;			// the grass, cut up for culling
+MeshletMesh	TrunkMeshlets;			// the tree trunk, cut up for culling
+SharedMesh *	ButterflyMeshes[2];		// both references to the one gpu copy of the butterfly
+ObjBvh		GrassBvh;			// the grass, bent into the hill, for ray queries
+ObjBvh		AppleBvh;			// the apple, for picking
+float		AppleDropHeight;		// how far the apple falls before it meets the hill (0. if unknown)
+glm::mat4	SceneModelview;			// the viewing matrices from the last Display( ), for picking
+glm::mat4	SceneProjection;
+glm::vec4	SceneViewport;
+TexturePipeline	TexturePipe;			// the textures, from their files to the gpu
+TextureManager	Textures;			// the textures once they are there
+UploadRing	TextureRing;			// the pixel buffers their uploads go through
+std::thread	AssetLoader;			// reads and decodes the meshes into Meshes[ ]
+std::thread	TextureLoader;			// decodes the textures into TexturePipe and stages them
+double		AssetLoadMs;			// how long AssetLoader took
+ObjStream	StreamedMesh;			// the obj file named on the command line, if any
+
+// when main( ) started, for timing the first frame:
+
+std::chrono::steady_clock::time_point	StartTime;
+
 
 // main program:
 
 int
 main( int argc, char *argv[ ] )
 {
+	StartTime = std::chrono::steady_clock::now( );
+
 	// seed the random number generator
 	srand(time(NULL));
 
+	// start reading the obj and bmp files while the window and shaders are being set up:
+
+	StartLoadingAssets( );
+
 	// turn on the glut package:
 	// (do this before checking argc and argv since it might
 	// pull some command line arguments out)
@@ -376,6 +565,12 @@ main( int argc, char *argv[ ] )
 
 	InitLists( );
 
+	// start streaming the obj file named on the command line:
+	// Animate( ) reads a chunk of it each time the main loop is idle
+
+	if( argc > 1 )
+		StreamedMesh.Open( argv[1] );
+
 	// init all the global variables used by Display( ):
 	// this will also post a redisplay
 
@@ -421,6 +616,8 @@ Animate( )
 	                       // param > value - epsilon && param < value + epsilon
 	float timeSpan2 = 4.0f;  // how fast to drop the apple
 	float minYheight = 0.32f*timeSpan2;  // indicates when apple has reached the ground
+	if( AppleDropHeight > 0. )
+		minYheight = AppleDropHeight;  // measured against the hill by InitLists( )
 	float maxLinearDistance = 0.77f; // maximum distance apple advances
 	float timerRateWind = 6.f;  //use to control timer rate for wind
 	float timerRateWingFlap = 100.f;
@@ -531,6 +728,14 @@ Animate( )
 		currentTime6 = fabs(sinf(currentTime6)); // the timer ranges from 0 to +1 then +1 down to 0 and so on
 	}
 
+	if( StreamedMesh.IsOpen( )  &&  ! StreamedMesh.IsDone( ) )
+		StreamedMesh.Step( );
+
+	// upload whatever textures have been staged since last time, until they all are:
+
+	if( TextureLoader.joinable( )  &&  UploadPipelineTextures( TexturePipe ) )
+		FinishLoadingTextures( );
+
 	// force a call to Display( ) next time it is convenient:
 
 	glutSetWindow( MainWindow );
@@ -658,6 +863,10 @@ Display( )
 	
 	// apply the modelview matrix:
 	glMultMatrixf(glm::value_ptr(modelview));
+
+	SceneModelview = modelview;
+	SceneProjection = projection;
+	SceneViewport = glm::vec4(xl, yb, v, v);
 	
 
 	// set the fog parameters:
@@ -704,16 +913,41 @@ Display( )
 	Pattern->SetUniformVariable("appleMotion", useAnimation2);
 	Pattern->SetUniformVariable("t6", currentTime6);  
 
+	// the texture arrays, if there are any, stay bound to their units for the whole frame.
+	// Until they have been made, uTexArray still has to be on a unit of its own, since
+	// uTexUnit is left on 0 and two samplers of different types can't share a unit:
+#ifdef TEXTURE_ARRAY
+	Pattern->SetUniformVariable("uUseTexArray", 1);
+	Pattern->SetUniformVariable("uTexArray", TEXTUREARRAY_UNIT);
+#else
+	Pattern->SetUniformVariable("uUseTexArray", 0);
+#endif
+
 
 	// grass meadow
 	objectColor = glm::vec3(1.f, 1.f, 1.f);
 	Pattern->SetUniformVariable("objectColor", objectColor);
 	Pattern->SetUniformVariable("objectId", objectId[0]);
 
-	glActiveTexture(GL_TEXTURE1); // use texture unit 1
-	glBindTexture(GL_TEXTURE_2D, grassTex);
-	Pattern->SetUniformVariable("uTexUnit", 1); 
-	glCallList(grassList);
+	UseTexture(GRASS_BMP);
+	if( GrassMeshlets.VertexBuffer != 0 )
+	{
+		// the meadow is seen from below too, so only cull against the frustum:
+		glPushMatrix();
+		glTranslatef(0.f, grassBoundary.y, 0.f);
+		glRotatef(-90., 1., 0., 0.);
+		glScalef(grassScale.x, grassScale.y, grassScale.z);
+		int drawn = DrawMeshletMesh( GrassMeshlets, false );
+		glPopMatrix();
+
+		if( DebugOn != 0 )
+			fprintf( stderr, "Grass: drew %d of %d triangles in %d meshlets\n",
+				drawn, GrassMeshlets.NumTriangles, (int)GrassMeshlets.Meshlets.size() );
+	}
+	else
+	{
+		glCallList(grassList);
+	}
 	
 
 	//tree trunk and branches
@@ -721,11 +955,21 @@ Display( )
 	Pattern->SetUniformVariable("objectColor", objectColor);
 	Pattern->SetUniformVariable("objectId", objectId[1]);
 
-	glActiveTexture(GL_TEXTURE2); // use texture unit 2
-	glBindTexture(GL_TEXTURE_2D, barkTex);
-	Pattern->SetUniformVariable("uTexUnit", 2); 
+	UseTexture(BARK_BMP);
 
-	glCallList(treeTrunkList);
+	if( TrunkMeshlets.VertexBuffer != 0 )
+	{
+		glPushMatrix();
+		glTranslatef(treePosition.x, treePosition.y, treePosition.z);
+		glRotatef(-90., 1., 0., 0.);
+		glScalef(treeScale, treeScale, treeScale);
+		DrawMeshletMesh( TrunkMeshlets, true );
+		glPopMatrix();
+	}
+	else
+	{
+		glCallList(treeTrunkList);
+	}
 	
 	
 	// tree leaves
@@ -735,9 +979,7 @@ Display( )
 	Pattern->SetUniformVariable("objectColor", objectColor);
 	Pattern->SetUniformVariable("objectId", objectId[2]);
 
-	glActiveTexture(GL_TEXTURE3); // use texture unit 3
-	glBindTexture(GL_TEXTURE_2D, leafTex);
-	Pattern->SetUniformVariable("uTexUnit", 3);
+	UseTexture(LEAF_BMP);
 
 	glCallList(treeLeavesList);
 	
@@ -747,9 +989,7 @@ Display( )
 	Pattern->SetUniformVariable("objectColor", objectColor);
 	Pattern->SetUniformVariable("objectId", objectId[3]);
 
-	glActiveTexture(GL_TEXTURE4); // use texture unit 4
-	glBindTexture(GL_TEXTURE_2D, appleTex);
-	Pattern->SetUniformVariable("uTexUnit", 4);
+	UseTexture(APPLE_BMP);
 
 	glCallList(treeFruitList);
 
@@ -763,9 +1003,7 @@ Display( )
 	Pattern->SetUniformVariable("t2", currentTime2);
 	Pattern->SetUniformVariable("delta", delta);
 
-	glActiveTexture(GL_TEXTURE5); // use texture unit 5
-	glBindTexture(GL_TEXTURE_2D, appleWholeTex);
-	Pattern->SetUniformVariable("uTexUnit", 5);
+	UseTexture(APPLEWHOLE_BMP);
 
 	glCallList(appleList);
 
@@ -778,19 +1016,15 @@ Display( )
 	Pattern->SetUniformVariable("t4", currentTime4); 
 	Pattern->SetUniformVariable("t5", currentTime5);  //for zigzag motion
 	
-	glActiveTexture(GL_TEXTURE6); // use texture unit 6
-	glBindTexture(GL_TEXTURE_2D, butterflyTex);
-	Pattern->SetUniformVariable("uTexUnit", 6);
+	UseTexture(YELLOWBUTTERFLY_BMP);
 
-	glCallList(butterflyList);
+	DrawButterfly(butterflyList, ButterflyMeshes[0], butterflyPosition, 270.f);
 
 	// second butterfly 
 	Pattern->SetUniformVariable("objectId", objectId[9]);
-	glActiveTexture(GL_TEXTURE7); // use texture unit 7
-	glBindTexture(GL_TEXTURE_2D, butterflyTex2);
-	Pattern->SetUniformVariable("uTexUnit", 7);
+	UseTexture(ORANGEBUTTERFLY_BMP);
 
-	glCallList(butterflyList2);
+	DrawButterfly(butterflyList2, ButterflyMeshes[1], butterflyPosition2, 180.f);
 
 	// daisies 
 	objectColor = glm::vec3(0.79687f, 0.79687f, 0.99609); 
@@ -813,47 +1047,45 @@ Display( )
 	Pattern->SetUniformVariable("tdelay", tdelay);
 
 
-	glActiveTexture(GL_TEXTURE8); // use texture unit 8
-	glBindTexture(GL_TEXTURE_2D, daisyTex);
-	Pattern->SetUniformVariable("uTexUnit", 8);
+	UseTexture(DAISY_BMP);
 
 	glPushMatrix();
 	glTranslatef(daisyPosition.x, daisyPosition.y, daisyPosition.z);
-	glCallList(daisyList);  
+	DrawFlower(daisyList, DAISY_OBJ, daisyRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(daisyPosition2.x, daisyPosition2.y, daisyPosition2.z);
 	glRotatef(90., 0., 1., 0.);
-	glCallList(daisyList);  
+	DrawFlower(daisyList, DAISY_OBJ, daisyRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(daisyPosition3.x, daisyPosition3.y, daisyPosition3.z);
 	glRotatef(30., 0., 1., 0.);
-	glCallList(daisyList);  
+	DrawFlower(daisyList, DAISY_OBJ, daisyRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(daisyPosition4.x, daisyPosition4.y, daisyPosition4.z);
 	glRotatef(-90., 0., 1., 0.);
-	glCallList(daisyList);  
+	DrawFlower(daisyList, DAISY_OBJ, daisyRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(daisyPosition5.x, daisyPosition5.y, daisyPosition5.z);
 	glRotatef(60., 0., 1., 0.);
-	glCallList(daisyList);  
+	DrawFlower(daisyList, DAISY_OBJ, daisyRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(daisyPosition7.x, daisyPosition7.y, daisyPosition7.z);
-	glCallList(daisyList);  
+	DrawFlower(daisyList, DAISY_OBJ, daisyRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(daisyPosition8.x, daisyPosition8.y, daisyPosition8.z);
-	glCallList(daisyList);  
+	DrawFlower(daisyList, DAISY_OBJ, daisyRadius);  
 	glPopMatrix();
 
 	// whiteflowers
@@ -874,31 +1106,29 @@ Display( )
 	tdelay = (xRange / 2.f - whiteFlowerPosition.x) / xRange;
 	Pattern->SetUniformVariable("tdelay", tdelay);
 
-	glActiveTexture(GL_TEXTURE9); // use texture unit 9
-	glBindTexture(GL_TEXTURE_2D, whiteFlowerTex);
-	Pattern->SetUniformVariable("uTexUnit", 9);
+	UseTexture(WHITEFLOWER_BMP);
 
 	glPushMatrix();
 	glTranslatef(whiteFlowerPosition.x, whiteFlowerPosition.y, whiteFlowerPosition.z);
-	glCallList(whiteFlowerList);  
+	DrawFlower(whiteFlowerList, WHITEFLOWER_OBJ, whiteFlowerRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(whiteFlowerPosition2.x, whiteFlowerPosition2.y, whiteFlowerPosition2.z);
 	glRotatef(-70., 0., 1., 0.);
-	glCallList(whiteFlowerList);  
+	DrawFlower(whiteFlowerList, WHITEFLOWER_OBJ, whiteFlowerRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(whiteFlowerPosition3.x, whiteFlowerPosition3.y, whiteFlowerPosition3.z);
 	glRotatef(-90., 0., 1., 0.);
-	glCallList(whiteFlowerList);  
+	DrawFlower(whiteFlowerList, WHITEFLOWER_OBJ, whiteFlowerRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(whiteFlowerPosition4.x, whiteFlowerPosition4.y, whiteFlowerPosition4.z);
 	glRotatef(60., 0., 1., 0.);
-	glCallList(whiteFlowerList);  
+	DrawFlower(whiteFlowerList, WHITEFLOWER_OBJ, whiteFlowerRadius);  
 	glPopMatrix();
 
 	// snowdrop flowers
@@ -919,46 +1149,73 @@ Display( )
 	tdelay = (xRange / 2.f - snowdropPosition.x) / xRange;
 	Pattern->SetUniformVariable("tdelay", tdelay);
 
-	glActiveTexture(GL_TEXTURE10); // use texture unit 10
-	glBindTexture(GL_TEXTURE_2D, snowdropTex);
-	Pattern->SetUniformVariable("uTexUnit", 10);
+	UseTexture(SNOWDROP_BMP);
 
 	glPushMatrix();
 	glTranslatef(snowdropPosition.x, snowdropPosition.y, snowdropPosition.z);
-	glCallList(snowdropList);  
+	DrawFlower(snowdropList, SNOWDROP_OBJ, snowdropRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(snowdropPosition2.x, snowdropPosition2.y, snowdropPosition2.z);
 	glRotatef(90., 0., 1., 0.);
-	glCallList(snowdropList); 
+	DrawFlower(snowdropList, SNOWDROP_OBJ, snowdropRadius); 
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(snowdropPosition3.x, snowdropPosition3.y, snowdropPosition3.z);
 	glRotatef(-70., 0., 1., 0.);
-	glCallList(snowdropList);  
+	DrawFlower(snowdropList, SNOWDROP_OBJ, snowdropRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(snowdropPosition4.x, snowdropPosition4.y, snowdropPosition4.z);
 	glRotatef(30., 0., 1., 0.);
-	glCallList(snowdropList);  
+	DrawFlower(snowdropList, SNOWDROP_OBJ, snowdropRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(snowdropPosition5.x, snowdropPosition5.y, snowdropPosition5.z);
 	glRotatef(60., 0., 1., 0.);
-	glCallList(snowdropList);  
+	DrawFlower(snowdropList, SNOWDROP_OBJ, snowdropRadius);  
 	glPopMatrix();
 
 	glPushMatrix();
 	glTranslatef(snowdropPosition6.x, snowdropPosition6.y, snowdropPosition6.z);
-	glCallList(snowdropList);  
+	DrawFlower(snowdropList, SNOWDROP_OBJ, snowdropRadius);  
 	glPopMatrix();
 	
 	Pattern->Use(0);
 
+	// the streamed mesh, as much of it as has arrived, scaled to fit the box:
+
+	if( StreamedMesh.IsOpen( ) )
+	{
+		float lo[3], hi[3];
+		StreamedMesh.GetBounds( lo, hi );
+		float span = 0.;
+		for( int i = 0; i < 3; i++ )
+		{
+			if( hi[i] - lo[i] > span )
+				span = hi[i] - lo[i];
+		}
+
+		if( span > 0. )
+		{
+			glEnable( GL_LIGHTING );
+			glEnable( GL_LIGHT0 );
+			glEnable( GL_COLOR_MATERIAL );
+			glColor3f( 0.8f, 0.8f, 0.8f );
+			glPushMatrix( );
+			glScalef( BOXSIZE/span, BOXSIZE/span, BOXSIZE/span );
+			glTranslatef( -( lo[0] + hi[0] )/2.f, -( lo[1] + hi[1] )/2.f, -( lo[2] + hi[2] )/2.f );
+			StreamedMesh.Draw( );
+			glPopMatrix( );
+			glDisable( GL_COLOR_MATERIAL );
+			glDisable( GL_LIGHT0 );
+		}
+	}
+
 	glDisable(GL_LIGHTING);  
 
 #ifdef DEMO_Z_FIGHTING
@@ -1008,6 +1265,18 @@ Display( )
 	// note: be sure to use glFlush( ) here, not glFinish( ) !
 
 	glFlush( );
+
+	EndTextureFrame( Textures );
+
+	// report how long it took to get the meadow on the screen:
+
+	static bool firstFrame = true;
+	if( firstFrame )
+	{
+		firstFrame = false;
+		double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - StartTime ).count( );
+		fprintf( stderr, "Time to first frame: %.1f ms (meshes read and decoded in %.1f ms)\n", ms, AssetLoadMs );
+	}
 }
 
 
@@ -1088,6 +1357,14 @@ DoMainMenu( int id )
 			// gracefully exit the program:
 			glutSetWindow( MainWindow );
 			glFinish( );
+			StopTexturePipeline( TexturePipe );
+			if( TextureLoader.joinable( ) )
+				TextureLoader.join( );
+			PrintTextureStats( Textures );
+			FreeTextureManager( Textures );
+			FreeUploadRing( TextureRing );
+			ReleaseObjMesh( ButterflyMeshes[0] );
+			ReleaseObjMesh( ButterflyMeshes[1] );
 			glutDestroyWindow( MainWindow );
 			exit( 0 );
 			break;
@@ -1241,6 +1518,273 @@ InitMenus( )
 
 
 
+// read and decode every asset on worker threads:
+// nothing in here may call OpenGL -- there is no context on these threads
+
+void
+StartLoadingAssets( )
+{
+	InitTexturePipeline( TexturePipe, TextureAssets, NUM_TEXTURE_ASSETS, MIPMAP_FILTER, TEXTURE_ENCODING );
+#ifdef TEXTURE_ARRAY
+	SetPipelineTextureArrays( TexturePipe, TEXTUREARRAY_UNIT );
+#endif
+
+	// the textures have a thread of their own, since staging them waits on the frames that upload them,
+	// long after InitGraphics( ) has waited for the meshes:
+
+	TextureLoader = std::thread( [ ]( )
+	{
+		ParallelFor( NUM_TEXTURE_ASSETS, [ ]( int i )
+		{
+			DecodePipelineTexture( TexturePipe, i );
+		} );
+		StagePipelineTextures( TexturePipe );
+	} );
+
+	AssetLoader = std::thread( [ ]( )
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+
+		ParallelFor( NUM_MESH_ASSETS, [ ]( int i )
+		{
+			LoadObjMesh( MeshAssetFiles[i], Meshes[i] );
+
+			// the flowers are repeated all over the meadow, mostly covering a few pixels:
+
+			if( i == DAISY_OBJ  ||  i == WHITEFLOWER_OBJ  ||  i == SNOWDROP_OBJ )
+				BuildObjLods( Meshes[i], MeshLods[i] );
+		} );
+
+		AssetLoadMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+	} );
+}
+
+
+// wait for StartLoadingAssets( ) to finish reading the meshes:
+
+void
+FinishLoadingAssets( )
+{
+	if( ! AssetLoader.joinable( ) )
+		return;
+
+	AssetLoader.join( );
+
+	for( int i = 0; i < NUM_MESH_ASSETS; i++ )
+	{
+		if( Meshes[i].Positions.size() > 0 )
+			PrintObjMeshInfo( MeshAssetFiles[i], Meshes[i] );
+
+		if( MeshLods[i].size() > 0 )
+		{
+			fprintf( stderr, "Obj file levels of detail:" );
+			for( size_t lod = 0; lod < MeshLods[i].size(); lod++ )
+				fprintf( stderr, " %d", (int)MeshLods[i][lod].Indices.size()/3 );
+			fprintf( stderr, " triangles\n" );
+		}
+	}
+
+	fprintf( stderr, "Meshes read and decoded in %.1f ms\n", AssetLoadMs );
+}
+
+
+// every texture is up: let the texture loader go, and free the pixel buffers they came through
+// (a texture that is evicted and reloaded later goes straight from client memory)
+
+void
+FinishLoadingTextures( )
+{
+	TextureLoader.join( );
+
+	PrintUploadRing( TextureRing );
+	FreeUploadRing( TextureRing );
+	PrintTextureStats( Textures );
+}
+
+
+// one level of detail of a mesh asset:
+// level 0 is the mesh as it was loaded
+
+const ObjMesh &
+GetMeshLod( int asset, int level )
+{
+	if( level == 0  ||  level > (int)MeshLods[asset].size() )
+		return Meshes[asset];
+	else
+		return MeshLods[asset][level-1];
+}
+
+
+// how many levels of detail a mesh asset has, counting level 0:
+
+int
+GetNumMeshLods( int asset )
+{
+	return (int)MeshLods[asset].size() + 1;
+}
+
+
+void
+DrawMeshLod( int asset, int level )
+{
+	DrawObjMesh( GetMeshLod( asset, level ) );
+}
+
+
+// draw one flower at the level of detail its size on the screen calls for,
+// from its packed vertex buffers if it has them, else from its display list:
+
+void
+DrawFlower( GLuint list, int asset, float radius )
+{
+	int lod = SelectObjLod( radius, GetNumMeshLods( asset ) );
+
+	if( PackedLods[asset][lod].VertexBuffer != 0 )
+	{
+		glPushMatrix( );
+		glRotatef( -90., 1., 0., 0. );
+		glScalef( FlowerScales[asset], FlowerScales[asset], FlowerScales[asset] );
+		DrawPackedMesh( PackedLods[asset][lod] );
+		glPopMatrix( );
+	}
+	else
+	{
+		glCallList( list + lod );
+	}
+}
+
+
+
+// draw with one of the TextureAssets[ ]: its layer of its texture array, or its own texture unit
+// (putting it back on the gpu first if it was evicted):
+
+void
+UseTexture( int asset )
+{
+#ifdef TEXTURE_ARRAY
+	UseManagedTexture( Textures, asset );
+	const PipelineTexture &tex = TexturePipe.Textures[asset];
+	if( tex.Array >= 0 )
+	{
+		Pattern->SetUniformVariable( "uTexArray", TexturePipe.Arrays[tex.Array].Unit );
+		Pattern->SetUniformVariable( "uTexLayer", tex.Layer );
+	}
+#else
+	const TextureDesc &desc = TextureAssets[asset];
+	glActiveTexture( GL_TEXTURE0 + desc.Unit );
+	glBindTexture( GL_TEXTURE_2D, UseManagedTexture( Textures, asset ) );
+	Pattern->SetUniformVariable( "uTexUnit", desc.Unit );
+#endif
+}
+
+
+// draw one butterfly from the shared mesh, or from its own display list if there isn't one:
+
+void
+DrawButterfly( GLuint list, const SharedMesh *mesh, glm::vec3 position, float angle )
+{
+	if( mesh != NULL )
+	{
+		glPushMatrix( );
+		glTranslatef( position.x, position.y, position.z );
+		glRotatef( angle, 0., 1., 0. );
+		glScalef( butterflyScale, butterflyScale, butterflyScale );
+		DrawSharedMesh( mesh );
+		glPopMatrix( );
+	}
+	else
+	{
+		glCallList( list );
+	}
+}
+
+
+// where the grass and the apple sit in the scene (the same transformations as their display lists):
+
+glm::mat4
+GetGrassMatrix( )
+{
+	glm::mat4 m = glm::translate( glm::mat4( 1. ), glm::vec3( 0., grassBoundary.y, 0. ) );
+	m = glm::rotate( m, D2R * -90.f, glm::vec3( 1., 0., 0. ) );
+	return glm::scale( m, grassScale );
+}
+
+
+glm::mat4
+GetAppleMatrix( )
+{
+	glm::mat4 m = glm::translate( glm::mat4( 1. ), applePosition );
+	return glm::scale( m, glm::vec3( appleScale, appleScale, appleScale ) );
+}
+
+
+// the grass mesh's positions, bent into the hill the way pattern.vert does it:
+
+void
+GetGrassHill( ObjMesh &hill )
+{
+	hill.Positions = Meshes[GRASS_OBJ].Positions;
+	hill.Indices = Meshes[GRASS_OBJ].Indices;
+	for( size_t i = 0; i < hill.Positions.size(); i += 3 )
+	{
+		float x = hill.Positions[i];
+		if( x <= 0.f )
+			hill.Positions[i+2] = hill.Positions[i+2] - 0.0015f*( x * x ) - 0.4248f*x - 0.487f;
+	}
+}
+
+
+// shoot a ray through window pixel (x,y) and report the nearest object it hits:
+// the apple can only be picked while it is still hanging on the tree
+
+void
+PickObject( int x, int y )
+{
+	int wy = glutGet( GLUT_WINDOW_HEIGHT ) - y;
+	glm::vec3 nearPt = glm::unProject( glm::vec3( x, wy, 0. ), SceneModelview, SceneProjection, SceneViewport );
+	glm::vec3 farPt  = glm::unProject( glm::vec3( x, wy, 1. ), SceneModelview, SceneProjection, SceneViewport );
+	glm::vec4 org = glm::vec4( nearPt, 1. );
+	glm::vec4 dir = glm::vec4( glm::normalize( farPt - nearPt ), 0. );
+
+	struct { const char *name; const ObjMesh *mesh; const ObjBvh *bvh; glm::mat4 matrix; } objects[ ] =
+	{
+		{ MeshAssetFiles[GRASS_OBJ], &Meshes[GRASS_OBJ], &GrassBvh, GetGrassMatrix( ) },
+		{ MeshAssetFiles[APPLE_OBJ], &Meshes[APPLE_OBJ], &AppleBvh, GetAppleMatrix( ) },
+	};
+	int numObjects = useAnimation2 ? 1 : 2;
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+	float nearest = 1.e+37f;
+	int picked = -1;
+	for( int i = 0; i < numObjects; i++ )
+	{
+		// t stays in world units, since the object-space direction is not renormalized:
+
+		glm::mat4 toObject = glm::inverse( objects[i].matrix );
+		glm::vec4 o = toObject * org;
+		glm::vec4 d = toObject * dir;
+
+		ObjRayHit hit;
+		if( objects[i].mesh != &Meshes[GRASS_OBJ]  &&
+		    ! IntersectObjSphere( *objects[i].mesh, glm::value_ptr( o ), glm::value_ptr( d ), nearest ) )
+			continue;		// (the grass's sphere doesn't include the hill)
+
+		if( IntersectObjBvh( *objects[i].bvh, glm::value_ptr( o ), glm::value_ptr( d ), nearest, &hit ) )
+		{
+			nearest = hit.T;
+			picked = i;
+		}
+	}
+	double us = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now( ) - t0 ).count( );
+
+	if( picked < 0 )
+		return;
+
+	glm::vec4 p = org + nearest * dir;
+	fprintf( stderr, "Picked '%s' at (%.3f, %.3f, %.3f) in %.1f us\n", objects[picked].name, p.x, p.y, p.z, us );
+}
+
+
 // initialize the glut and OpenGL libraries:
 //	also setup display lists and callback functions
 
@@ -1340,124 +1884,16 @@ InitGraphics( )
 
 	// ----- Set up textures -------
 
-	// grass texture
-	glGenTextures(1, &grassTex);
-	int width = 1024, height = 1024;
-	Texture = BmpToTexture("textures/grassPatch.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, grassTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// bark texture
-	glGenTextures(1, &barkTex);
-	width = 512; 
-	height = 1024;
-	Texture = BmpToTexture("textures/bark.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, barkTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// leaf texture
-	glGenTextures(1, &leafTex);
-	width = 256; 
-	height = 256;
-	Texture = BmpToTexture("textures/leaf.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, leafTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// apple texture for fruit on tree
-	glGenTextures(1, &appleTex);
-	width = 512;
-	height = 256;
-	Texture = BmpToTexture("textures/apple.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, appleTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// apple texture for whole apple
-	glGenTextures(1, &appleWholeTex);
-	width = 1024;
-	height = 1024;
-	Texture = BmpToTexture("textures/appleWhole.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, appleWholeTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// yellow butterfly texture
-	glGenTextures(1, &butterflyTex);
-	width = 256;
-	height = 256;
-	Texture = BmpToTexture("textures/yellowButterfly.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, butterflyTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// daisy texture
-	glGenTextures(1, &daisyTex);
-	width = 1024;
-	height = 1024;
-	Texture = BmpToTexture("textures/daisy.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, daisyTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// white flower texture
-	glGenTextures(1, &whiteFlowerTex);
-	width = 1024;
-	height = 1024;
-	Texture = BmpToTexture("textures/whiteFlower.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, whiteFlowerTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// snowdrop texture
-	glGenTextures(1, &snowdropTex);
-	width = 1024;
-	height = 1024;
-	Texture = BmpToTexture("textures/snowdrop.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, snowdropTex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
-
-	// orange butterfly texture
-	glGenTextures(1, &butterflyTex2);
-	width = 256;
-	height = 256;
-	Texture = BmpToTexture("textures/orangeButterfly.bmp", &width, &height);
-	glBindTexture(GL_TEXTURE_2D, butterflyTex2);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, Texture);
+	// Animate( ) uploads the textures as the texture loader stages them, while the meadow
+	// is already being drawn, through the pixel buffer ring if the driver can map one:
+
+	InitUploadRing( TextureRing, TEXTURE_PBO_SLOTS, (size_t)TEXTURE_PBO_SLOT_MB * 1024 * 1024 );
+	StartPipelineUploads( TexturePipe, &TextureRing );
+	InitTextureManager( Textures, TexturePipe, (size_t)TEXTURE_BUDGET_MB * 1024 * 1024, TEXTURE_IDLE_FRAMES );
+
+	// then wait for the meshes:
+
+	FinishLoadingAssets( );
 
 }
 
@@ -1470,31 +1906,12 @@ InitGraphics( )
 void
 InitLists( )
 {
-	// get and load the object files
-	int loadobjReturn;
-	char* fileNameGrass = "objects/grass.obj"; 
-	char* fileNameTreeTrunk = "objects/treeTrunk.obj";
-	char* fileNameTreeLeaves = "objects/treeLeaves.obj";
-	char* fileNameTreeFruit = "objects/treeFruit.obj";
-	char* fileNameApple = "objects/apple.obj";
-	char* fileNameButterfly = "objects/butterfly.obj";
-	char* fileNameDaisy = "objects/daisy.obj";
-	char* fileNameWhiteFlower = "objects/whiteFlower.obj";
-	char* fileNameSnowdrop = "objects/snowdrop.obj";
-	char* fileNameWood = "objects/wood.obj";
-	
 	// Positions of various objects
-	glm::vec3 grassScale = glm::vec3(0.01667f, 0.0133, 0.0133f); 
-	glm::vec3 butterflyPosition = glm::vec3(1.0f, grassBoundary.y + 01.f, 0.2f);
-	glm::vec3 butterflyPosition2 = glm::vec3(0.4f, grassBoundary.y + 0.8f, -0.8f);
 	glm::vec3 woodPosition = glm::vec3(1.3f, grassBoundary.y - 0.2f, -1.5f);
 	
 	// Scaling factor to use with various objects based on their original sizes
-	float treeScale = 0.03f;
 	float leavesScale = 0.03f;
 	float fruitScale = 0.03f;
-	float appleScale = 2.0f; 
-	float butterflyScale = 0.02;
 	float daisyScale = 0.04;
 	float whiteFlowerScale = 0.02;
 	float snowdropScale = 0.07;
@@ -1502,29 +1919,76 @@ InitLists( )
 
 	glutSetWindow( MainWindow );
 
+#ifdef BENCHMARK_LOADERS
+	for( int i = 0; i < NUM_MESH_ASSETS; i++ )
+		BenchmarkObjNumbers( MeshAssetFiles[i] );
+	for( int i = 0; i < NUM_MESH_ASSETS; i++ )
+		BenchmarkObjGz( MeshAssetFiles[i] );
+	for( int i = 0; i < NUM_MESH_ASSETS; i++ )
+		BenchmarkMeshPack( MeshAssetFiles[i] );
+	for( int i = 0; i < NUM_TEXTURE_ASSETS; i++ )
+	{
+		int width = 0, height = 0;
+		unsigned char *texels = BmpToTexture( TextureAssets[i].File, &width, &height );
+		if( texels == NULL )
+			continue;
+		BenchmarkMipChain( TextureAssets[i].File, texels, width, height );
+		BenchmarkBcTexture( TextureAssets[i].File, texels, width, height );
+		delete [ ] texels;
+	}
+	for( int i = 0; i < NUM_TEXTURE_ASSETS; i++ )
+		BenchmarkTexCache( TextureAssets[i].File, MIPMAP_FILTER, TEXTURE_ENCODING );
+#endif
+
 	// -----create the objects-----:
 
-	// create the grass object
-	grassList = glGenLists(1);
-	glNewList( grassList, GL_COMPILE );
-	glPushMatrix();
-	glTranslatef(0.f, grassBoundary.y, 0.f);
-	glRotatef(-90., 1., 0., 0.);
-	glScalef(grassScale.x, grassScale.y, grassScale.z);
-	loadobjReturn = LoadObjFile(fileNameGrass);
-	glPopMatrix();
-	glEndList( );
+#ifdef CULL_MESHLETS
+	// cut the grass and the trunk into meshlets.
+	// the grass's bounds have to include the hill pattern.vert bends it into:
+
+	vector<ObjMeshlet> meshlets;
+	if( Meshes[GRASS_OBJ].Indices.size() > 0 )
+	{
+		BuildObjMeshlets( Meshes[GRASS_OBJ], meshlets );
+		ObjMesh hill;
+		GetGrassHill( hill );
+		ComputeObjMeshletBounds( hill, meshlets );
+		UploadMeshletMesh( Meshes[GRASS_OBJ], meshlets, GrassMeshlets );
+	}
+	if( Meshes[TREETRUNK_OBJ].Indices.size() > 0 )
+	{
+		BuildObjMeshlets( Meshes[TREETRUNK_OBJ], meshlets );
+		UploadMeshletMesh( Meshes[TREETRUNK_OBJ], meshlets, TrunkMeshlets );
+	}
+#endif
+
+	// create the grass object, unless it is drawn from its meshlets
+	if( GrassMeshlets.VertexBuffer == 0 )
+	{
+		grassList = glGenLists(1);
+		glNewList( grassList, GL_COMPILE );
+		glPushMatrix();
+		glTranslatef(0.f, grassBoundary.y, 0.f);
+		glRotatef(-90., 1., 0., 0.);
+		glScalef(grassScale.x, grassScale.y, grassScale.z);
+		DrawObjMesh(Meshes[GRASS_OBJ]);
+		glPopMatrix();
+		glEndList( );
+	}
 	
-	// create the tree trunk/branches object
-	treeTrunkList = glGenLists(1);
-	glNewList(treeTrunkList, GL_COMPILE);
-	glPushMatrix();
-	glTranslatef(treePosition.x, treePosition.y, treePosition.z);
-	glRotatef(-90., 1., 0., 0.);
-	glScalef(treeScale, treeScale, treeScale);
-	loadobjReturn = LoadObjFile(fileNameTreeTrunk);
-	glPopMatrix();
-	glEndList();
+	// create the tree trunk/branches object, unless it is drawn from its meshlets
+	if( TrunkMeshlets.VertexBuffer == 0 )
+	{
+		treeTrunkList = glGenLists(1);
+		glNewList(treeTrunkList, GL_COMPILE);
+		glPushMatrix();
+		glTranslatef(treePosition.x, treePosition.y, treePosition.z);
+		glRotatef(-90., 1., 0., 0.);
+		glScalef(treeScale, treeScale, treeScale);
+		DrawObjMesh(Meshes[TREETRUNK_OBJ]);
+		glPopMatrix();
+		glEndList();
+	}
 	
 	// create the tree fruit object
 	treeFruitList = glGenLists(1);
@@ -1533,7 +1997,7 @@ InitLists( )
 	glTranslatef(treePosition.x, treePosition.y, treePosition.z);
 	glRotatef(-90., 1., 0., 0.);
 	glScalef(fruitScale, fruitScale, fruitScale);
-	loadobjReturn = LoadObjFile(fileNameTreeFruit);
+	DrawObjMesh(Meshes[TREEFRUIT_OBJ]);
 	glPopMatrix();
 	glEndList();
 
@@ -1544,7 +2008,7 @@ InitLists( )
 	glTranslatef(treePosition.x, treePosition.y, treePosition.z);
 	glRotatef(-90., 1., 0., 0.);
 	glScalef(leavesScale, leavesScale, leavesScale);
-	loadobjReturn = LoadObjFile(fileNameTreeLeaves);
+	DrawObjMesh(Meshes[TREELEAVES_OBJ]);
 	glPopMatrix();
 	glEndList();
 
@@ -1554,61 +2018,138 @@ InitLists( )
 	glPushMatrix();
 	glTranslatef(applePosition.x, applePosition.y, applePosition.z);
 	glScalef(appleScale, appleScale, appleScale);
-	loadobjReturn = LoadObjFile(fileNameApple);
+	DrawObjMesh(Meshes[APPLE_OBJ]);
 	glPopMatrix();
 	glEndList();
 
+	// both butterflies share one copy of their mesh on the gpu,
+	// so they only get display lists of their own if it couldn't be made:
+	ButterflyMeshes[0] = AcquireObjMesh( MeshAssetFiles[BUTTERFLY_OBJ], &Meshes[BUTTERFLY_OBJ] );
+	ButterflyMeshes[1] = AcquireObjMesh( MeshAssetFiles[BUTTERFLY_OBJ], &Meshes[BUTTERFLY_OBJ] );
+	PrintMeshRegistry( );
+
 	// create the yellow butterfly object
-	butterflyList = glGenLists(1);
-	glNewList(butterflyList, GL_COMPILE);
-	glPushMatrix();
-	glTranslatef(butterflyPosition.x, butterflyPosition.y, butterflyPosition.z);
-	glRotatef(270., 0., 1., 0.);
-	glScalef(butterflyScale, butterflyScale, butterflyScale);
-	loadobjReturn = LoadObjFile(fileNameButterfly);
-	glPopMatrix();
-	glEndList();
+	if( ButterflyMeshes[0] == NULL )
+	{
+		butterflyList = glGenLists(1);
+		glNewList(butterflyList, GL_COMPILE);
+		glPushMatrix();
+		glTranslatef(butterflyPosition.x, butterflyPosition.y, butterflyPosition.z);
+		glRotatef(270., 0., 1., 0.);
+		glScalef(butterflyScale, butterflyScale, butterflyScale);
+		DrawObjMesh(Meshes[BUTTERFLY_OBJ]);
+		glPopMatrix();
+		glEndList();
+	}
 
 	// create the orange butterfly object
-	butterflyList2 = glGenLists(1);
-	glNewList(butterflyList2, GL_COMPILE);
-	glPushMatrix();
-	glTranslatef(butterflyPosition2.x, butterflyPosition2.y, butterflyPosition2.z);
-	glRotatef(180., 0., 1., 0.);
-	glScalef(butterflyScale, butterflyScale, butterflyScale);
-	loadobjReturn = LoadObjFile(fileNameButterfly);
-	glPopMatrix();
-	glEndList();
+	if( ButterflyMeshes[1] == NULL )
+	{
+		butterflyList2 = glGenLists(1);
+		glNewList(butterflyList2, GL_COMPILE);
+		glPushMatrix();
+		glTranslatef(butterflyPosition2.x, butterflyPosition2.y, butterflyPosition2.z);
+		glRotatef(180., 0., 1., 0.);
+		glScalef(butterflyScale, butterflyScale, butterflyScale);
+		DrawObjMesh(Meshes[BUTTERFLY_OBJ]);
+		glPopMatrix();
+		glEndList();
+	}
 
 	// create the daisy object
-	daisyList = glGenLists(1);
-	glNewList(daisyList, GL_COMPILE);
-	glPushMatrix();
-	glRotatef(-90., 1., 0., 0.);
-	glScalef(daisyScale, daisyScale, daisyScale);
-	loadobjReturn = LoadObjFile(fileNameDaisy);
-	glPopMatrix();
-	glEndList();
+	daisyList = glGenLists(GetNumMeshLods(DAISY_OBJ));
+	for (int lod = 0; lod < GetNumMeshLods(DAISY_OBJ); lod++) {
+		glNewList(daisyList + lod, GL_COMPILE);
+		glPushMatrix();
+		glRotatef(-90., 1., 0., 0.);
+		glScalef(daisyScale, daisyScale, daisyScale);
+		DrawMeshLod(DAISY_OBJ, lod);
+		glPopMatrix();
+		glEndList();
+	}
+	daisyRadius = daisyScale * ObjMeshRadius(Meshes[DAISY_OBJ]);
+	FlowerScales[DAISY_OBJ] = daisyScale;
 
 	// create the white flower object
-	whiteFlowerList = glGenLists(1);
-	glNewList(whiteFlowerList, GL_COMPILE);
-	glPushMatrix();
-	glRotatef(-90., 1., 0., 0.);
-	glScalef(whiteFlowerScale, whiteFlowerScale, whiteFlowerScale);
-	loadobjReturn = LoadObjFile(fileNameWhiteFlower);
-	glPopMatrix();
-	glEndList();
+	whiteFlowerList = glGenLists(GetNumMeshLods(WHITEFLOWER_OBJ));
+	for (int lod = 0; lod < GetNumMeshLods(WHITEFLOWER_OBJ); lod++) {
+		glNewList(whiteFlowerList + lod, GL_COMPILE);
+		glPushMatrix();
+		glRotatef(-90., 1., 0., 0.);
+		glScalef(whiteFlowerScale, whiteFlowerScale, whiteFlowerScale);
+		DrawMeshLod(WHITEFLOWER_OBJ, lod);
+		glPopMatrix();
+		glEndList();
+	}
+	whiteFlowerRadius = whiteFlowerScale * ObjMeshRadius(Meshes[WHITEFLOWER_OBJ]);
+	FlowerScales[WHITEFLOWER_OBJ] = whiteFlowerScale;
 
 	// create the snowdrop object
-	snowdropList = glGenLists(1);
-	glNewList(snowdropList, GL_COMPILE);
-	glPushMatrix();
-	glRotatef(-90., 1., 0., 0.);
-	glScalef(snowdropScale, snowdropScale, snowdropScale);
-	loadobjReturn = LoadObjFile(fileNameSnowdrop);
-	glPopMatrix();
-	glEndList();
+	snowdropList = glGenLists(GetNumMeshLods(SNOWDROP_OBJ));
+	for (int lod = 0; lod < GetNumMeshLods(SNOWDROP_OBJ); lod++) {
+		glNewList(snowdropList + lod, GL_COMPILE);
+		glPushMatrix();
+		glRotatef(-90., 1., 0., 0.);
+		glScalef(snowdropScale, snowdropScale, snowdropScale);
+		DrawMeshLod(SNOWDROP_OBJ, lod);
+		glPopMatrix();
+		glEndList();
+	}
+	snowdropRadius = snowdropScale * ObjMeshRadius(Meshes[SNOWDROP_OBJ]);
+	FlowerScales[SNOWDROP_OBJ] = snowdropScale;
+
+#ifdef PACKED_VERTICES
+	// quantize every level of every flower into its own vertex buffer.
+	// (the levels are built from the obj meshes, which are loaded anyway, so a .meshpack
+	// would only decode level 0 a second time - packs are left to BENCHMARK_LOADERS)
+
+	int flowers[ ] = { DAISY_OBJ, WHITEFLOWER_OBJ, SNOWDROP_OBJ };
+	size_t floatBytes = 0, packedBytes = 0;
+	for( int f = 0; f < 3; f++ )
+	{
+		for( int lod = 0; lod < GetNumMeshLods( flowers[f] ); lod++ )
+		{
+			const ObjMesh &mesh = GetMeshLod( flowers[f], lod );
+			PackedMesh &packed = PackedLods[ flowers[f] ][ lod ];
+			floatBytes += ( mesh.Positions.size() + mesh.Normals.size() + mesh.TexCoords.size() ) * sizeof(float);
+			packedBytes += ( mesh.Positions.size() / 3 ) * sizeof(PackedVertex);
+			PackObjMesh( mesh, packed );
+			UploadPackedMesh( packed );
+		}
+	}
+	fprintf( stderr, "Flower vertices packed from %d KB to %d KB\n", (int)( floatBytes / 1024 ), (int)( packedBytes / 1024 ) );
+#endif
+
+	// ray query structures, and how far the apple has to fall to land on the hill:
+
+	if( Meshes[GRASS_OBJ].Indices.size() > 0 )
+	{
+		ObjMesh hill;
+		GetGrassHill( hill );
+		BuildObjBvh( hill, GrassBvh );
+	}
+	BuildObjBvh( Meshes[APPLE_OBJ], AppleBvh );
+
+	if( GrassBvh.Nodes.size() > 0  &&  Meshes[APPLE_OBJ].Indices.size() > 0 )
+	{
+		const ObjMesh &apple = Meshes[APPLE_OBJ];
+		glm::vec4 bottom = GetAppleMatrix( ) * glm::vec4( apple.Center[0], apple.Min[1], apple.Center[2], 1. );
+		glm::mat4 toGrass = glm::inverse( GetGrassMatrix( ) );
+		glm::vec4 org = toGrass * bottom;
+		glm::vec4 dir = toGrass * glm::vec4( 0., -1., 0., 0. );
+
+		ObjRayHit hit;
+		if( IntersectObjBvh( GrassBvh, glm::value_ptr( org ), glm::value_ptr( dir ), 1.e+37f, &hit ) )
+		{
+			AppleDropHeight = hit.T;
+			fprintf( stderr, "The apple lands on the hill after falling %.3f\n", AppleDropHeight );
+		}
+	}
+
+#ifdef BENCHMARK_RAYS
+	for( int i = 0; i < NUM_MESH_ASSETS; i++ )
+		BenchmarkObjBvh( MeshAssetFiles[i], Meshes[i] );
+#endif
 	
 
 	// create the axes:
@@ -1748,6 +2289,9 @@ MouseButton( int button, int state, int x, int y )
 		Xmouse = x;
 		Ymouse = y;
 		ActiveButton |= b;		// set the proper bit
+
+		if( b == LEFT )
+			PickObject( x, y );
 	}
 	else
 	{
@@ -2007,149 +2551,6 @@ Axes( float length )
 
 }
 
-struct bmfh
-{
-	short bfType;
-	int bfSize;
-	short bfReserved1;
-	short bfReserved2;
-	int bfOffBits;
-} FileHeader;
-
-struct bmih
-{
-	int biSize;
-	int biWidth;
-	int biHeight;
-	short biPlanes;
-	short biBitCount;
-	int biCompression;
-	int biSizeImage;
-	int biXPelsPerMeter;
-	int biYPelsPerMeter;
-	int biClrUsed;
-	int biClrImportant;
-} InfoHeader;
-
-const int birgb = { 0 };
-
-// read a BMP file into a Texture:
-
-unsigned char *
-BmpToTexture( char *filename, int *width, int *height )
-{
-	FILE *fp = fopen( filename, "rb" );
-	if( fp == NULL )
-	{
-		fprintf( stderr, "Cannot open Bmp file '%s'\n", filename );
-		return NULL;
-	}
-
-	FileHeader.bfType = ReadShort( fp );
-
-
-	// if bfType is not 0x4d42, the file is not a bmp:
-
-	if( FileHeader.bfType != 0x4d42 )
-	{
-		fprintf( stderr, "File '%s' is the wrong type of file: 0x%0x\n", filename, FileHeader.bfType );
-		fclose( fp );
-		return NULL;
-	}
-
-	FileHeader.bfSize = ReadInt( fp );
-	FileHeader.bfReserved1 = ReadShort( fp );
-	FileHeader.bfReserved2 = ReadShort( fp );
-	FileHeader.bfOffBits = ReadInt( fp );
-
-	InfoHeader.biSize = ReadInt( fp );
-	InfoHeader.biWidth = ReadInt( fp );
-	InfoHeader.biHeight = ReadInt( fp );
-
-	int nums = InfoHeader.biWidth;
-	int numt = InfoHeader.biHeight;
-
-	InfoHeader.biPlanes = ReadShort( fp );
-	InfoHeader.biBitCount = ReadShort( fp );
-	InfoHeader.biCompression = ReadInt( fp );
-	InfoHeader.biSizeImage = ReadInt( fp );
-	InfoHeader.biXPelsPerMeter = ReadInt( fp );
-	InfoHeader.biYPelsPerMeter = ReadInt( fp );
-	InfoHeader.biClrUsed = ReadInt( fp );
-	InfoHeader.biClrImportant = ReadInt( fp );
-
-	fprintf( stderr, "Image size in file '%s' is: %d x %d\n", filename, nums, numt );
-
-	unsigned char * texture = new unsigned char[ 3 * nums * numt ];
-	if( texture == NULL )
-	{
-		fprintf( stderr, "Cannot allocate the texture array!\b" );
-		return NULL;
-	}
-
-	// extra padding bytes:
-
-	int numextra =  4*(( (3*InfoHeader.biWidth)+3)/4) - 3*InfoHeader.biWidth;
-
-	// we do not support compression:
-
-	if( InfoHeader.biCompression != birgb )
-	{
-		fprintf( stderr, "Image file '%s' has the wrong type of image compression: %d\n", filename, InfoHeader.biCompression );
-		fclose( fp );
-		return NULL;
-	}
-
-	rewind( fp );
-	fseek( fp, 14+40, SEEK_SET );
-
-	if( InfoHeader.biBitCount == 24 )
-	{
-		unsigned char *tp = texture;
-		for( int t = 0; t < numt; t++ )
-		{
-			for( int s = 0; s < nums; s++, tp += 3 )
-			{
-				*(tp+2) = fgetc( fp );		// b
-				*(tp+1) = fgetc( fp );		// g
-				*(tp+0) = fgetc( fp );		// r
-			}
-
-			for( int e = 0; e < numextra; e++ )
-			{
-				fgetc( fp );
-			}
-		}
-	}
-
-	fclose( fp );
-
-	*width = nums;
-	*height = numt;
-	return texture;
-}
-
-int
-ReadInt( FILE *fp )
-{
-	unsigned char b3, b2, b1, b0;
-	b0 = fgetc( fp );
-	b1 = fgetc( fp );
-	b2 = fgetc( fp );
-	b3 = fgetc( fp );
-	return ( b3 << 24 )  |  ( b2 << 16 )  |  ( b1 << 8 )  |  b0;
-}
-
-short
-ReadShort( FILE *fp )
-{
-	unsigned char b1, b0;
-	b0 = fgetc( fp );
-	b1 = fgetc( fp );
-	return ( b1 << 8 )  |  b0;
-}
-
-
 // function to convert HSV to RGB
 // 0.  <=  s, v, r, g, b  <=  1.
 // 0.  <= h  <=  360.
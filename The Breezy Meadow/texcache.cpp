@@ -0,0 +1,299 @@
+#include "texcache.h"
+#include "bmptexture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+
+// the cache is a raw image of little-endian memory:
+
+static bool
+IsLittleEndian( )
+{
+	unsigned int one = 1;
+	return *(unsigned char *)&one == 1;
+}
+
+
+static std::string
+CacheName( const char *bmpname )
+{
+	return std::string( bmpname ) + TEXCACHE_EXT;
+}
+
+
+// how many bytes a level of the given format should hold:
+
+static unsigned long long
+GetLevelBytes( unsigned int format, unsigned int width, unsigned int height )
+{
+	if( format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT )
+		return 8ULL * ( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 );
+	return 3ULL * width * height;
+}
+
+
+// map the cache for bmpname and check that it is whole and was built the way the caller wants:
+// returns false if there is no cache, it is out of date, or it is damaged
+
+bool
+OpenTexCache( const char *bmpname, int filter, int encoding, TexCache &tex )
+{
+	tex.Levels.clear( );
+	if( ! IsLittleEndian( ) )
+		return false;
+
+	if( ! MapFile( CacheName( bmpname ).c_str(), &tex.File ) )
+		return false;
+
+	bool ok = tex.File.Size >= sizeof(TexCacheHeader);
+	if( ok )
+	{
+		memcpy( &tex.Header, tex.File.Data, sizeof(TexCacheHeader) );
+		const TexCacheHeader &hdr = tex.Header;
+		ok = hdr.Magic == TEXCACHE_MAGIC  &&  hdr.Version == TEXCACHE_VERSION  &&
+		     hdr.Filter == (unsigned int)filter  &&  hdr.Encoding == encoding  &&
+		     ( hdr.Format == GL_RGB  ||  hdr.Format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT )  &&
+		     hdr.NumLevels >= 1  &&  hdr.NumLevels <= 32  &&
+		     tex.File.Size >= sizeof(TexCacheHeader) + hdr.NumLevels * sizeof(TexCacheLevel);
+	}
+
+	// a cache shipped without its .bmp file is used as it is:
+
+	unsigned long long size;
+	long long mtime;
+	if( ok  &&  GetSourceStamp( bmpname, &size, &mtime ) )
+		ok = ( tex.Header.SourceSize == size  &&  tex.Header.SourceTime == mtime );
+
+	if( ok )
+	{
+		tex.Levels.resize( tex.Header.NumLevels );
+		memcpy( &tex.Levels[0], tex.File.Data + sizeof(TexCacheHeader), tex.Levels.size() * sizeof(TexCacheLevel) );
+		for( size_t i = 0; ok  &&  i < tex.Levels.size(); i++ )
+		{
+			const TexCacheLevel &level = tex.Levels[i];
+			ok = level.Width > 0  &&  level.Height > 0  &&
+			     level.Bytes == GetLevelBytes( tex.Header.Format, level.Width, level.Height )  &&
+			     level.Offset <= tex.File.Size  &&  level.Bytes <= tex.File.Size - level.Offset;
+		}
+	}
+
+	if( ! ok )
+		CloseTexCache( tex );
+	return ok;
+}
+
+
+void
+CloseTexCache( TexCache &tex )
+{
+	UnmapFile( &tex.File );
+	tex.Levels.clear( );
+}
+
+
+// upload every level of an open cache, straight from the mapping, to the bound GL_TEXTURE_2D:
+// returns false if the cache is not open or holds blocks the driver can't take
+
+bool
+UploadTexCache( const TexCache &tex )
+{
+	if( tex.Levels.empty( ) )
+		return false;
+
+	bool compressed = ( tex.Header.Format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT );
+	if( compressed  &&  ! GLEW_EXT_texture_compression_s3tc )
+		return false;
+
+	// RGB rows are not padded out to 4 bytes:
+
+	GLint alignment;
+	glGetIntegerv( GL_UNPACK_ALIGNMENT, &alignment );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+	for( size_t i = 0; i < tex.Levels.size(); i++ )
+	{
+		const TexCacheLevel &level = tex.Levels[i];
+		const void *texels = tex.File.Data + level.Offset;
+		if( compressed )
+			glCompressedTexImage2D( GL_TEXTURE_2D, (GLint)i, tex.Header.Format, level.Width, level.Height, 0,
+				(GLsizei)level.Bytes, texels );
+		else
+			glTexImage2D( GL_TEXTURE_2D, (GLint)i, 3, level.Width, level.Height, 0, GL_RGB, GL_UNSIGNED_BYTE, texels );
+	}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, alignment );
+
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)tex.Levels.size() - 1 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, tex.Levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	return true;
+}
+
+
+// write the cache for bmpname: the compressed levels if there are any, else the RGB texels and their chain
+// the file is written under a temporary name and renamed, so a crash never leaves a half-written cache
+
+bool
+WriteTexCache( const char *bmpname, const unsigned char *texels, int width, int height, const std::vector<MipLevel> &mips,
+		const BcTexture &compressed, int filter, int encoding )
+{
+	if( ! IsLittleEndian( )  ||  texels == NULL  ||  width <= 0  ||  height <= 0 )
+		return false;
+
+	TexCacheHeader hdr;
+	memset( &hdr, 0, sizeof(hdr) );
+	hdr.Magic = TEXCACHE_MAGIC;
+	hdr.Version = TEXCACHE_VERSION;
+	hdr.Filter = (unsigned int)filter;
+	hdr.Encoding = encoding;
+	if( ! GetSourceStamp( bmpname, &hdr.SourceSize, &hdr.SourceTime ) )
+		return false;
+
+	// where each level's bytes come from:
+
+	std::vector<const unsigned char *> data;
+	std::vector<TexCacheLevel> levels;
+	if( ! compressed.Levels.empty( ) )
+	{
+		hdr.Format = compressed.Format;
+		for( size_t i = 0; i < compressed.Levels.size(); i++ )
+		{
+			TexCacheLevel level;
+			level.Width = (unsigned int)compressed.Levels[i].Width;
+			level.Height = (unsigned int)compressed.Levels[i].Height;
+			levels.push_back( level );
+			data.push_back( &compressed.Levels[i].Blocks[0] );
+		}
+	}
+	else
+	{
+		hdr.Format = GL_RGB;
+		TexCacheLevel level;
+		level.Width = (unsigned int)width;
+		level.Height = (unsigned int)height;
+		levels.push_back( level );
+		data.push_back( texels );
+		for( size_t i = 0; i < mips.size(); i++ )
+		{
+			level.Width = (unsigned int)mips[i].Width;
+			level.Height = (unsigned int)mips[i].Height;
+			levels.push_back( level );
+			data.push_back( &mips[i].Texels[0] );
+		}
+	}
+
+	hdr.NumLevels = (unsigned int)levels.size();
+	unsigned long long offset = sizeof(hdr) + levels.size() * sizeof(TexCacheLevel);
+	for( size_t i = 0; i < levels.size(); i++ )
+	{
+		offset = ( offset + TEXCACHE_ALIGN - 1 ) / TEXCACHE_ALIGN * TEXCACHE_ALIGN;
+		levels[i].Offset = offset;
+		levels[i].Bytes = GetLevelBytes( hdr.Format, levels[i].Width, levels[i].Height );
+		offset += levels[i].Bytes;
+	}
+
+	std::string name = CacheName( bmpname );
+	std::string tmpname = name + ".tmp";
+
+	FILE *fp = fopen( tmpname.c_str(), "wb" );
+	if( fp == NULL )
+	{
+		fprintf( stderr, "Cannot write texture cache '%s'\n", tmpname.c_str() );
+		return false;
+	}
+
+	static const unsigned char zeros[ TEXCACHE_ALIGN ] = { 0 };
+	bool ok = fwrite( &hdr, sizeof(hdr), 1, fp ) == 1  &&
+		  fwrite( &levels[0], sizeof(TexCacheLevel), levels.size(), fp ) == levels.size();
+	unsigned long long written = sizeof(hdr) + levels.size() * sizeof(TexCacheLevel);
+	for( size_t i = 0; ok  &&  i < levels.size(); i++ )
+	{
+		size_t pad = (size_t)( levels[i].Offset - written );
+		ok = ( pad == 0  ||  fwrite( zeros, 1, pad, fp ) == pad )  &&
+		     fwrite( data[i], 1, (size_t)levels[i].Bytes, fp ) == (size_t)levels[i].Bytes;
+		written = levels[i].Offset + levels[i].Bytes;
+	}
+	if( fclose( fp ) != 0 )
+		ok = false;
+
+#ifdef WIN32
+	if( ok )
+		ok = MoveFileExA( tmpname.c_str(), name.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+	if( ok )
+		ok = rename( tmpname.c_str(), name.c_str() ) == 0;
+#endif
+
+	if( ! ok )
+	{
+		fprintf( stderr, "Cannot write texture cache '%s'\n", name.c_str() );
+		remove( tmpname.c_str() );
+	}
+
+	return ok;
+}
+
+
+// benchmark: compare the time to decode, filter and (maybe) compress a .bmp texture with the time
+// to map its cache and touch every page of it, which is all that is left before the upload
+// (best of several runs of each)
+
+void
+BenchmarkTexCache( const char *bmpname, int filter, int encoding )
+{
+	double buildMs = 1.e+37;
+	for( int run = 0; run < 3; run++ )
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+
+		int width = 0, height = 0;
+		unsigned char *texels = BmpToTexture( bmpname, &width, &height );
+		if( texels == NULL )
+			return;
+		std::vector<MipLevel> mips;
+		BuildMipChain( texels, width, height, filter, mips );
+		BcTexture compressed;
+		if( encoding != TEXCACHE_UNCOMPRESSED )
+		{
+			CompressMipChain( texels, width, height, mips, encoding, compressed );
+			if( compressed.Psnr < BCMINPSNR )
+				compressed.Levels.clear( );
+		}
+
+		double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+		if( ms < buildMs )
+			buildMs = ms;
+
+		if( run == 0 )
+			WriteTexCache( bmpname, texels, width, height, mips, compressed, filter, encoding );
+		delete [ ] texels;
+	}
+
+	double mapMs = 1.e+37;
+	size_t cacheBytes = 0;
+	volatile unsigned int touched = 0;	// so the reads are not optimized away
+	for( int run = 0; run < 10; run++ )
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+
+		TexCache tex;
+		if( ! OpenTexCache( bmpname, filter, encoding, tex ) )
+		{
+			fprintf( stderr, "%-32s has no usable texture cache\n", bmpname );
+			return;
+		}
+		cacheBytes = tex.File.Size;
+		for( size_t i = 0; i < tex.File.Size; i += 4096 )
+			touched = touched + (unsigned char)tex.File.Data[i];
+		CloseTexCache( tex );
+
+		double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+		if( ms < mapMs )
+			mapMs = ms;
+	}
+
+	fprintf( stderr, "%-32s cache %5d KB  build %7.2f ms  map %6.2f ms (%.0fx faster)\n",
+		bmpname, (int)( cacheBytes / 1024 ), buildMs, mapMs, buildMs / mapMs );
+}
@@ -0,0 +1,86 @@
+/*****************************************************************
+* Description: On-disk cache of textures in the form the gpu takes
+*              them, so that loading one is only a map and an upload.
+*
+*              The first time a .bmp texture is loaded, its full-size
+*              image and whole mipmap chain - BC1 blocks or plain RGB,
+*              whichever it was uploaded as - are written next to it
+*              as <name>.bmp.texcache. Later loads map the cache and
+*              hand each level straight from the mapping to
+*              glTexImage2D( ) or glCompressedTexImage2D( ), with no
+*              decoding, filtering or compressing left to do.
+*
+*              The cache remembers the size and modification time of
+*              the .bmp file it was built from, and the mipmap filter
+*              and encoding that were asked for; if any of them
+*              changes, the cache is rebuilt. A texture that was asked
+*              to be compressed but came back too lossy is cached
+*              uncompressed, and still counts as up to date. So is one
+*              the driver couldn't take as BC1: a loader that only
+*              finds that out after it has asked for the cache writes
+*              it as RGB under TEXCACHE_NOS3TC, and asks for that next.
+*
+*              File layout (all little-endian):
+*                  TexCacheHeader
+*                  TexCacheLevel  levels[ NumLevels ]
+*                  unsigned char  texels[ ]
+*
+*              Each level's texels start at its Offset from the start
+*              of the file, on a TEXCACHE_ALIGN boundary. RGB rows are
+*              not padded.
+*/
+
+#pragma once
+#ifndef TEXCACHE_H
+#define TEXCACHE_H
+
+#include "glew.h"
+#include <GL/gl.h>
+
+#include <vector>
+
+#include "blockcompress.h"
+#include "mappedfile.h"
+#include "mipmaps.h"
+
+#define TEXCACHE_EXT		".texcache"
+#define TEXCACHE_MAGIC		0x48435854		// "TXCH"
+#define TEXCACHE_VERSION	3
+#define TEXCACHE_ALIGN		16
+
+#define TEXCACHE_UNCOMPRESSED	-1			// an encoding: leave the texels as RGB
+#define TEXCACHE_NOS3TC		-2			// an encoding: compression was asked for, but the driver had no S3TC
+
+struct TexCacheHeader
+{
+	unsigned int		Magic;
+	unsigned int		Version;
+	unsigned long long	SourceSize;		// size of the .bmp file in bytes
+	long long		SourceTime;		// modification time of the .bmp file
+	unsigned int		Format;			// GL_RGB or GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+	unsigned int		Filter;			// the mipmap filter that was asked for
+	int			Encoding;		// BCFAST, BCQUALITY, TEXCACHE_UNCOMPRESSED or TEXCACHE_NOS3TC, as asked for
+	unsigned int		NumLevels;
+};
+
+struct TexCacheLevel
+{
+	unsigned int		Width, Height;
+	unsigned long long	Offset;			// from the start of the file
+	unsigned long long	Bytes;
+};
+
+struct TexCache
+{
+	MappedFile			File;
+	TexCacheHeader			Header;
+	std::vector<TexCacheLevel>	Levels;
+};
+
+void	BenchmarkTexCache( const char *, int, int );
+void	CloseTexCache( TexCache & );
+bool	OpenTexCache( const char *, int, int, TexCache & );
+bool	UploadTexCache( const TexCache & );
+bool	WriteTexCache( const char *, const unsigned char *, int, int, const std::vector<MipLevel> &, const BcTexture &, int, int );
+
+#endif
@@ -0,0 +1,200 @@
+#include "texturemanager.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+
+// count what the textures hold on the gpu and on the cpu now:
+
+static void
+UpdateTextureStats( TextureManager &mgr )
+{
+	TexturePipeline &pipe = *mgr.Pipe;
+	TextureStats &stats = mgr.Stats;
+
+	stats.GpuBytes = 0;
+	stats.Resident = 0;
+	for( int i = 0; i < pipe.NumTextures; i++ )
+	{
+		if( pipe.Textures[i].GpuBytes > 0 )
+		{
+			stats.GpuBytes += pipe.Textures[i].GpuBytes;
+			stats.Resident++;
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock( pipe.Lock );
+		stats.StagingBytes = pipe.StagingBytes;
+		stats.PeakStagingBytes = std::max( stats.PeakStagingBytes, pipe.PeakStagingBytes );
+	}
+
+	stats.PeakGpuBytes = std::max( stats.PeakGpuBytes, stats.GpuBytes );
+}
+
+
+// take over the textures of a pipeline, as it uploads them:
+// budget is in bytes (0 for no limit)
+
+void
+InitTextureManager( TextureManager &mgr, TexturePipeline &pipe, size_t budget, int idleFrames )
+{
+	mgr.Pipe = &pipe;
+	mgr.Budget = budget;
+	mgr.IdleFrames = idleFrames;
+	mgr.Frame = 0;
+	mgr.LastUsed.assign( pipe.NumTextures, 0 );
+
+	TextureStats &stats = mgr.Stats;
+	stats.PeakGpuBytes = stats.PeakStagingBytes = 0;
+	stats.Evictions = stats.Reloads = 0;
+	UpdateTextureStats( mgr );
+}
+
+
+// about to draw with texture i: put it back on the gpu if it was evicted (with texture arrays, the
+// whole array it is a layer of)
+// returns its texture object, or the texture array it is a layer of (0 if it isn't up yet)
+
+GLuint
+UseManagedTexture( TextureManager &mgr, int i )
+{
+	TexturePipeline &pipe = *mgr.Pipe;
+	mgr.LastUsed[i] = mgr.Frame;
+	if( pipe.UseArrays )
+	{
+		int a = pipe.Textures[i].Array;
+		if( a < 0 )
+			return 0;
+
+		PipelineArray &array = pipe.Arrays[a];
+		if( array.Name == 0  &&  pipe.NumUploaded == pipe.NumTextures )
+		{
+			ReloadPipelineArray( pipe, a );
+			mgr.Stats.Reloads += (int)array.Textures.size();
+			UpdateTextureStats( mgr );
+		}
+		return array.Name;
+	}
+
+	GLuint *name = pipe.Descs[i].Name;
+	if( *name == 0  &&  pipe.NumUploaded == pipe.NumTextures )
+	{
+		ReloadPipelineTexture( pipe, i );
+		mgr.Stats.Reloads++;
+		UpdateTextureStats( mgr );
+	}
+	return *name;
+}
+
+
+// evict the least recently used textures that have sat idle long enough, until they fit the budget:
+
+static void
+EvictIdleTextures( TextureManager &mgr )
+{
+	TexturePipeline &pipe = *mgr.Pipe;
+	std::vector<int> idle;
+	for( int i = 0; i < pipe.NumTextures; i++ )
+	{
+		if( pipe.Textures[i].GpuBytes > 0  &&  mgr.Frame - mgr.LastUsed[i] >= mgr.IdleFrames )
+			idle.push_back( i );
+	}
+
+	std::sort( idle.begin(), idle.end(), [&]( int a, int b ) { return mgr.LastUsed[a] < mgr.LastUsed[b]; } );
+
+	for( size_t k = 0; k < idle.size()  &&  mgr.Stats.GpuBytes > mgr.Budget; k++ )
+	{
+		size_t bytes = pipe.Textures[ idle[k] ].GpuBytes;
+		if( EvictPipelineTexture( pipe, idle[k] ) )
+		{
+			mgr.Stats.GpuBytes -= bytes;
+			mgr.Stats.Resident--;
+			mgr.Stats.Evictions++;
+		}
+	}
+}
+
+
+// the same for texture arrays, which can only go as a whole:
+// an array is as idle as the most recently used of its layers
+
+static void
+EvictIdleArrays( TextureManager &mgr )
+{
+	TexturePipeline &pipe = *mgr.Pipe;
+	std::vector<int> idle;
+	std::vector<int> lastUsed( pipe.Arrays.size(), 0 );
+	for( size_t a = 0; a < pipe.Arrays.size(); a++ )
+	{
+		const PipelineArray &array = pipe.Arrays[a];
+		for( size_t k = 0; k < array.Textures.size(); k++ )
+			lastUsed[a] = std::max( lastUsed[a], mgr.LastUsed[ array.Textures[k] ] );
+		if( array.Name != 0  &&  mgr.Frame - lastUsed[a] >= mgr.IdleFrames )
+			idle.push_back( (int)a );
+	}
+
+	std::sort( idle.begin(), idle.end(), [&]( int a, int b ) { return lastUsed[a] < lastUsed[b]; } );
+
+	for( size_t k = 0; k < idle.size()  &&  mgr.Stats.GpuBytes > mgr.Budget; k++ )
+	{
+		const PipelineArray &array = pipe.Arrays[ idle[k] ];
+		size_t bytes = 0;
+		int layers = 0;
+		for( size_t l = 0; l < array.Textures.size(); l++ )
+		{
+			size_t b = pipe.Textures[ array.Textures[l] ].GpuBytes;
+			bytes += b;
+			layers += ( b > 0 ) ? 1 : 0;
+		}
+		if( EvictPipelineArray( pipe, idle[k] ) )
+		{
+			mgr.Stats.GpuBytes -= bytes;
+			mgr.Stats.Resident -= layers;
+			mgr.Stats.Evictions += layers;
+		}
+	}
+}
+
+
+// done drawing a frame: if the textures are over budget, evict the least recently used ones
+// that have sat idle long enough, until they fit
+// (not while the pipeline is still uploading, since UseManagedTexture( ) couldn't put them back yet)
+
+void
+EndTextureFrame( TextureManager &mgr )
+{
+	TexturePipeline &pipe = *mgr.Pipe;
+	UpdateTextureStats( mgr );
+	if( mgr.Budget > 0  &&  mgr.Stats.GpuBytes > mgr.Budget  &&  pipe.NumUploaded == pipe.NumTextures )
+	{
+		if( pipe.UseArrays )
+			EvictIdleArrays( mgr );
+		else
+			EvictIdleTextures( mgr );
+	}
+
+	mgr.Frame++;
+}
+
+
+// delete every texture and whatever is still staged:
+
+void
+FreeTextureManager( TextureManager &mgr )
+{
+	FreeTexturePipeline( *mgr.Pipe );
+	UpdateTextureStats( mgr );
+}
+
+
+void
+PrintTextureStats( const TextureManager &mgr )
+{
+	const TextureStats &stats = mgr.Stats;
+	fprintf( stderr, "Textures: %d resident, %d KB on the gpu (peak %d KB",
+		stats.Resident, (int)( stats.GpuBytes / 1024 ), (int)( stats.PeakGpuBytes / 1024 ) );
+	if( mgr.Budget > 0 )
+		fprintf( stderr, ", budget %d KB", (int)( mgr.Budget / 1024 ) );
+	fprintf( stderr, "), %d KB staged (peak %d KB), %d evictions, %d reloads\n",
+		(int)( stats.StagingBytes / 1024 ), (int)( stats.PeakStagingBytes / 1024 ), stats.Evictions, stats.Reloads );
+}
@@ -0,0 +1,66 @@
+/*****************************************************************
+* Description: Keeps the textures a TexturePipeline put on the gpu
+*              within a budget of gpu memory, and counts what they
+*              use for profiling.
+*
+*              Each frame, the program calls UseManagedTexture( ) for
+*              every texture it draws with, and EndTextureFrame( )
+*              once it is done. Whenever the textures then take more
+*              than the budget, the ones that have gone longest
+*              without being drawn - and at least IdleFrames frames -
+*              are evicted until they fit again. UseManagedTexture( )
+*              quietly reloads an evicted texture, from its cache if
+*              it has one. A texture in use is never evicted, so the
+*              budget can still be overrun by what one frame draws.
+*
+*              Textures in texture arrays can only be evicted a whole
+*              array at a time: once every one of its layers has gone
+*              IdleFrames frames undrawn. Drawing with any of them
+*              then reloads the lot.
+*
+*              Uses GL, so call it from the thread that owns the
+*              context, after StartPipelineUploads( ). Nothing is
+*              evicted until UploadPipelineTextures( ) has put every
+*              texture up, so a texture that has been drawn never
+*              goes missing while the rest are still arriving.
+*/
+
+#pragma once
+#ifndef TEXTUREMANAGER_H
+#define TEXTUREMANAGER_H
+
+#include "glew.h"
+#include <GL/gl.h>
+
+#include <vector>
+
+#include "texturepipeline.h"
+
+struct TextureStats
+{
+	size_t		GpuBytes;		// what the textures take on the gpu now
+	size_t		PeakGpuBytes;
+	size_t		StagingBytes;		// cpu memory still holding decoded textures
+	size_t		PeakStagingBytes;
+	int		Resident;		// how many textures are on the gpu
+	int		Evictions;		// how many times one was taken off it (each layer of an evicted array counts)
+	int		Reloads;		// how many times one was put back
+};
+
+struct TextureManager
+{
+	TexturePipeline *	Pipe;
+	size_t			Budget;		// bytes of gpu memory the textures may take, 0 for no limit
+	int			IdleFrames;	// how long a texture must go undrawn before it can be evicted
+	int			Frame;
+	std::vector<int>	LastUsed;	// the frame each texture was last drawn in
+	TextureStats		Stats;
+};
+
+void	EndTextureFrame( TextureManager & );
+void	FreeTextureManager( TextureManager & );
+void	InitTextureManager( TextureManager &, TexturePipeline &, size_t, int );
+void	PrintTextureStats( const TextureManager & );
+GLuint	UseManagedTexture( TextureManager &, int );
+
+#endif
@@ -0,0 +1,860 @@
+#include "texturepipeline.h"
+#include "bmptexture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+
+// set up a pipeline for n textures, before any of them are decoded:
+
+void
+InitTexturePipeline( TexturePipeline &pipe, const TextureDesc *descs, int n, int filter, int encoding )
+{
+	pipe.Descs = descs;
+	pipe.NumTextures = n;
+	pipe.Filter = filter;
+	pipe.Encoding = encoding;
+	pipe.Textures.clear( );
+	pipe.Textures.resize( n );
+	for( int i = 0; i < n; i++ )
+	{
+		pipe.Textures[i].Texels = NULL;
+		pipe.Textures[i].Width = pipe.Textures[i].Height = 0;
+		pipe.Textures[i].Compressed.Psnr = 0.;
+		pipe.Textures[i].DecodeMs = pipe.Textures[i].UploadMs = 0.;
+		pipe.Textures[i].StagingBytes = pipe.Textures[i].GpuBytes = 0;
+		pipe.Textures[i].Array = pipe.Textures[i].Layer = -1;
+		pipe.Textures[i].Slot = -1;
+	}
+	pipe.UseArrays = false;
+	pipe.ArrayUnit = 0;
+	pipe.Arrays.clear( );
+	pipe.Ring = NULL;
+	pipe.Started = pipe.Stopping = pipe.Grouped = false;
+	pipe.NumDecoded = pipe.NumUploaded = 0;
+	pipe.Ready.clear( );
+	pipe.FreeSlots.clear( );
+	pipe.FencedSlots.clear( );
+	pipe.StagingBytes = pipe.PeakStagingBytes = 0;
+	pipe.SlotWaitMs = pipe.UploadMs = 0.;
+	pipe.UploadFrames = 0;
+}
+
+
+// put the textures into the layers of texture arrays, one for each size, bound to unit, unit + 1, ...:
+// call after InitTexturePipeline( ) and before anything is uploaded
+
+void
+SetPipelineTextureArrays( TexturePipeline &pipe, int unit )
+{
+	pipe.UseArrays = true;
+	pipe.ArrayUnit = unit;
+}
+
+
+// the cpu memory a decoded texture holds until it is uploaded:
+
+static size_t
+GetStagingBytes( const PipelineTexture &tex )
+{
+	if( ! tex.Cache.Levels.empty( ) )
+		return tex.Cache.File.Size;
+
+	size_t bytes = 0;
+	if( tex.Texels != NULL )
+		bytes += 3 * (size_t)tex.Width * tex.Height;
+	for( size_t i = 0; i < tex.Mips.size(); i++ )
+		bytes += tex.Mips[i].Texels.size();
+	for( size_t i = 0; i < tex.Compressed.Levels.size(); i++ )
+		bytes += tex.Compressed.Levels[i].Blocks.size();
+	return bytes;
+}
+
+
+// read, filter and compress texture i, or map its cache:
+
+static void
+DecodeTexture( TexturePipeline &pipe, int i )
+{
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+
+	const char *name = pipe.Descs[i].File;
+	PipelineTexture &tex = pipe.Textures[i];
+
+	// nothing here can ask the driver for S3TC, so take the RGB cache a driver without it left, too:
+
+	if( OpenTexCache( name, pipe.Filter, pipe.Encoding, tex.Cache )  ||
+	    ( pipe.Encoding != TEXCACHE_UNCOMPRESSED  &&  OpenTexCache( name, pipe.Filter, TEXCACHE_NOS3TC, tex.Cache ) ) )
+	{
+		tex.Width = (int)tex.Cache.Levels[0].Width;
+		tex.Height = (int)tex.Cache.Levels[0].Height;
+	}
+	else
+	{
+		tex.Texels = BmpToTexture( name, &tex.Width, &tex.Height );
+		BuildMipChain( tex.Texels, tex.Width, tex.Height, pipe.Filter, tex.Mips );
+		if( pipe.Encoding != TEXCACHE_UNCOMPRESSED )
+		{
+			CompressMipChain( tex.Texels, tex.Width, tex.Height, tex.Mips, pipe.Encoding, tex.Compressed );
+			if( tex.Compressed.Psnr < BCMINPSNR )
+				tex.Compressed.Levels.clear( );
+		}
+		WriteTexCache( name, tex.Texels, tex.Width, tex.Height, tex.Mips, tex.Compressed, pipe.Filter, pipe.Encoding );
+	}
+
+	tex.DecodeMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+	tex.StagingBytes = GetStagingBytes( tex );
+
+	std::lock_guard<std::mutex> lock( pipe.Lock );
+	pipe.StagingBytes += tex.StagingBytes;
+	if( pipe.StagingBytes > pipe.PeakStagingBytes )
+		pipe.PeakStagingBytes = pipe.StagingBytes;
+}
+
+
+// give back everything a texture held between its decode and its upload:
+
+static void
+FreeStaging( TexturePipeline &pipe, PipelineTexture &tex )
+{
+	delete [ ] tex.Texels;
+	tex.Texels = NULL;
+	std::vector<MipLevel>( ).swap( tex.Mips );
+	std::vector<BcLevel>( ).swap( tex.Compressed.Levels );
+	CloseTexCache( tex.Cache );
+
+	std::lock_guard<std::mutex> lock( pipe.Lock );
+	pipe.StagingBytes -= tex.StagingBytes;
+	tex.StagingBytes = 0;
+}
+
+
+// read, filter and compress texture i, or map its cache:
+// safe to call from any thread, for different textures at the same time
+
+void
+DecodePipelineTexture( TexturePipeline &pipe, int i )
+{
+	DecodeTexture( pipe, i );
+
+	std::lock_guard<std::mutex> lock( pipe.Lock );
+	pipe.NumDecoded++;
+}
+
+
+// upload one decoded texture to the bound GL_TEXTURE_2D: straight from its cache if it has one, else
+// block-compressed if it was compressed and the driver can take it, else as it was read
+// returns true if it went up block-compressed
+
+static bool
+UploadPipelineTexture( TexturePipeline &pipe, PipelineTexture &tex, const char *name )
+{
+	if( UploadTexCache( tex.Cache ) )
+	{
+		bool compressed = ( tex.Cache.Header.Format != GL_RGB );
+		CloseTexCache( tex.Cache );
+		return compressed;
+	}
+
+	// a compressed cache the driver can't take has to be rebuilt uncompressed:
+
+	bool rebuilt = ! tex.Cache.Levels.empty( );
+	if( rebuilt )
+	{
+		CloseTexCache( tex.Cache );
+		tex.Texels = BmpToTexture( name, &tex.Width, &tex.Height );
+		BuildMipChain( tex.Texels, tex.Width, tex.Height, pipe.Filter, tex.Mips );
+	}
+
+	if( UploadBcTexture( tex.Compressed ) )
+		return true;
+
+	UploadMipChain( tex.Texels, tex.Width, tex.Height, tex.Mips );
+
+	// blocks the driver couldn't take are cached as RGB, so the next launch doesn't build them again:
+
+	if( rebuilt  ||  ! tex.Compressed.Levels.empty( ) )
+		WriteTexCache( name, tex.Texels, tex.Width, tex.Height, tex.Mips, BcTexture( ), pipe.Filter, TEXCACHE_NOS3TC );
+	return false;
+}
+
+
+// the number of levels in a whole mipmap chain, down to 1x1:
+
+static int
+GetNumMipLevels( int width, int height )
+{
+	int n = 1;
+	while( width > 1  ||  height > 1 )
+	{
+		width = ( width > 1 ) ? width / 2 : 1;
+		height = ( height > 1 ) ? height / 2 : 1;
+		n++;
+	}
+	return n;
+}
+
+
+static GLsizei
+GetBc1Bytes( int width, int height )
+{
+	return (GLsizei)( 8 * ( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) );
+}
+
+
+static size_t
+GetLevelBytes( GLenum format, int width, int height )
+{
+	return ( format == GL_RGB ) ? 3 * (size_t)width * height : (size_t)GetBc1Bytes( width, height );
+}
+
+
+// what a whole mipmap chain takes on the gpu, as it is handed to the driver
+// (which may well pad RGB out to RGBA):
+
+static size_t
+GetChainBytes( GLenum format, int width, int height )
+{
+	size_t bytes = 0;
+	int numLevels = GetNumMipLevels( width, height );
+	for( int level = 0; level < numLevels; level++ )
+	{
+		bytes += GetLevelBytes( format, width, height );
+		width = ( width > 1 ) ? width / 2 : 1;
+		height = ( height > 1 ) ? height / 2 : 1;
+	}
+	return bytes;
+}
+
+
+// where each of a decoded texture's levels is, and what format they are in:
+// returns false if it has none
+
+static bool
+GetTextureLevels( const PipelineTexture &tex, GLenum *format, std::vector<const unsigned char *> &data )
+{
+	data.clear( );
+	if( ! tex.Cache.Levels.empty( ) )
+	{
+		*format = tex.Cache.Header.Format;
+		for( size_t i = 0; i < tex.Cache.Levels.size(); i++ )
+			data.push_back( (const unsigned char *)tex.Cache.File.Data + tex.Cache.Levels[i].Offset );
+	}
+	else if( ! tex.Compressed.Levels.empty( ) )
+	{
+		*format = tex.Compressed.Format;
+		for( size_t i = 0; i < tex.Compressed.Levels.size(); i++ )
+			data.push_back( &tex.Compressed.Levels[i].Blocks[0] );
+	}
+	else if( tex.Texels != NULL )
+	{
+		*format = GL_RGB;
+		data.push_back( tex.Texels );
+		for( size_t i = 0; i < tex.Mips.size(); i++ )
+			data.push_back( &tex.Mips[i].Texels[0] );
+	}
+	return ! data.empty( );
+}
+
+
+// sort the decoded textures into one texture array for each size, in the order of their descriptors,
+// and pick each array's format: BC1 only if the textures are being compressed, the driver can take it,
+// and every layer came out of the encoder as BC1 rather than too lossy
+
+static void
+GroupPipelineArrays( TexturePipeline &pipe )
+{
+	GLenum format = GL_RGB;
+	if( pipe.Encoding != TEXCACHE_UNCOMPRESSED  &&  GLEW_EXT_texture_compression_s3tc )
+		format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+	pipe.Arrays.clear( );
+	for( int i = 0; i < pipe.NumTextures; i++ )
+	{
+		PipelineTexture &tex = pipe.Textures[i];
+		tex.Array = tex.Layer = -1;
+
+		GLenum have;
+		std::vector<const unsigned char *> data;
+		if( ! GetTextureLevels( tex, &have, data )  ||  (int)data.size() != GetNumMipLevels( tex.Width, tex.Height ) )
+			continue;
+
+		size_t a = 0;
+		while( a < pipe.Arrays.size()  &&  ( pipe.Arrays[a].Width != tex.Width  ||  pipe.Arrays[a].Height != tex.Height ) )
+			a++;
+		if( a == pipe.Arrays.size() )
+		{
+			PipelineArray array;
+			array.Name = 0;
+			array.Unit = pipe.ArrayUnit + (int)a;
+			array.Width = tex.Width;
+			array.Height = tex.Height;
+			array.Format = format;
+			pipe.Arrays.push_back( array );
+		}
+
+		PipelineArray &array = pipe.Arrays[a];
+		if( have == GL_RGB )
+			array.Format = GL_RGB;
+		tex.Array = (int)a;
+		tex.Layer = (int)array.Textures.size();
+		array.Textures.push_back( i );
+	}
+}
+
+
+// make a texture array with room for every layer and level, and leave it bound to its unit:
+
+static void
+AllocatePipelineArray( TexturePipeline &pipe, PipelineArray &array )
+{
+	const TextureDesc &first = pipe.Descs[ array.Textures[0] ];
+	int numLayers = (int)array.Textures.size();
+	int numLevels = GetNumMipLevels( array.Width, array.Height );
+
+	glGenTextures( 1, &array.Name );
+	glActiveTexture( GL_TEXTURE0 + array.Unit );
+	glBindTexture( GL_TEXTURE_2D_ARRAY, array.Name );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, first.Wrap );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, first.Wrap );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, first.MagFilter );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, numLevels - 1 );
+
+	int width = array.Width, height = array.Height;
+	for( int level = 0; level < numLevels; level++ )
+	{
+		if( array.Format == GL_RGB )
+			glTexImage3D( GL_TEXTURE_2D_ARRAY, level, GL_RGB8, width, height, numLayers, 0,
+				GL_RGB, GL_UNSIGNED_BYTE, NULL );
+		else
+			glCompressedTexImage3D( GL_TEXTURE_2D_ARRAY, level, array.Format, width, height, numLayers, 0,
+				GetBc1Bytes( width, height ) * numLayers, NULL );
+		width = ( width > 1 ) ? width / 2 : 1;
+		height = ( height > 1 ) ? height / 2 : 1;
+	}
+}
+
+
+// how many bytes a whole chain takes in a pixel buffer slot, each level starting on an aligned offset:
+
+static size_t
+GetRingBytes( GLenum format, int width, int height )
+{
+	size_t bytes = 0;
+	int numLevels = GetNumMipLevels( width, height );
+	for( int level = 0; level < numLevels; level++ )
+	{
+		bytes = RingLevelOffset( bytes ) + GetLevelBytes( format, width, height );
+		width = ( width > 1 ) ? width / 2 : 1;
+		height = ( height > 1 ) ? height / 2 : 1;
+	}
+	return bytes;
+}
+
+
+// the format texture tex is to be staged in a ring slot in:
+// returns false if it can't go through the ring - it has nothing to upload, holds blocks the driver
+// can't take (those are rebuilt on the gl thread), or won't fit in a slot
+
+static bool
+GetStagedFormat( const TexturePipeline &pipe, const PipelineTexture &tex, GLenum *format )
+{
+	GLenum have;
+	std::vector<const unsigned char *> data;
+	if( ! GetTextureLevels( tex, &have, data )  ||  (int)data.size() != GetNumMipLevels( tex.Width, tex.Height ) )
+		return false;
+
+	if( pipe.UseArrays )
+	{
+		if( tex.Array < 0 )
+			return false;
+		*format = pipe.Arrays[ tex.Array ].Format;
+	}
+	else
+	{
+		if( have != GL_RGB  &&  ! GLEW_EXT_texture_compression_s3tc )
+			return false;
+		*format = have;
+	}
+
+	return GetRingBytes( *format, tex.Width, tex.Height ) <= pipe.Ring->SlotBytes;
+}
+
+
+// copy a decoded texture's levels into its ring slot in format, decompressing them if they aren't
+// in it already, each level on an aligned offset:
+
+static void
+StageTexture( TexturePipeline &pipe, PipelineTexture &tex, GLenum format )
+{
+	GLenum have;
+	std::vector<const unsigned char *> data;
+	GetTextureLevels( tex, &have, data );
+
+	unsigned char *slot = GetRingSlot( *pipe.Ring, tex.Slot );
+	size_t offset = 0;
+	int width = tex.Width, height = tex.Height;
+	for( size_t level = 0; level < data.size(); level++ )
+	{
+		size_t bytes = GetLevelBytes( format, width, height );
+		unsigned char *staged = slot + RingLevelOffset( offset );
+		if( have != format )
+			DecompressBc1( data[level], width, height, staged );
+		else
+			memcpy( staged, data[level], bytes );
+
+		offset = RingLevelOffset( offset ) + bytes;
+		width = ( width > 1 ) ? width / 2 : 1;
+		height = ( height > 1 ) ? height / 2 : 1;
+	}
+}
+
+
+// on a worker thread, once every texture has been decoded: hand each one to the gl thread, first copying
+// it into a free slot of the ring if there is one
+// (this waits for StartPipelineUploads( ), for the texture arrays to be made and for slots to come free,
+// so the gl thread has to keep calling UploadPipelineTextures( ) meanwhile; StopTexturePipeline( ) ends it)
+
+void
+StagePipelineTextures( TexturePipeline &pipe )
+{
+	std::unique_lock<std::mutex> lock( pipe.Lock );
+	if( pipe.NumTextures == 0 )
+		return;
+
+	pipe.Changed.wait( lock, [&]( ) { return pipe.Stopping  ||  ( pipe.Started  &&  ( pipe.Grouped  ||  ! pipe.UseArrays ) ); } );
+
+	for( int i = 0; i < pipe.NumTextures  &&  ! pipe.Stopping; i++ )
+	{
+		PipelineTexture &tex = pipe.Textures[i];
+		GLenum format;
+		if( pipe.Ring != NULL  &&  GetStagedFormat( pipe, tex, &format ) )
+		{
+			std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+			pipe.Changed.wait( lock, [&]( ) { return pipe.Stopping  ||  ! pipe.FreeSlots.empty( ); } );
+			pipe.SlotWaitMs += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+			if( pipe.Stopping )
+				break;
+
+			tex.Slot = pipe.FreeSlots.back( );
+			pipe.FreeSlots.pop_back( );
+
+			lock.unlock( );
+			StageTexture( pipe, tex, format );
+			lock.lock( );
+		}
+		pipe.Ready.push_back( i );
+	}
+}
+
+
+// issue the gl calls that upload a texture's levels in format - into its layer of its texture array,
+// which must be bound, or else into the bound GL_TEXTURE_2D - from pixels (pointers into client memory,
+// or offsets into the bound pixel buffer):
+
+static void
+UploadLevels( TexturePipeline &pipe, PipelineTexture &tex, GLenum format, const std::vector<const GLvoid *> &pixels )
+{
+	GLint alignment;
+	glGetIntegerv( GL_UNPACK_ALIGNMENT, &alignment );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+	int width = tex.Width, height = tex.Height;
+	for( size_t i = 0; i < pixels.size(); i++ )
+	{
+		GLint level = (GLint)i;
+		GLsizei bytes = (GLsizei)GetLevelBytes( format, width, height );
+		if( pipe.UseArrays  &&  format == GL_RGB )
+			glTexSubImage3D( GL_TEXTURE_2D_ARRAY, level, 0, 0, tex.Layer, width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, pixels[i] );
+		else if( pipe.UseArrays )
+			glCompressedTexSubImage3D( GL_TEXTURE_2D_ARRAY, level, 0, 0, tex.Layer, width, height, 1, format, bytes, pixels[i] );
+		else if( format == GL_RGB )
+			glTexImage2D( GL_TEXTURE_2D, level, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels[i] );
+		else
+			glCompressedTexImage2D( GL_TEXTURE_2D, level, format, width, height, 0, bytes, pixels[i] );
+
+		width = ( width > 1 ) ? width / 2 : 1;
+		height = ( height > 1 ) ? height / 2 : 1;
+	}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, alignment );
+
+	if( ! pipe.UseArrays )
+	{
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)pixels.size() - 1 );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pixels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	}
+}
+
+
+// upload a texture the stager put into a ring slot, in format, then fence the slot so that it is only
+// handed back to the stager once the gpu is done reading it:
+
+static void
+UploadSlotTexture( TexturePipeline &pipe, PipelineTexture &tex, GLenum format )
+{
+	UploadRing &ring = *pipe.Ring;
+	const unsigned char *slot = GetRingSlot( ring, tex.Slot );
+
+	std::vector<const GLvoid *> pixels;
+	size_t offset = 0;
+	int width = tex.Width, height = tex.Height;
+	int numLevels = GetNumMipLevels( width, height );
+	for( int level = 0; level < numLevels; level++ )
+	{
+		pixels.push_back( RingOffset( ring, slot + RingLevelOffset( offset ) ) );
+		offset = RingLevelOffset( offset ) + GetLevelBytes( format, width, height );
+		width = ( width > 1 ) ? width / 2 : 1;
+		height = ( height > 1 ) ? height / 2 : 1;
+	}
+
+	BeginRingUpload( ring, tex.Slot );
+	UploadLevels( pipe, tex, format, pixels );
+	EndRingUpload( ring );
+
+	pipe.FencedSlots.push_back( tex.Slot );
+	tex.Slot = -1;
+}
+
+
+// upload one decoded texture's levels from client memory into its layer of its texture array, which
+// must be bound, decompressing them if the array is RGB and they aren't:
+// returns false if there was nothing to upload
+
+static bool
+UploadPipelineLayer( TexturePipeline &pipe, PipelineTexture &tex, GLenum format )
+{
+	GLenum have;
+	std::vector<const unsigned char *> data;
+	if( ! GetTextureLevels( tex, &have, data ) )
+		return false;
+
+	std::vector< std::vector<unsigned char> > converted( data.size() );
+	std::vector<const GLvoid *> pixels;
+	int width = tex.Width, height = tex.Height;
+	for( size_t level = 0; level < data.size(); level++ )
+	{
+		if( have != format )
+		{
+			converted[level].resize( GetLevelBytes( format, width, height ) );
+			DecompressBc1( data[level], width, height, &converted[level][0] );
+			pixels.push_back( &converted[level][0] );
+		}
+		else
+		{
+			pixels.push_back( data[level] );
+		}
+		width = ( width > 1 ) ? width / 2 : 1;
+		height = ( height > 1 ) ? height / 2 : 1;
+	}
+
+	UploadLevels( pipe, tex, format, pixels );
+	return true;
+}
+
+
+// upload decoded texture i - into its layer of its texture array if there are arrays, else into its own
+// texture object, left bound to its unit - from its ring slot if the stager put it in one, log how it
+// went, and free what it was staged in
+
+static void
+UploadTexture( TexturePipeline &pipe, int i )
+{
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+
+	const TextureDesc &desc = pipe.Descs[i];
+	PipelineTexture &tex = pipe.Textures[i];
+	bool cached = ! tex.Cache.Levels.empty( );
+
+	bool compressed = false;
+	if( pipe.UseArrays )
+	{
+		if( tex.Array < 0 )
+		{
+			fprintf( stderr, "Texture '%s' has nothing to put in a texture array\n", desc.File );
+			FreeStaging( pipe, tex );
+			return;
+		}
+
+		const PipelineArray &array = pipe.Arrays[ tex.Array ];
+		glActiveTexture( GL_TEXTURE0 + array.Unit );
+		glBindTexture( GL_TEXTURE_2D_ARRAY, array.Name );
+		if( tex.Slot >= 0 )
+			UploadSlotTexture( pipe, tex, array.Format );
+		else
+			UploadPipelineLayer( pipe, tex, array.Format );
+		compressed = ( array.Format != GL_RGB );
+		tex.GpuBytes = GetChainBytes( array.Format, array.Width, array.Height );
+	}
+	else
+	{
+		glGenTextures( 1, desc.Name );
+		glActiveTexture( GL_TEXTURE0 + desc.Unit );
+		glBindTexture( GL_TEXTURE_2D, *desc.Name );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, desc.Wrap );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, desc.Wrap );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.MagFilter );
+		if( tex.Slot >= 0 )
+		{
+			GLenum format;
+			std::vector<const unsigned char *> data;
+			GetTextureLevels( tex, &format, data );
+			UploadSlotTexture( pipe, tex, format );
+			compressed = ( format != GL_RGB );
+		}
+		else
+		{
+			compressed = UploadPipelineTexture( pipe, tex, desc.File );
+		}
+		tex.GpuBytes = GetChainBytes( compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGB, tex.Width, tex.Height );
+	}
+
+	tex.UploadMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+
+	fprintf( stderr, "Texture '%s' %d x %d: decoded in %.1f ms (%s", desc.File, tex.Width, tex.Height, tex.DecodeMs,
+		cached ? "from its cache" : "from the bmp" );
+	if( ! cached  &&  tex.Compressed.Psnr > 0. )
+		fprintf( stderr, ", BC1 at %.2f dB%s", tex.Compressed.Psnr, tex.Compressed.Levels.empty( ) ? " is too lossy" : "" );
+	fprintf( stderr, "), uploaded %s", compressed ? "as BC1" : "as RGB" );
+	if( pipe.UseArrays )
+		fprintf( stderr, " into layer %d on unit %d", tex.Layer, pipe.Arrays[ tex.Array ].Unit );
+	fprintf( stderr, " in %.2f ms, %d KB\n", tex.UploadMs, (int)( tex.GpuBytes / 1024 ) );
+
+	FreeStaging( pipe, tex );
+}
+
+
+// on the gl thread, once it has a context: start taking textures from the stager, staged through ring
+// if it isn't NULL (and was made), else straight from client memory
+
+void
+StartPipelineUploads( TexturePipeline &pipe, UploadRing *ring )
+{
+	{
+		std::lock_guard<std::mutex> lock( pipe.Lock );
+		pipe.Ring = ( ring != NULL  &&  ring->Data != NULL ) ? ring : NULL;
+		pipe.FreeSlots.clear( );
+		for( int slot = ( pipe.Ring != NULL ) ? (int)ring->Slots.size() - 1 : -1; slot >= 0; slot-- )
+			pipe.FreeSlots.push_back( slot );
+		pipe.Started = true;
+	}
+	pipe.Changed.notify_all( );
+}
+
+
+// on the gl thread, once a frame after StartPipelineUploads( ): hand the stager back the slots the gpu
+// is done reading, make the texture arrays once every texture has been decoded, and upload whatever
+// has been staged since the last call - never waiting for any of it
+// returns true once every texture is up, and from then on the pipeline no longer uses the ring
+// (texture arrays have to wait for every texture, since their sizes and formats depend on all of them)
+
+bool
+UploadPipelineTextures( TexturePipeline &pipe )
+{
+	if( ! pipe.Started )
+		return false;
+	if( pipe.NumUploaded == pipe.NumTextures )
+		return true;
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now( );
+
+	std::vector<int> done;
+	for( size_t k = 0; k < pipe.FencedSlots.size(); )
+	{
+		if( IsRingSlotDone( *pipe.Ring, pipe.FencedSlots[k] ) )
+		{
+			done.push_back( pipe.FencedSlots[k] );
+			pipe.FencedSlots.erase( pipe.FencedSlots.begin() + k );
+		}
+		else
+		{
+			k++;
+		}
+	}
+
+	std::vector<int> ready;
+	bool group;
+	{
+		std::lock_guard<std::mutex> lock( pipe.Lock );
+		pipe.FreeSlots.insert( pipe.FreeSlots.end(), done.begin(), done.end() );
+		group = ( pipe.UseArrays  &&  ! pipe.Grouped  &&  pipe.NumDecoded == pipe.NumTextures );
+		ready.swap( pipe.Ready );
+	}
+
+	if( group )
+	{
+		GroupPipelineArrays( pipe );
+		for( size_t a = 0; a < pipe.Arrays.size(); a++ )
+		{
+			PipelineArray &array = pipe.Arrays[a];
+			AllocatePipelineArray( pipe, array );
+			fprintf( stderr, "Texture array %d x %d on unit %d: %d layers as %s, %d KB\n", array.Width, array.Height, array.Unit,
+				(int)array.Textures.size(), array.Format == GL_RGB ? "RGB" : "BC1",
+				(int)( array.Textures.size() * GetChainBytes( array.Format, array.Width, array.Height ) / 1024 ) );
+		}
+
+		std::lock_guard<std::mutex> lock( pipe.Lock );
+		pipe.Grouped = true;
+	}
+	if( group  ||  ! done.empty( ) )
+		pipe.Changed.notify_all( );
+
+	for( size_t k = 0; k < ready.size(); k++ )
+		UploadTexture( pipe, ready[k] );
+	pipe.NumUploaded += (int)ready.size();
+
+	if( group  ||  ! ready.empty( ) )
+	{
+		glActiveTexture( GL_TEXTURE0 );
+		pipe.UploadFrames++;
+	}
+	pipe.UploadMs += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now( ) - t0 ).count( );
+
+	if( pipe.NumUploaded < pipe.NumTextures )
+		return false;
+
+	// the last fences are left in the ring, for FreeUploadRing( ) to delete:
+
+	size_t gpuBytes = 0;
+	for( int i = 0; i < pipe.NumTextures; i++ )
+		gpuBytes += pipe.Textures[i].GpuBytes;
+
+	std::lock_guard<std::mutex> lock( pipe.Lock );
+	pipe.Ring = NULL;
+	pipe.FreeSlots.clear( );
+	pipe.FencedSlots.clear( );
+
+	fprintf( stderr, "Textures uploaded over %d frames, in %.2f ms on the gl thread: %d KB on the gpu, at most %d KB staged",
+		pipe.UploadFrames, pipe.UploadMs, (int)( gpuBytes / 1024 ), (int)( pipe.PeakStagingBytes / 1024 ) );
+	if( pipe.SlotWaitMs > 0. )
+		fprintf( stderr, ", %.1f ms waiting for pixel buffer slots", pipe.SlotWaitMs );
+	fprintf( stderr, "\n" );
+	return true;
+}
+
+
+// on the gl thread: make StagePipelineTextures( ) give up, wherever it is waiting
+
+void
+StopTexturePipeline( TexturePipeline &pipe )
+{
+	{
+		std::lock_guard<std::mutex> lock( pipe.Lock );
+		pipe.Stopping = true;
+	}
+	pipe.Changed.notify_all( );
+}
+
+
+// on the gl thread: take texture i off the gpu, deleting its texture object
+// (a texture array can't give back one layer, so its textures only go with EvictPipelineArray( )):
+// returns false if it wasn't evicted
+
+bool
+EvictPipelineTexture( TexturePipeline &pipe, int i )
+{
+	const TextureDesc &desc = pipe.Descs[i];
+	if( pipe.UseArrays  ||  *desc.Name == 0 )
+		return false;
+
+	glDeleteTextures( 1, desc.Name );
+	*desc.Name = 0;
+	pipe.Textures[i].GpuBytes = 0;
+	return true;
+}
+
+
+// on the gl thread: decode and upload texture i again, after it was evicted
+// (from its cache this is only a map and an upload, but it still stalls the frame it happens in;
+// a texture that hasn't been uploaded the first time yet is left to UploadPipelineTextures( ))
+
+void
+ReloadPipelineTexture( TexturePipeline &pipe, int i )
+{
+	if( pipe.UseArrays  ||  pipe.NumUploaded < pipe.NumTextures  ||  *pipe.Descs[i].Name != 0 )
+		return;
+
+	DecodeTexture( pipe, i );
+	UploadTexture( pipe, i );
+}
+
+
+// on the gl thread: take texture array a, and with it every one of its layers, off the gpu
+// (not before every texture is up, since the stager may still be filling it):
+// returns false if it wasn't evicted
+
+bool
+EvictPipelineArray( TexturePipeline &pipe, int a )
+{
+	PipelineArray &array = pipe.Arrays[a];
+	if( array.Name == 0  ||  pipe.NumUploaded < pipe.NumTextures )
+		return false;
+
+	glDeleteTextures( 1, &array.Name );
+	array.Name = 0;
+	for( size_t k = 0; k < array.Textures.size(); k++ )
+		pipe.Textures[ array.Textures[k] ].GpuBytes = 0;
+	return true;
+}
+
+
+// on the gl thread: make texture array a again after it was evicted, and decode and upload every
+// one of its layers back into it, leaving it bound to its unit
+// (a layer whose .bmp has since changed size is left out, and stays black until the next run)
+
+void
+ReloadPipelineArray( TexturePipeline &pipe, int a )
+{
+	PipelineArray &array = pipe.Arrays[a];
+	if( array.Name != 0  ||  pipe.NumUploaded < pipe.NumTextures )
+		return;
+
+	AllocatePipelineArray( pipe, array );
+	for( size_t k = 0; k < array.Textures.size(); k++ )
+	{
+		int i = array.Textures[k];
+		PipelineTexture &tex = pipe.Textures[i];
+		DecodeTexture( pipe, i );
+		if( tex.Width != array.Width  ||  tex.Height != array.Height )
+		{
+			fprintf( stderr, "Texture '%s' is now %d x %d, and no longer fits its texture array\n", pipe.Descs[i].File, tex.Width, tex.Height );
+			FreeStaging( pipe, tex );
+			continue;
+		}
+		UploadTexture( pipe, i );
+	}
+	glActiveTexture( GL_TEXTURE0 );
+}
+
+
+// on the gl thread: delete every texture object the pipeline made and free anything still staged
+// (after StopTexturePipeline( ), once nothing can be decoding or staging any more)
+
+void
+FreeTexturePipeline( TexturePipeline &pipe )
+{
+	for( int i = 0; i < pipe.NumTextures; i++ )
+	{
+		FreeStaging( pipe, pipe.Textures[i] );
+		EvictPipelineTexture( pipe, i );
+		pipe.Textures[i].Slot = -1;
+	}
+	pipe.Ring = NULL;
+	pipe.FreeSlots.clear( );
+	pipe.FencedSlots.clear( );
+
+	for( size_t a = 0; a < pipe.Arrays.size(); a++ )
+	{
+		PipelineArray &array = pipe.Arrays[a];
+		glDeleteTextures( 1, &array.Name );
+		for( size_t k = 0; k < array.Textures.size(); k++ )
+		{
+			PipelineTexture &tex = pipe.Textures[ array.Textures[k] ];
+			tex.GpuBytes = 0;
+			tex.Array = tex.Layer = -1;
+		}
+	}
+	pipe.Arrays.clear( );
+}
@@ -0,0 +1,149 @@
+/*****************************************************************
+* Description: Gets a list of .bmp textures from disk onto the gpu,
+*              decoding on worker threads while the gl thread uploads.
+*
+*              Each texture is described by a TextureDesc. Worker
+*              threads call DecodePipelineTexture( ) for each of them,
+*              in any order: that maps the texture's cache if it has an
+*              up to date one, else reads the .bmp, builds its mipmap
+*              chain, block-compresses it and writes the cache for next
+*              time. Then one of them calls StagePipelineTextures( ),
+*              which hands the decoded textures to the gl thread. None
+*              of that calls OpenGL.
+*
+*              Once it has a context, the gl thread calls
+*              StartPipelineUploads( ), and from then on
+*              UploadPipelineTextures( ) once a frame until it returns
+*              true. Each call uploads whatever has been handed over
+*              since the last one - making each texture's object,
+*              setting its wrap and filters and leaving it bound to its
+*              texture unit - and returns at once, so the program draws
+*              while the textures arrive (untextured until then). Each
+*              texture's decode and upload times are logged to stderr.
+*
+*              After SetPipelineTextureArrays( ), the textures go into
+*              the layers of GL_TEXTURE_2D_ARRAYs instead, one array
+*              for each texture size, each bound to its own unit, so
+*              that drawing with any of them needs only a unit and a
+*              layer number and never a new binding. The arrays are
+*              made once every texture has been decoded: each takes
+*              the wrap and filter of its first texture, and is BC1
+*              only if every one of its layers came out of the encoder
+*              well enough - a single layer that is too lossy leaves
+*              the whole array RGB. Nothing is resampled.
+*
+*              Everything a texture is decoded into is freed as soon as
+*              it has been uploaded. The pipeline keeps count of the
+*              bytes each texture holds on the cpu until then and on
+*              the gpu afterwards; EvictPipelineTexture( ) and
+*              ReloadPipelineTexture( ) take one off the gpu and put it
+*              back - or, with texture arrays, EvictPipelineArray( ) and
+*              ReloadPipelineArray( ) do that for a whole array - and
+*              FreeTexturePipeline( ) deletes them all.
+*
+*              If StartPipelineUploads( ) is given a ring of
+*              persistently mapped pixel buffers, StagePipelineTextures( )
+*              copies (or decompresses) each texture straight into a
+*              free slot of it, so all the gl thread does is a few calls
+*              that return at once and a fence, rather than wait for
+*              the driver to copy the decoded texels. A slot is handed
+*              back to the stager once its fence has signalled. The
+*              pipeline lets go of the ring as soon as every texture is
+*              up, so that it can be freed: nothing staged after that
+*              (a reload) goes through it.
+*/
+
+#pragma once
+#ifndef TEXTUREPIPELINE_H
+#define TEXTUREPIPELINE_H
+
+#include "glew.h"
+#include <GL/gl.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "blockcompress.h"
+#include "mipmaps.h"
+#include "texcache.h"
+#include "uploadring.h"
+
+struct TextureDesc
+{
+	const char *	File;		// the .bmp file
+	GLint		Wrap;		// for both s and t: GL_REPEAT, GL_CLAMP, ...
+	GLint		MagFilter;	// GL_LINEAR or GL_NEAREST (minification is always trilinear)
+	int		Unit;		// the texture unit it is left bound to
+	GLuint *	Name;		// where its texture object's name goes
+};
+
+struct PipelineArray
+{
+	GLuint			Name;
+	int			Unit;		// the texture unit it is left bound to
+	int			Width, Height;	// of every layer
+	GLenum			Format;		// GL_COMPRESSED_RGB_S3TC_DXT1_EXT or GL_RGB
+	std::vector<int>	Textures;	// the texture in each layer
+};
+
+struct PipelineTexture
+{
+	unsigned char *		Texels;		// level 0 as RGB, if it had to be read from the .bmp
+	int			Width, Height;
+	std::vector<MipLevel>	Mips;		// levels 1, 2, ... (level 0 is Texels)
+	BcTexture		Compressed;	// all of the levels as BC1 blocks, if they were compressed
+	TexCache		Cache;		// all of the levels, ready to upload, if they were cached
+	double			DecodeMs;
+	double			UploadMs;
+	size_t			StagingBytes;	// cpu memory held from its decode until its upload
+	size_t			GpuBytes;	// its levels on the gpu, 0 if it isn't there
+	int			Array, Layer;	// where it went, if the pipeline uses texture arrays (-1 if nowhere)
+	int			Slot;		// the ring slot its levels are staged in, or -1
+};
+
+struct TexturePipeline
+{
+	const TextureDesc *		Descs;
+	int				NumTextures;
+	int				Filter;		// MIPBOX, MIPKAISER or MIPLANCZOS
+	int				Encoding;	// BCFAST, BCQUALITY or TEXCACHE_UNCOMPRESSED
+	std::vector<PipelineTexture>	Textures;
+
+	bool				UseArrays;	// put them into texture arrays, rather than one texture each
+	int				ArrayUnit;	// the texture unit the first array is left bound to
+	std::vector<PipelineArray>	Arrays;		// one for each texture size, once every texture is decoded
+	UploadRing *			Ring;		// the pixel buffers uploads are staged through, or NULL
+
+	std::mutex			Lock;		// guards Ring and everything from here to SlotWaitMs
+	std::condition_variable		Changed;	// signalled when the gl thread starts, stops, makes the arrays or frees a slot
+	bool				Started;	// StartPipelineUploads( ) has been called
+	bool				Stopping;	// StopTexturePipeline( ) has been called
+	bool				Grouped;	// the texture arrays have been made, if there are to be any
+	int				NumDecoded;
+	std::vector<int>		Ready;		// staged, waiting to be uploaded
+	std::vector<int>		FreeSlots;	// ring slots the stager may write into
+	size_t				StagingBytes;	// held by all of the textures now
+	size_t				PeakStagingBytes;
+	double				SlotWaitMs;	// how long the stager waited for a free slot
+
+	int				NumUploaded;	// or found to have nothing to upload (gl thread only, like the rest)
+	std::vector<int>		FencedSlots;	// uploaded from, until the gpu is done reading them
+	double				UploadMs;	// time spent in UploadPipelineTextures( )
+	int				UploadFrames;	// how many of its calls had something to do
+};
+
+void	DecodePipelineTexture( TexturePipeline &, int );
+bool	EvictPipelineArray( TexturePipeline &, int );
+bool	EvictPipelineTexture( TexturePipeline &, int );
+void	FreeTexturePipeline( TexturePipeline & );
+void	InitTexturePipeline( TexturePipeline &, const TextureDesc *, int, int, int );
+void	ReloadPipelineArray( TexturePipeline &, int );
+void	ReloadPipelineTexture( TexturePipeline &, int );
+void	SetPipelineTextureArrays( TexturePipeline &, int );
+void	StagePipelineTextures( TexturePipeline & );
+void	StartPipelineUploads( TexturePipeline &, UploadRing * );
+void	StopTexturePipeline( TexturePipeline & );
+bool	UploadPipelineTextures( TexturePipeline & );
+
+#endif
@@ -0,0 +1,161 @@
+#include "uploadring.h"
+
+#include <stdio.h>
+
+
+// make a ring of numSlots slots of slotBytes each:
+// returns false (and leaves the ring empty) if the driver can't map a buffer persistently
+
+bool
+InitUploadRing( UploadRing &ring, int numSlots, size_t slotBytes )
+{
+	ring.Buffer = 0;
+	ring.Data = NULL;
+	ring.SlotBytes = ( slotBytes + UPLOADRING_ALIGN - 1 ) / UPLOADRING_ALIGN * UPLOADRING_ALIGN;
+	ring.Slots.clear( );
+	ring.Current = -1;
+	ring.Uploads = 0;
+
+	if( numSlots <= 0  ||  slotBytes == 0 )
+		return false;
+
+	if( ! ( GLEW_VERSION_4_4  ||  GLEW_ARB_buffer_storage )  ||  ! GLEW_ARB_sync )
+	{
+		fprintf( stderr, "No persistently mapped buffers: textures will be uploaded from client memory\n" );
+		return false;
+	}
+
+	GLsizeiptr size = (GLsizeiptr)( ring.SlotBytes * numSlots );
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers( 1, &ring.Buffer );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, ring.Buffer );
+	glBufferStorage( GL_PIXEL_UNPACK_BUFFER, size, NULL, flags );
+	ring.Data = (unsigned char *) glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, size, flags );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+	if( ring.Data == NULL )
+	{
+		fprintf( stderr, "Cannot map a %d KB pixel buffer: textures will be uploaded from client memory\n", (int)( size / 1024 ) );
+		glDeleteBuffers( 1, &ring.Buffer );
+		ring.Buffer = 0;
+		return false;
+	}
+
+	ring.Slots.resize( numSlots );
+	for( int i = 0; i < numSlots; i++ )
+	{
+		ring.Slots[i].Offset = ring.SlotBytes * i;
+		ring.Slots[i].Fence = NULL;
+	}
+	return true;
+}
+
+
+// where slot i is mapped, for any thread to write texels into:
+
+unsigned char *
+GetRingSlot( const UploadRing &ring, int i )
+{
+	return ring.Data + ring.Slots[i].Offset;
+}
+
+
+// bind the ring as the GL_PIXEL_UNPACK_BUFFER, to upload from what was written into slot i:
+
+void
+BeginRingUpload( UploadRing &ring, int i )
+{
+	if( ring.Data == NULL  ||  ring.Current >= 0 )
+		return;
+
+	ring.Current = i;
+	ring.Uploads++;
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, ring.Buffer );
+}
+
+
+// the gl calls reading the slot have all been issued: fence it and unbind the ring
+
+void
+EndRingUpload( UploadRing &ring )
+{
+	if( ring.Current < 0 )
+		return;
+
+	UploadSlot &slot = ring.Slots[ ring.Current ];
+	if( slot.Fence != NULL )
+		glDeleteSync( slot.Fence );
+	slot.Fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	ring.Current = -1;
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+}
+
+
+// has the gpu finished reading everything uploaded from slot i, so that it can be written again?
+// (never waits, but does flush, so that the fence is sure to reach the gpu)
+
+bool
+IsRingSlotDone( UploadRing &ring, int i )
+{
+	UploadSlot &slot = ring.Slots[i];
+	if( slot.Fence == NULL )
+		return true;
+
+	if( glClientWaitSync( slot.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 ) == GL_TIMEOUT_EXPIRED )
+		return false;
+
+	glDeleteSync( slot.Fence );
+	slot.Fence = NULL;
+	return true;
+}
+
+
+// what to pass to glTexImage*( ) in place of the pointer to texels written into the bound slot:
+
+const GLvoid *
+RingOffset( const UploadRing &ring, const unsigned char *texels )
+{
+	return (const GLvoid *)(size_t)( texels - ring.Data );
+}
+
+
+// where the next level goes in a slot, if the levels so far took bytes:
+
+size_t
+RingLevelOffset( size_t bytes )
+{
+	return ( bytes + UPLOADRING_ALIGN - 1 ) / UPLOADRING_ALIGN * UPLOADRING_ALIGN;
+}
+
+
+void
+FreeUploadRing( UploadRing &ring )
+{
+	for( size_t i = 0; i < ring.Slots.size(); i++ )
+	{
+		if( ring.Slots[i].Fence != NULL )
+			glDeleteSync( ring.Slots[i].Fence );
+	}
+	ring.Slots.clear( );
+
+	if( ring.Buffer != 0 )
+	{
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, ring.Buffer );
+		glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+		glDeleteBuffers( 1, &ring.Buffer );
+	}
+	ring.Buffer = 0;
+	ring.Data = NULL;
+	ring.Current = -1;
+}
+
+
+void
+PrintUploadRing( const UploadRing &ring )
+{
+	if( ring.Data == NULL )
+		return;
+	fprintf( stderr, "Pixel buffer ring: %d slots of %d KB, %d uploads\n",
+		(int)ring.Slots.size(), (int)( ring.SlotBytes / 1024 ), ring.Uploads );
+}
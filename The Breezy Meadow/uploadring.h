@@ -0,0 +1,65 @@
+/*****************************************************************
+* Description: A ring of pixel buffer objects that texture uploads
+*              are staged through, so that the gl thread never waits
+*              while the driver copies texels out of client memory.
+*
+*              The ring is one GL_PIXEL_UNPACK_BUFFER, made with
+*              glBufferStorage( ) and mapped persistently, cut into
+*              equal slots. Any thread may write texels into a slot
+*              it has been given (GetRingSlot( )). The gl thread then
+*              binds the buffer with BeginRingUpload( ) and issues
+*              glTexImage*( )/glTexSubImage*( ) with offsets into it
+*              (RingOffset( )) instead of pointers. Those return at
+*              once; the gpu pulls the texels across on its own time.
+*              EndRingUpload( ) puts a fence behind them, and
+*              IsRingSlotDone( ) says, without waiting, when that
+*              fence has signalled and the slot can be written again.
+*              Which slot goes to whom is up to the caller.
+*
+*              Needs GL 4.4 or ARB_buffer_storage, and ARB_sync: on
+*              anything older InitUploadRing( ) returns false and the
+*              caller should upload from client memory as before.
+*
+*              Apart from GetRingSlot( ), uses GL, so call it from the
+*              thread that owns the context.
+*/
+
+#pragma once
+#ifndef UPLOADRING_H
+#define UPLOADRING_H
+
+#include "glew.h"
+#include <GL/gl.h>
+
+#include <stddef.h>
+#include <vector>
+
+#define UPLOADRING_ALIGN	16		// every RingLevelOffset( ) is a multiple of this
+
+struct UploadSlot
+{
+	size_t		Offset;			// of its first byte, from the start of the buffer
+	GLsync		Fence;			// behind the last upload from it, or NULL
+};
+
+struct UploadRing
+{
+	GLuint			Buffer;		// 0 if the ring could not be made
+	unsigned char *		Data;		// the whole buffer, mapped for as long as the ring lives
+	size_t			SlotBytes;
+	std::vector<UploadSlot>	Slots;
+	int			Current;	// the slot being uploaded from, or -1
+	int			Uploads;	// how many times a slot has been uploaded from
+};
+
+void		BeginRingUpload( UploadRing &, int );
+void		EndRingUpload( UploadRing & );
+void		FreeUploadRing( UploadRing & );
+unsigned char *	GetRingSlot( const UploadRing &, int );
+bool		InitUploadRing( UploadRing &, int, size_t );
+bool		IsRingSlotDone( UploadRing &, int );
+void		PrintUploadRing( const UploadRing & );
+const GLvoid *	RingOffset( const UploadRing &, const unsigned char * );
+size_t		RingLevelOffset( size_t );
+
+#endif
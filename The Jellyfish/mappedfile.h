@@ -0,0 +1,40 @@
+/*****************************************************************
+* Description: Read-only memory mapping of a whole file.
+*
+*              MapFile() maps the file so that it can be scanned in
+*              place without copying it through stdio. The data is
+*              NOT null terminated - always use Size to find the end.
+*              UnmapFile() releases the mapping.
+*
+*              GetSourceStamp() gets a file's size and modification
+*              time, which the caches built from a file keep so that
+*              they can tell when it has changed.
+*/
+
+#pragma once
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+struct MappedFile
+{
+	const char *	Data;		// first byte of the file (NULL if the file is empty)
+	size_t		Size;		// number of bytes in the file
+#ifdef WIN32
+	HANDLE		File;
+	HANDLE		Mapping;
+#else
+	int		Fd;
+#endif
+};
+
+bool	GetSourceStamp( const char *, unsigned long long *, long long * );
+bool	MapFile( const char *, MappedFile * );
+void	UnmapFile( MappedFile * );
+
+#endif
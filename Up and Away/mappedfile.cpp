@@ -0,0 +1,127 @@
+#include "mappedfile.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+
+// get the size and modification time of a file that something was built from:
+
+bool
+GetSourceStamp( const char *name, unsigned long long *size, long long *mtime )
+{
+	struct stat st;
+	if( stat( name, &st ) != 0 )
+		return false;
+
+	*size  = (unsigned long long)st.st_size;
+	*mtime = (long long)st.st_mtime;
+	return true;
+}
+
+
+// map the whole file read-only:
+// returns false if the file cannot be opened or mapped
+
+bool
+MapFile( const char *name, MappedFile *mf )
+{
+	mf->Data = NULL;
+	mf->Size = 0;
+
+#ifdef WIN32
+	mf->Mapping = NULL;
+	mf->File = CreateFileA( name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if( mf->File == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER size;
+	if( ! GetFileSizeEx( mf->File, &size ) )
+	{
+		CloseHandle( mf->File );
+		mf->File = INVALID_HANDLE_VALUE;
+		return false;
+	}
+
+	mf->Size = (size_t)size.QuadPart;
+
+	// an empty file cannot be mapped, but it is still a valid file:
+
+	if( mf->Size == 0 )
+		return true;
+
+	mf->Mapping = CreateFileMappingA( mf->File, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( mf->Mapping != NULL )
+		mf->Data = (const char *) MapViewOfFile( mf->Mapping, FILE_MAP_READ, 0, 0, 0 );
+
+	if( mf->Data == NULL )
+	{
+		UnmapFile( mf );
+		return false;
+	}
+#else
+	mf->Fd = open( name, O_RDONLY );
+	if( mf->Fd < 0 )
+		return false;
+
+	struct stat st;
+	if( fstat( mf->Fd, &st ) != 0 )
+	{
+		close( mf->Fd );
+		mf->Fd = -1;
+		return false;
+	}
+
+	mf->Size = (size_t)st.st_size;
+
+	// an empty file cannot be mapped, but it is still a valid file:
+
+	if( mf->Size == 0 )
+		return true;
+
+	void *p = mmap( NULL, mf->Size, PROT_READ, MAP_PRIVATE, mf->Fd, 0 );
+	if( p == MAP_FAILED )
+	{
+		UnmapFile( mf );
+		return false;
+	}
+
+	// we read front to back, so let the kernel read ahead aggressively:
+
+	madvise( p, mf->Size, MADV_SEQUENTIAL );
+	mf->Data = (const char *) p;
+#endif
+
+	return true;
+}
+
+
+void
+UnmapFile( MappedFile *mf )
+{
+#ifdef WIN32
+	if( mf->Data != NULL )
+		UnmapViewOfFile( mf->Data );
+	if( mf->Mapping != NULL )
+		CloseHandle( mf->Mapping );
+	if( mf->File != INVALID_HANDLE_VALUE )
+		CloseHandle( mf->File );
+	mf->Mapping = NULL;
+	mf->File = INVALID_HANDLE_VALUE;
+#else
+	if( mf->Data != NULL )
+		munmap( (void *) mf->Data, mf->Size );
+	if( mf->Fd >= 0 )
+		close( mf->Fd );
+	mf->Fd = -1;
+#endif
+
+	mf->Data = NULL;
+	mf->Size = 0;
+}
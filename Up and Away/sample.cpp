@@ -33,6 +33,7 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include "bmptexture.h"
 #include "glslprogram.h"	//use to compile the shaders
 #include "loadobjfile.h"	//use to import obj file
 
@@ -244,10 +245,7 @@ void	Resize( int, int );
 void	Visibility( int );
 
 void			Axes( float );
-unsigned char *	BmpToTexture( char *, int *, int * );
 void			HsvRgb( float[3], float [3] );
-int				ReadInt( FILE * );
-short			ReadShort( FILE * );
 
 void			Cross(float[3], float[3], float[3]);
 float			Dot(float [3], float [3]);
@@ -1256,149 +1254,6 @@ Axes( float length )
 
 }
 
-struct bmfh
-{
-	short bfType;
-	int bfSize;
-	short bfReserved1;
-	short bfReserved2;
-	int bfOffBits;
-} FileHeader;
-
-struct bmih
-{
-	int biSize;
-	int biWidth;
-	int biHeight;
-	short biPlanes;
-	short biBitCount;
-	int biCompression;
-	int biSizeImage;
-	int biXPelsPerMeter;
-	int biYPelsPerMeter;
-	int biClrUsed;
-	int biClrImportant;
-} InfoHeader;
-
-const int birgb = { 0 };
-
-// read a BMP file into a Texture:
-
-unsigned char *
-BmpToTexture( char *filename, int *width, int *height )
-{
-	FILE *fp = fopen( filename, "rb" );
-	if( fp == NULL )
-	{
-		fprintf( stderr, "Cannot open Bmp file '%s'\n", filename );
-		return NULL;
-	}
-
-	FileHeader.bfType = ReadShort( fp );
-
-
-	// if bfType is not 0x4d42, the file is not a bmp:
-
-	if( FileHeader.bfType != 0x4d42 )
-	{
-		fprintf( stderr, "File '%s' is the wrong type of file: 0x%0x\n", filename, FileHeader.bfType );
-		fclose( fp );
-		return NULL;
-	}
-
-	FileHeader.bfSize = ReadInt( fp );
-	FileHeader.bfReserved1 = ReadShort( fp );
-	FileHeader.bfReserved2 = ReadShort( fp );
-	FileHeader.bfOffBits = ReadInt( fp );
-
-	InfoHeader.biSize = ReadInt( fp );
-	InfoHeader.biWidth = ReadInt( fp );
-	InfoHeader.biHeight = ReadInt( fp );
-
-	int nums = InfoHeader.biWidth;
-	int numt = InfoHeader.biHeight;
-
-	InfoHeader.biPlanes = ReadShort( fp );
-	InfoHeader.biBitCount = ReadShort( fp );
-	InfoHeader.biCompression = ReadInt( fp );
-	InfoHeader.biSizeImage = ReadInt( fp );
-	InfoHeader.biXPelsPerMeter = ReadInt( fp );
-	InfoHeader.biYPelsPerMeter = ReadInt( fp );
-	InfoHeader.biClrUsed = ReadInt( fp );
-	InfoHeader.biClrImportant = ReadInt( fp );
-
-	fprintf( stderr, "Image size in file '%s' is: %d x %d\n", filename, nums, numt );
-
-	unsigned char * texture = new unsigned char[ 3 * nums * numt ];
-	if( texture == NULL )
-	{
-		fprintf( stderr, "Cannot allocate the texture array!\b" );
-		return NULL;
-	}
-
-	// extra padding bytes:
-
-	int numextra =  4*(( (3*InfoHeader.biWidth)+3)/4) - 3*InfoHeader.biWidth;
-
-	// we do not support compression:
-
-	if( InfoHeader.biCompression != birgb )
-	{
-		fprintf( stderr, "Image file '%s' has the wrong type of image compression: %d\n", filename, InfoHeader.biCompression );
-		fclose( fp );
-		return NULL;
-	}
-
-	rewind( fp );
-	fseek( fp, 14+40, SEEK_SET );
-
-	if( InfoHeader.biBitCount == 24 )
-	{
-		unsigned char *tp = texture;
-		for( int t = 0; t < numt; t++ )
-		{
-			for( int s = 0; s < nums; s++, tp += 3 )
-			{
-				*(tp+2) = fgetc( fp );		// b
-				*(tp+1) = fgetc( fp );		// g
-				*(tp+0) = fgetc( fp );		// r
-			}
-
-			for( int e = 0; e < numextra; e++ )
-			{
-				fgetc( fp );
-			}
-		}
-	}
-
-	fclose( fp );
-
-	*width = nums;
-	*height = numt;
-	return texture;
-}
-
-int
-ReadInt( FILE *fp )
-{
-	unsigned char b3, b2, b1, b0;
-	b0 = fgetc( fp );
-	b1 = fgetc( fp );
-	b2 = fgetc( fp );
-	b3 = fgetc( fp );
-	return ( b3 << 24 )  |  ( b2 << 16 )  |  ( b1 << 8 )  |  b0;
-}
-
-short
-ReadShort( FILE *fp )
-{
-	unsigned char b1, b0;
-	b0 = fgetc( fp );
-	b1 = fgetc( fp );
-	return ( b1 << 8 )  |  b0;
-}
-
-
 // function to convert HSV to RGB
 // 0.  <=  s, v, r, g, b  <=  1.
 // 0.  <= h  <=  360.